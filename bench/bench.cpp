@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "frontend/lexer.h"
+#include "frontend/numeric.h"
+#include "frontend/parser.h"
+#include "frontend/scan.h"
+
+using namespace Winter;
+
+// Generate a heavily commented and indented source, similar to our generated inputs
+[[nodiscard]] std::string generateSource(std::size_t funcs) {
+    std::string src = {};
+    for (std::size_t i = 0; i < funcs; i++) {
+        src += "# ------------------------------------------------------------\n";
+        src += "# generated function, do not edit by hand\n";
+        src += "# ------------------------------------------------------------\n";
+        src += std::format("let func_{} = func(a: i32, b: i32) i32 {{\n", i);
+        src += "        # add the arguments together\n";
+        src += "        return 35 + (17 * 2);\n";
+        src += "}\n\n";
+    }
+    return src;
+}
+
+// Best-of-N wall time for `fn`, reported as throughput over `bytes`
+[[nodiscard]] double throughputMBs(std::size_t bytes, const std::function<void()>& fn) {
+    constexpr int runs = 10;
+    double best = 0;
+    for (int i = 0; i < runs; i++) {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        const double mbs = static_cast<double>(bytes) / (1024.0 * 1024.0) / elapsed.count();
+        if (mbs > best) { best = mbs; }
+    }
+    return best;
+}
+
+void bench_scan(std::string_view src) {
+    std::println("=== whitespace/comment skipping ===");
+    for (ScanIsa isa : {ScanIsa::scalar, ScanIsa::sse2, ScanIsa::avx2}) {
+        if (!scanIsaSupported(isa)) {
+            std::println("{:>8}: unsupported", std::format("{}", isa));
+            continue;
+        }
+
+        const Scanner& scan = scanner(isa);
+        std::size_t sink = 0;
+        const double mbs = throughputMBs(src.size(), [&] {
+            std::size_t pos = 0;
+            while (pos < src.size()) {
+                pos = scan.whitespace(src, pos);
+                if (pos < src.size() && src[pos] == '#') {
+                    pos = scan.newline(src, pos);
+                } else {
+                    pos++;
+                }
+            }
+            sink += pos;
+        });
+        std::println("{:>8}: {:8.1f} MB/s", std::format("{}", isa), mbs);
+        if (sink == 0) { std::println("(empty)"); }
+    }
+    std::println();
+}
+
+void bench_lex(std::string_view src) {
+    std::println("=== full lex ({}) ===", scanner().isa);
+    std::size_t tokens = 0;
+    const double mbs = throughputMBs(src.size(), [&] {
+        Lexer L = Lexer(src);
+        TokenBuffer buf = {};
+        if (L.lexAll(buf).has_value()) { std::println("lex error"); }
+        tokens = buf.size();
+    });
+    std::println("{:>8}: {:8.1f} MB/s ({} tokens)", "lexAll", mbs, tokens);
+    std::println();
+}
+
+// One keystroke in the middle of the file, relexed vs lexed from scratch
+void bench_relex(const std::string& src) {
+    std::println("=== relex after a one byte edit ===");
+    const std::size_t offset = src.find("35", src.size() / 2);
+    const std::string edited = src.substr(0, offset) + "4" + src.substr(offset + 1);
+
+    const double full = throughputMBs(src.size(), [&] {
+        Lexer L = Lexer(edited);
+        TokenBuffer buf = {};
+        if (L.lexAll(buf).has_value()) { std::println("lex error"); }
+    });
+
+    Lexer L = Lexer(src);
+    TokenBuffer base = {};
+    if (L.lexAll(base).has_value()) { std::println("lex error"); }
+    const double incremental = throughputMBs(src.size(), [&] {
+        Lexer RL = L;
+        TokenBuffer buf = base;
+        if (RL.relex(buf, edited, TextEdit(offset, 1, "4"sv)).has_value()) {
+            std::println("relex error");
+        }
+    });
+
+    std::println("{:>8}: {:8.1f} MB/s", "lexAll", full);
+    std::println("{:>8}: {:8.1f} MB/s (including copying the old buffer)", "relex", incremental);
+    std::println();
+}
+
+// Lex and parse, sequentially and split across threads
+void bench_parse(std::string_view src) {
+    std::println("=== lex + parse ===");
+    const std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    for (std::size_t jobs : {std::size_t(1), std::size_t(2), std::size_t(4), cores}) {
+        std::size_t nodes = 0;
+        const double mbs = throughputMBs(src.size(), [&] {
+            Parser P(src);
+            auto r = P(jobs);
+            nodes = r.has_value() ? r.value().size() : 0;
+        });
+        std::println("{:>8}: {:8.1f} MB/s ({} nodes)", std::format("-j{}", jobs), mbs, nodes);
+    }
+    std::println();
+}
+
+// One edited function in the middle, reparsed vs parsed from scratch
+void bench_reparse(const std::string& src) {
+    std::println("=== reparse after a one byte edit ===");
+    const std::size_t offset = src.find("35", src.size() / 2);
+    const std::string edited = src.substr(0, offset) + "4" + src.substr(offset + 1);
+
+    Parser base(src);
+    auto snapshot = base.reparse(ParseSnapshot {});
+    if (!snapshot.has_value()) { std::println("parse error"); }
+
+    std::size_t reparsed = 0;
+    const double full = throughputMBs(src.size(), [&] {
+        Parser P(edited);
+        if (!P().has_value()) { std::println("parse error"); }
+    });
+    const double incremental = throughputMBs(src.size(), [&] {
+        Parser P(edited);
+        auto r = P.reparse(snapshot.value());
+        reparsed = r.has_value() ? r.value().reparsedItems : 0;
+    });
+
+    std::println("{:>8}: {:8.1f} MB/s", "parse", full);
+    std::println("{:>8}: {:8.1f} MB/s ({} item reparsed)", "reparse", incremental, reparsed);
+    std::println();
+}
+
+// A data table of numeric constants, the worst case for literal decoding
+void bench_numeric(std::size_t count) {
+    std::println("=== numeric literals ===");
+    std::string src = {};
+    for (std::size_t i = 0; i < count; i++) {
+        src += std::format("{} 0x{:X} {}.{} ", i * 7919, i, i, i % 100);
+    }
+
+    Lexer L = Lexer(src);
+    TokenBuffer buf = {};
+    if (L.lexAll(buf).has_value()) { std::println("lex error"); }
+
+    std::int64_t isum = 0;
+    double fsum = 0;
+    const double mbs = throughputMBs(src.size(), [&] {
+        for (std::size_t i = 0; i + 1 < buf.size(); i++) {
+            const auto num = buf.at(i).toNum(&L);
+            if (!num.has_value()) { continue; }
+            if (num.value().isInteger()) {
+                isum += num.value().integer().value();
+            } else {
+                fsum += num.value().floating().value();
+            }
+        }
+    });
+    std::println("{:>8}: {:8.1f} MB/s ({} literals)", "toNum", mbs, buf.size() - 1);
+    if (isum == 0 && fsum == 0) { std::println("(empty)"); }
+    std::println();
+}
+
+// Layout of Token before it was packed, kept to compare against
+struct WideToken {
+    TokenType type;
+    std::size_t start;
+    std::size_t len;
+    std::size_t idx;
+};
+
+template <typename T>
+void reportLayout(std::string_view name, std::size_t count, double build, double walk) {
+    const double mb = static_cast<double>(count * sizeof(T)) / (1024.0 * 1024.0);
+    std::println(
+        "{:>12}: {:2} B/token, {:6.1f} MB, build {:8.1f} MB/s, walk {:8.1f} MB/s", name,
+        sizeof(T), mb, build, walk);
+}
+
+void bench_tokenLayout(std::string_view src) {
+    std::println("=== token layout ===");
+    Lexer L = Lexer(src);
+    TokenBuffer buf = {};
+    if (L.lexAll(buf).has_value()) { std::println("lex error"); }
+    const std::size_t count = buf.size();
+
+    std::vector<WideToken> wide = {};
+    const double wideBuild = throughputMBs(src.size(), [&] {
+        wide.clear();
+        Lexer WL = Lexer(src);
+        for (std::size_t i = 0;; i++) {
+            auto tok = WL();
+            if (!tok.has_value()) { break; }
+            wide.push_back(WideToken(tok.value().type, tok.value().start, tok.value().len, i));
+            if (tok.value().type == TokenType::eof) { break; }
+        }
+    });
+
+    std::vector<Token> packed = {};
+    const double packedBuild = throughputMBs(src.size(), [&] {
+        packed.clear();
+        Lexer PL = Lexer(src);
+        while (true) {
+            auto tok = PL();
+            if (!tok.has_value()) { break; }
+            packed.push_back(tok.value());
+            if (tok.value().type == TokenType::eof) { break; }
+        }
+    });
+
+    // A pass touching every token, standing in for the parser walking the stream
+    std::size_t sink = 0;
+    const double wideWalk = throughputMBs(src.size(), [&] {
+        for (const WideToken& t : wide) {
+            sink += t.start + t.len + static_cast<std::size_t>(t.type);
+        }
+    });
+    const double packedWalk = throughputMBs(src.size(), [&] {
+        for (const Token& t : packed) {
+            sink += t.start + t.len + static_cast<std::size_t>(t.type);
+        }
+    });
+
+    reportLayout<WideToken>("wide", count, wideBuild, wideWalk);
+    reportLayout<Token>("packed", count, packedBuild, packedWalk);
+    std::println(
+        "{:>12}: {:2} B/token, {:6.1f} MB (struct-of-arrays)", "TokenBuffer",
+        sizeof(TokenType) + sizeof(std::uint32_t) + sizeof(std::uint16_t),
+        static_cast<double>(
+            count * (sizeof(TokenType) + sizeof(std::uint32_t) + sizeof(std::uint16_t))) /
+            (1024.0 * 1024.0));
+    if (sink == 0) { std::println("(empty)"); }
+    std::println();
+}
+
+int main() {
+    const std::string src = generateSource(20000);
+    std::println("source: {:.1f} MB", static_cast<double>(src.size()) / (1024.0 * 1024.0));
+    std::println();
+
+    bench_scan(src);
+    bench_lex(src);
+    bench_tokenLayout(src);
+    bench_relex(src);
+    bench_parse(src);
+    bench_reparse(src);
+    bench_numeric(200000);
+
+    return 0;
+}
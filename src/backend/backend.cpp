@@ -1,15 +1,32 @@
 #include "backend.h"
 
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
 #include <format>
+#include <mutex>
 #include <optional>
 #include <print>
+#include <span>
 #include <string>
+#include <thread>
+#include <utility>
 #include <variant>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include <lld/Common/Driver.h>
 #include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/SmallString.h>
 #include <llvm/ADT/Twine.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/CodeGen/CommandFlags.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/DerivedTypes.h>
@@ -20,44 +37,102 @@
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Value.h>
+#include <llvm/IR/Verifier.h>
 #include <llvm/MC/TargetRegistry.h>
+#include <llvm/Passes/OptimizationLevel.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/CodeGen.h>
+#include <llvm/Support/Error.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBufferRef.h>
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/Support/ToolOutputFile.h>
+#include <llvm/Support/raw_ostream.h>
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/TargetParser/Host.h>
+#include <llvm/Transforms/Utils/SplitModule.h>
 
 #include "../frontend/ast.h"
+#include "../frontend/intern.h"
 #include "../frontend/lexer.h"
+#include "../frontend/walk.h"
 
 LLD_HAS_DRIVER(elf);
 
 namespace Winter {
-    [[nodiscard]] std::expected<Type*, Error> Backend::getType(std::string_view type_str) {
-        if (type_str == "i32") {
-            Type* ty = Type::getInt32Ty(ctx);
-            return ty;
-        } else if (type_str == "void") {
-            Type* ty = Type::getVoidTy(ctx);
-            return ty;
+    [[nodiscard]] static CodeGenOptLevel codegenLevel(OptLevel level) {
+        switch (level) {
+            case OptLevel::O0: return CodeGenOptLevel::None;
+            case OptLevel::O1: return CodeGenOptLevel::Less;
+            case OptLevel::O2:
+            case OptLevel::Os: return CodeGenOptLevel::Default;
+            case OptLevel::O3: return CodeGenOptLevel::Aggressive;
+        }
+        return CodeGenOptLevel::Default;
+    }
+
+    [[nodiscard]] static OptimizationLevel passLevel(OptLevel level) {
+        switch (level) {
+            case OptLevel::O0: return OptimizationLevel::O0;
+            case OptLevel::O1: return OptimizationLevel::O1;
+            case OptLevel::O2: return OptimizationLevel::O2;
+            case OptLevel::O3: return OptimizationLevel::O3;
+            case OptLevel::Os: return OptimizationLevel::Os;
+        }
+        return OptimizationLevel::O2;
+    }
+
+    // Types were resolved by `analyze`, aliases included, so this is a switch on the result
+    [[nodiscard]] std::expected<Type*, Error> Backend::getType(BuiltinType type) {
+        switch (type) {
+            case BuiltinType::i8:
+            case BuiltinType::u8:
+            case BuiltinType::character: return Type::getInt8Ty(ctx);
+            case BuiltinType::i16:
+            case BuiltinType::u16:       return Type::getInt16Ty(ctx);
+            case BuiltinType::i32:
+            case BuiltinType::u32:       return Type::getInt32Ty(ctx);
+            case BuiltinType::i64:
+            case BuiltinType::u64:       return Type::getInt64Ty(ctx);
+            case BuiltinType::f32:       return Type::getFloatTy(ctx);
+            case BuiltinType::f64:       return Type::getDoubleTy(ctx);
+            case BuiltinType::boolean:   return Type::getInt1Ty(ctx);
+            case BuiltinType::void_:     return Type::getVoidTy(ctx);
+            default:                     break;
         }
 
-        return std::unexpected(
-            Error(ErrType::Generator, std::format("Type not found: '{}'", type_str)));
+        return std::unexpected(Error(
+            ErrType::Generator,
+            std::format("Type not supported by codegen: {}", builtinName(type))));
     }
 
     // based on llc code:
     // https://github.com/llvm/llvm-project/blob/main/llvm/tools/llc/llc.cpp#L607C1-L607C77
     // LICENSE: https://github.com/llvm/llvm-project/blob/main/LICENSE.TXT
     [[nodiscard]] std::expected<const Target*, Error> Backend::getTarget() {
-        targetTriple = Triple(sys::getDefaultTargetTriple());
-
-        // These are the registries that lookupTarget queryies
-        InitializeAllTargetInfos();
-        InitializeAllTargets();
-        InitializeAllTargetMCs();
-        InitializeAllAsmParsers();
-        InitializeAllAsmPrinters();
+        const Triple host = Triple(sys::getDefaultTargetTriple());
+        if (!targetTriple.has_value()) { targetTriple = host; }
+
+        // These are the registries that lookupTarget queries. Registering every target
+        // LLVM was built with is slow and only needed when cross compiling, and either
+        // way it only has to happen once per process
+        static std::once_flag nativeTarget;
+        static std::once_flag allTargets;
+        if (targetTriple->getArch() == host.getArch()) {
+            std::call_once(nativeTarget, [] {
+                InitializeNativeTarget();
+                InitializeNativeTargetAsmParser();
+                InitializeNativeTargetAsmPrinter();
+            });
+        } else {
+            std::call_once(allTargets, [] {
+                InitializeAllTargetInfos();
+                InitializeAllTargets();
+                InitializeAllTargetMCs();
+                InitializeAllAsmParsers();
+                InitializeAllAsmPrinters();
+            });
+        }
 
         std::string ErrStr;
         const Target* target = TargetRegistry::lookupTarget(targetTriple.value(), ErrStr);
@@ -69,124 +144,188 @@ namespace Winter {
         return target;
     }
 
+    // Whether code is being generated for another machine than this one. Only this
+    // machine's crt files and dynamic linker are known, and only its code can be run
+    [[nodiscard]] bool Backend::crossCompiling() const {
+        if (!targetTriple.has_value()) { return false; }
+        const Triple host = Triple(sys::getDefaultTargetTriple());
+        return targetTriple->getArch() != host.getArch() || targetTriple->getOS() != host.getOS();
+    }
+
+    // A target machine isn't safe to share between threads, so parallel codegen makes one
+    // per thread. Everything else shares the one from `getTargetMachine`
+    [[nodiscard]] std::expected<std::unique_ptr<TargetMachine>, Error>
+    Backend::createTargetMachine() {
+        std::expected<const Target*, Error> target = getTarget();
+        if (!target.has_value()) { return std::unexpected(target.error()); }
+
+        TargetOptions opts;
+        std::unique_ptr<TargetMachine> machine(target.value()->createTargetMachine(
+            targetTriple.value(), "generic", "", opts, codegen::getExplicitRelocModel(),
+            std::nullopt, codegenLevel(optLevel)));
+        if (machine == nullptr) {
+            return std::unexpected(Error(
+                ErrType::Generator,
+                std::format("Could not create a target machine for {}", targetTriple->str())));
+        }
+
+        return machine;
+    }
+
+    // Made on first use and kept, so every module this backend emits shares it
+    [[nodiscard]] std::expected<TargetMachine*, Error> Backend::getTargetMachine() {
+        if (targetMachine != nullptr) { return targetMachine.get(); }
+
+        std::expected<std::unique_ptr<TargetMachine>, Error> machine = createTargetMachine();
+        if (!machine.has_value()) { return std::unexpected(machine.error()); }
+        targetMachine = std::move(machine.value());
+        return targetMachine.get();
+    }
+
     [[nodiscard]] std::optional<Error> Backend::createFunction(
         module_ptr_t& mod,
         const letNode* let) {
-        const funcNode* func = std::get_if<funcNode>(&currentNode.children.at(0).data);
+        const funcNode* func = std::get_if<funcNode>(&ast->child(currentNode, 0).data);
+        const DeclId decl = sema->declOf(currentNode);
 
-        std::expected<Type*, Error> retType = getType(func->retType);
+        std::expected<Type*, Error> retType = getType(sema->builtinOf((*sema)[decl].type));
         if (!retType.has_value()) { return retType.error(); }
 
         std::vector<Type*> paramList = {};
-        for (auto param : func->parameters) {
-            const paramNode* p = std::get_if<paramNode>(&param.data);
-            std::expected<Type*, Error> paramType = getType(p->type);
-            if (!paramType.has_value()) { return paramType.error(); }
-            paramList.push_back(paramType.value());
+        for (NodeId param : ast->range(func->parameters)) {
+            const DeclId paramType = (*sema)[sema->declOf(param)].type;
+            std::expected<Type*, Error> type = getType(sema->builtinOf(paramType));
+            if (!type.has_value()) { return type.error(); }
+            paramList.push_back(type.value());
         }
 
         auto fType = FunctionType::get(retType.value(), ArrayRef(paramList), false);
-        mod->getOrInsertFunction(let->name, fType);
+        FunctionCallee callee = mod->getOrInsertFunction(let->name.str(), fType);
+        if (functions.size() < sema->decls.size()) { functions.resize(sema->decls.size()); }
+        functions[decl] = cast<Function>(callee.getCallee());
         return {};
     }
 
-    [[nodiscard]] BasicBlock* Backend::createBlock(module_ptr_t& mod, const letNode* let) {
+    [[nodiscard]] BasicBlock* Backend::createBlock(DeclId func) {
         // TODO: populate twine with line number when we have that info
         // NOTE: Twine is like an assembly label, I think
-        auto blk = BasicBlock::Create(ctx, Twine(), mod->getFunction(let->name));
+        auto blk =
+            BasicBlock::Create(ctx, Twine(), func < functions.size() ? functions[func] : nullptr);
         return blk;
     }
 
-    [[nodiscard]] Value* Backend::compileExpression(IRBuilder<>* builder) {
-        exprNode* expr = std::get_if<exprNode>(&currentNode.data);
-        Value* ret = nullptr;
-
-        if (!expr->op.has_value()) {
-            // TODO: only one value in the expression
-            // return something from here
+    // Emits an expression bottom-up: every operand leaves one value on `values`, and an
+    // operator replaces its operands' values with its own. An operand or operator codegen
+    // doesn't support yet stops the walk with an error
+    struct ExprEmitter {
+        Backend& backend;
+        IRBuilder<>* builder;
+        std::vector<Value*> values = {};
+        std::optional<Error> error = std::nullopt;
+
+        WalkAction fail(Error err) {
+            error = std::move(err);
+            return WalkAction::Stop;
         }
 
-        switch (expr->op.value()) {
-            case TokenType::plus: {
-                Value* lhsVal = nullptr;
-                Value* rhsVal = nullptr;
-
-                for (std::size_t i = 0; i < currentNode.children.size(); i++) {
-                    Node child = currentNode.children.at(i);
-                    Value* activePtr = nullptr;
-
-                    if (child.type == NodeType::numlitNode) {
-                        numlitNode* numLit = std::get_if<numlitNode>(&child.data);
-                        activePtr = ConstantInt::get(Type::getInt32Ty(ctx), numLit->value);
-                    } else if (child.type == NodeType::exprNode) {
-                        currentNode = child;
-                        activePtr = compileExpression(builder);
-                    }
-
-                    (i % 2 ? rhsVal : lhsVal) = activePtr;
-                }
-
-                ret = builder->CreateAdd(lhsVal, rhsVal);
-            } break;
-
-            case TokenType::star: {
-                Value* lhsVal = nullptr;
-                Value* rhsVal = nullptr;
+        WalkAction pre(WalkPos, const exprNode&) { return WalkAction::Continue; }
+        WalkAction pre(WalkPos, const auto&) { return WalkAction::SkipChildren; }
 
-                for (std::size_t i = 0; i < currentNode.children.size(); i++) {
-                    Node child = currentNode.children.at(i);
-                    Value* activePtr = nullptr;
-
-                    if (child.type == NodeType::numlitNode) {
-                        numlitNode* numLit = std::get_if<numlitNode>(&child.data);
-                        activePtr = ConstantInt::get(Type::getInt32Ty(ctx), numLit->value);
-                    } else if (child.type == NodeType::exprNode) {
-                        currentNode = child;
-                        activePtr = compileExpression(builder);
-                    }
-
-                    (i % 2 ? rhsVal : lhsVal) = activePtr;
-                }
+        WalkAction post(WalkPos pos, const numlitNode& num) {
+            const BuiltinType type = backend.sema->builtinOf(backend.sema->typeOf(pos.id));
+            std::expected<Constant*, Error> value = backend.numConstant(num.value, type);
+            if (!value.has_value()) { return fail(value.error()); }
+            values.push_back(value.value());
+            return WalkAction::Continue;
+        }
 
-                ret = builder->CreateMul(lhsVal, rhsVal);
-            } break;
+        WalkAction post(WalkPos pos, const exprNode& expr) {
+            const std::size_t count = backend.ast->children(pos.id).size();
+            if (count != 2 || !expr.op.has_value()) {
+                return fail(Error(ErrType::Generator, "Unsupported expression: unary operator"));
+            }
+            Value* lhs = values[values.size() - 2];
+            Value* rhs = values.back();
+            values.resize(values.size() - count);
+
+            const bool fp = lhs->getType()->isFloatingPointTy();
+            switch (expr.op.value()) {
+                case TokenType::plus:
+                    values.push_back(fp ? builder->CreateFAdd(lhs, rhs)
+                                        : builder->CreateAdd(lhs, rhs));
+                    return WalkAction::Continue;
+                case TokenType::star:
+                    values.push_back(fp ? builder->CreateFMul(lhs, rhs)
+                                        : builder->CreateMul(lhs, rhs));
+                    return WalkAction::Continue;
+                default:
+                    return fail(Error(
+                        ErrType::Generator,
+                        std::format("Unsupported expression: operator {}", expr.op.value())));
+            }
+        }
 
-            default: break;
+        WalkAction post(WalkPos pos, const auto&) {
+            return fail(Error(
+                ErrType::Generator,
+                std::format("Unsupported expression: {}", (*backend.ast)[pos.id].type)));
         }
+    };
 
-        return ret;
+    [[nodiscard]] std::expected<Value*, Error> Backend::compileExpression(IRBuilder<>* builder) {
+        ExprEmitter emitter = {*this, builder};
+        if (!walk(*ast, currentNode, emitter)) { return std::unexpected(emitter.error.value()); }
+        return emitter.values.back();
     }
 
-    [[nodiscard]] Value* Backend::compileNumLit() {
-        numlitNode* numLit = std::get_if<numlitNode>(&currentNode.data);
-        return ConstantInt::get(Type::getInt32Ty(ctx), numLit->value);
+    [[nodiscard]] std::expected<Value*, Error> Backend::compileNumLit() {
+        const numlitNode* numLit = std::get_if<numlitNode>(&(*ast)[currentNode].data);
+        const BuiltinType type = sema->builtinOf(sema->typeOf(currentNode));
+        return numConstant(numLit->value, type);
     }
 
-    void Backend::populateBlock(BasicBlock* blk) {
-        const Node func = currentNode.children.at(0);
-        const Node body = func.children.at(0);
+    // `type` is the one analysis settled the literal to, so an integer literal may be a float
+    [[nodiscard]] std::expected<Constant*, Error>
+    Backend::numConstant(const NumValue& num, BuiltinType type) {
+        std::expected<Type*, Error> llvmType = getType(type);
+        if (!llvmType.has_value()) { return std::unexpected(llvmType.error()); }
+
+        if (llvmType.value()->isFloatingPointTy()) {
+            const auto i = num.integer();
+            return ConstantFP::get(
+                llvmType.value(),
+                i.has_value() ? static_cast<double>(i.value()) : num.floating().value());
+        }
+        if (!num.isInteger() || !llvmType.value()->isIntegerTy()) {
+            return std::unexpected(Error(
+                ErrType::Generator,
+                std::format("Numeric literal can't be a {}", builtinName(type))));
+        }
+        return ConstantInt::getSigned(llvmType.value(), num.integer().value());
+    }
+
+    // Only return statements are emitted so far
+    [[nodiscard]] std::optional<Error> Backend::populateBlock(BasicBlock* blk) {
+        const NodeId func = ast->childId(currentNode, 0);
+        const NodeId body = ast->childId(func, 0);
 
         IRBuilder builder(blk);
 
-        for (Node stmt : body.children) {
-            switch (stmt.type) {
+        for (NodeId stmt : ast->children(body)) {
+            switch ((*ast)[stmt].type) {
                 case NodeType::returnNode: {
                     // TODO: handle `return;`
-                    currentNode = stmt.children.at(0);
-
-                    Value* retVal = nullptr;
-                    if (currentNode.type == NodeType::exprNode) {
-                        retVal = compileExpression(&builder);
-                    } else if (currentNode.type == NodeType::numlitNode) {
-                        retVal = compileNumLit();
-                    }
+                    currentNode = ast->childId(stmt, 0);
 
-                    builder.CreateRet(retVal);
+                    std::expected<Value*, Error> retVal = compileExpression(&builder);
+                    if (!retVal.has_value()) { return retVal.error(); }
+                    builder.CreateRet(retVal.value());
                 } break;
 
                 default: break;
             }
         }
+        return {};
     }
 
     void Backend::insertStart(module_ptr_t& mod) {
@@ -201,7 +340,8 @@ namespace Winter {
         auto blk = BasicBlock::Create(ctx, Twine(), mod->getFunction("_start"));
         IRBuilder builder(blk);
 
-        auto i32Type = FunctionType::get(getType("i32").value(), ArrayRef<Type*>({}), false);
+        auto i32Type =
+            FunctionType::get(getType(BuiltinType::i32).value(), ArrayRef<Type*>({}), false);
         FunctionCallee main = mod->getOrInsertFunction("main", i32Type);
         auto fCall = builder.CreateCall(main, ArrayRef<Value*>({}));
 
@@ -212,23 +352,27 @@ namespace Winter {
         builder.CreateRetVoid();
     }
 
-    [[nodiscard]] module_result_t Backend::compileModule(std::span<Node> nodes) {
+    [[nodiscard]] module_result_t Backend::compileModule(const Ast& tree, const Sema& info) {
         module_ptr_t myModule = std::make_unique<Module>("Main", ctx);
+        ast = &tree;
+        sema = &info;
+        functions.assign(info.decls.size(), nullptr);
 
-        for (auto node : nodes) {
-            const letNode* let = std::get_if<letNode>(&node.data);
+        for (NodeId node : tree.roots) {
+            const letNode* let = std::get_if<letNode>(&tree[node].data);
             // if (let->name == "main") { insertStart(myModule); }
 
-            if (let->isFunc) {
+            if (let != nullptr && let->isFunc) {
                 currentNode = node;
                 std::optional<Error> ret = createFunction(myModule, let);
                 if (ret.has_value()) { return std::unexpected(ret.value()); }
 
                 // NOTE: A function may be made up of multiple basic blocks
                 // probably nested blocks in source code, like if/else/for blocks?
-                BasicBlock* blk = createBlock(myModule, let);
+                BasicBlock* blk = createBlock(sema->declOf(node));
 
-                populateBlock(blk);
+                std::optional<Error> err = populateBlock(blk);
+                if (err.has_value()) { return std::unexpected(err.value()); }
             }
         }
 
@@ -240,48 +384,251 @@ namespace Winter {
         mod->print(llvm::errs(), nullptr);
     }
 
-    void Backend::emitBitcodeFile(module_ptr_t& mod) const {
+    // Written beside the input and named after it, like every other output
+    [[nodiscard]] std::optional<Error> Backend::emitBitcodeFile(module_ptr_t& mod) const {
+        const std::string path = outputStem() + ".bc";
         std::error_code EC;
-        raw_fd_ostream dest("output.bc", EC, sys::fs::OF_Text);
-        mod->print(dest, nullptr);
+        raw_fd_ostream dest(path, EC, sys::fs::OF_None);
+        if (EC) {
+            return Error(ErrType::IO, std::format("Cannot write '{}': {}", path, EC.message()));
+        }
+        WriteBitcodeToFile(*mod, dest);
+        return std::nullopt;
     }
 
-    [[nodiscard]] std::expected<std::string, Error> Backend::outputObjectFile(module_ptr_t& mod) {
-        std::expected<const Target*, Error> target = getTarget();
-        if (!target.has_value()) { return std::unexpected(target.error()); }
-
-        TargetOptions opts;
-        TargetMachine* targetMachine = target.value()->createTargetMachine(
-            targetTriple.value(), "generic", "", opts, codegen::getExplicitRelocModel());
+    // Run the standard new pass manager pipeline for `optLevel`, the one clang and opt
+    // use. `targetMachine` may be null, at the cost of target-specific cost models
+    [[nodiscard]] std::optional<Error> Backend::optimizeModule(
+        module_ptr_t& mod,
+        TargetMachine* targetMachine) {
+        if (optLevel == OptLevel::O0) { return {}; }
+
+        LoopAnalysisManager LAM;
+        FunctionAnalysisManager FAM;
+        CGSCCAnalysisManager CGAM;
+        ModuleAnalysisManager MAM;
+
+        PassBuilder PB(targetMachine);
+        PB.registerModuleAnalyses(MAM);
+        PB.registerCGSCCAnalyses(CGAM);
+        PB.registerFunctionAnalyses(FAM);
+        PB.registerLoopAnalyses(LAM);
+        PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+        ModulePassManager MPM = PB.buildPerModuleDefaultPipeline(passLevel(optLevel));
+        MPM.run(*mod, MAM);
+        return {};
+    }
 
-        mod->setDataLayout(targetMachine->createDataLayout());
-        mod->setTargetTriple(targetTriple.value());
+    // Modules can't move between contexts, so they're copied as bitcode and read back into
+    // the context that should own them
+    [[nodiscard]] static std::expected<module_ptr_t, Error> readBitcode(
+        StringRef bitcode,
+        LLVMContext& context) {
+        Expected<module_ptr_t> mod = parseBitcodeFile(MemoryBufferRef(bitcode, "bitcode"), context);
+        if (!mod) {
+            const std::string reason = toString(mod.takeError());
+            return std::unexpected(
+                Error(ErrType::Generator, std::format("Cannot read module: {}", reason)));
+        }
+        return std::move(mod.get());
+    }
 
-        // TODO: replace the static method we stole at the top of this file
-        // with these lines -- but use the input filename transformation
-        std::string Filename = "output.o";
-        std::error_code EC;
-        raw_fd_ostream dest(Filename, EC, sys::fs::OF_None);
+    // Run the codegen passes over `mod`, which must already be set up for `machine`
+    [[nodiscard]] static std::expected<object_t, Error> emitObject(
+        Module& mod,
+        TargetMachine& machine) {
+        object_t object;
+        raw_svector_ostream dest(object);
 
         legacy::PassManager PM;
         auto fileType = CodeGenFileType::ObjectFile;
         // auto fileType = CodeGenFileType::AssemblyFile;
-        if (targetMachine->addPassesToEmitFile(PM, dest, nullptr, fileType)) {
+        if (machine.addPassesToEmitFile(PM, dest, nullptr, fileType)) {
             return std::unexpected(
                 Error(ErrType::Generator, "Unknown error with addPassesToEmitFile"));
         }
 
-        PM.run(*mod);
-        dest.flush();
+        PM.run(mod);
+        return object;
+    }
+
+    // Set `mod` up for the target, check it and optimize it. Everything done with the module
+    // afterwards, from dumping it to running it, sees what this leaves
+    [[nodiscard]] std::expected<TargetMachine*, Error> Backend::prepareModule(module_ptr_t& mod) {
+        std::expected<TargetMachine*, Error> machine = getTargetMachine();
+        if (!machine.has_value()) { return std::unexpected(machine.error()); }
+
+        mod->setDataLayout(machine.value()->createDataLayout());
+        mod->setTargetTriple(targetTriple.value());
+
+        // The passes and codegen assume well-formed IR, which codegen doesn't always
+        // produce yet, so it is checked at every level
+        std::string broken;
+        raw_string_ostream reason(broken);
+        if (verifyModule(*mod, &reason)) {
+            return std::unexpected(
+                Error(ErrType::Generator, std::format("Invalid module: {}", broken)));
+        }
+
+        std::optional<Error> optimized = optimizeModule(mod, machine.value());
+        if (optimized.has_value()) { return std::unexpected(optimized.value()); }
+        return machine;
+    }
 
-        return Filename;
+    // `mod` must have been through `prepareModule`. The object is kept in memory, to be
+    // handed straight to the linker
+    [[nodiscard]] std::expected<object_t, Error> Backend::outputObjectFile(module_ptr_t& mod) {
+        std::expected<TargetMachine*, Error> machine = getTargetMachine();
+        if (!machine.has_value()) { return std::unexpected(machine.error()); }
+        return emitObject(*mod, *machine.value());
+    }
+
+    // Split the module `prepareModule` left into `threads` parts and run codegen on each in
+    // parallel, as LLVM's own parallel codegen for LTO does. The parts share `ctx`, which is
+    // not thread-safe, so each is written out as bitcode and read back into a context of
+    // its own on the thread that compiles it, along with its own target machine
+    [[nodiscard]] std::expected<std::vector<object_t>, Error>
+    Backend::outputObjectFiles(module_ptr_t& mod, std::size_t threads) {
+        std::expected<TargetMachine*, Error> machine = getTargetMachine();
+        if (!machine.has_value()) { return std::unexpected(machine.error()); }
+
+        if (threads <= 1) {
+            std::expected<object_t, Error> object = emitObject(*mod, *machine.value());
+            if (!object.has_value()) { return std::unexpected(object.error()); }
+            std::vector<object_t> objects = {};
+            objects.push_back(std::move(object.value()));
+            return objects;
+        }
+
+        std::vector<SmallString<0>> parts = {};
+        SplitModule(*mod, static_cast<unsigned>(threads), [&parts](std::unique_ptr<Module> part) {
+            raw_svector_ostream dest(parts.emplace_back());
+            WriteBitcodeToFile(*part, dest);
+        });
+
+        std::vector<std::expected<object_t, Error>> results(parts.size());
+        {
+            std::vector<std::jthread> workers = {};
+            workers.reserve(parts.size());
+            for (std::size_t i = 0; i < parts.size(); i++) {
+                workers.emplace_back([this, &parts, &results, i] {
+                    LLVMContext partCtx;
+                    std::expected<module_ptr_t, Error> part = readBitcode(parts[i], partCtx);
+                    if (!part.has_value()) {
+                        results[i] = std::unexpected(part.error());
+                        return;
+                    }
+
+                    std::expected<std::unique_ptr<TargetMachine>, Error> partMachine =
+                        createTargetMachine();
+                    if (!partMachine.has_value()) {
+                        results[i] = std::unexpected(partMachine.error());
+                        return;
+                    }
+                    results[i] = emitObject(*part.value(), *partMachine.value());
+                });
+            }
+        }
+
+        std::vector<object_t> objects = {};
+        objects.reserve(results.size());
+        for (auto& result : results) {
+            if (!result.has_value()) { return std::unexpected(result.error()); }
+            objects.push_back(std::move(result.value()));
+        }
+        return objects;
+    }
+
+    // Output files are named after the input, in the working directory: `foo.wtx` builds
+    // `foo`, and source read from stdin builds `stdin`
+    [[nodiscard]] std::string Backend::outputStem() const {
+        return file_name == "-" ? "stdin" : std::filesystem::path(file_name).stem().string();
+    }
+
+    // Write the optimized IR and the objects of `mod` beside the input, named after it. The
+    // objects of a split module are numbered
+    [[nodiscard]] std::optional<Error> Backend::saveTemps(
+        module_ptr_t& mod,
+        std::span<const object_t> objects) const {
+        const std::string stem = outputStem();
+
+        std::error_code EC;
+        raw_fd_ostream ir(stem + ".ll", EC, sys::fs::OF_Text);
+        if (EC) {
+            return Error(ErrType::IO, std::format("Cannot write '{}.ll': {}", stem, EC.message()));
+        }
+        mod->print(ir, nullptr);
+
+        for (std::size_t i = 0; i < objects.size(); i++) {
+            const std::string path =
+                objects.size() == 1 ? stem + ".o" : std::format("{}.{}.o", stem, i);
+            raw_fd_ostream obj(path, EC, sys::fs::OF_None);
+            if (EC) {
+                return Error(
+                    ErrType::IO, std::format("Cannot write '{}': {}", path, EC.message()));
+            }
+            obj.write(objects[i].data(), objects[i].size());
+        }
+        return std::nullopt;
+    }
+
+    // Copy `object` into an anonymous in-memory file. -1 with errno set on failure
+    [[nodiscard]] static int memoryFile(const object_t& object) {
+        const int fd = ::memfd_create("winter.o", MFD_CLOEXEC);
+        if (fd < 0) { return -1; }
+
+        std::size_t written = 0;
+        while (written < object.size()) {
+            const ssize_t n = ::write(fd, object.data() + written, object.size() - written);
+            if (n < 0) {
+                if (errno == EINTR) { continue; }
+                const int err = errno;
+                ::close(fd);
+                errno = err;
+                return -1;
+            }
+            written += static_cast<std::size_t>(n);
+        }
+        return fd;
     }
 
     // ld.lld output.o -L/usr/lib64/ -lc /usr/lib64/crt1.o /usr/lib64/crti.o /usr/lib64/crtn.o
-    [[nodiscard]] std::optional<Error> Backend::linkModules(std::vector<const char*> files) {
+    // lld only reads objects by path, so each one is given as a memfd under /proc/self/fd.
+    // Nothing is written to disk, and builds sharing a directory can't clobber each other
+    [[nodiscard]] std::optional<Error> Backend::linkModules(std::span<const object_t> objects) {
+        if (crossCompiling()) {
+            return Error(
+                ErrType::Generator,
+                std::format("Cannot link for {}, only for this machine", targetTriple->str()));
+        }
+
+        std::vector<int> fds = {};
+        auto closeAll = [&fds] {
+            for (int fd : fds) { ::close(fd); }
+        };
+
+        // kept alive until lld is done with the pointers into them
+        std::vector<std::string> files = {};
+        for (const object_t& object : objects) {
+            const int fd = memoryFile(object);
+            if (fd < 0) {
+                const int err = errno;
+                closeAll();
+                return Error(
+                    ErrType::IO,
+                    std::format("Cannot create in-memory object: {}", std::strerror(err)));
+            }
+            fds.push_back(fd);
+            files.push_back(std::format("/proc/self/fd/{}", fd));
+        }
+
         // TODO: get the dynamic linker binary name by code
+        const std::string output = outputStem();
         std::vector<const char*> args_v = {
             "ld.lld",
+            "-o",
+            output.c_str(),
             "-L/usr/lib64/",
             "-lc",
             "/usr/lib64/crt1.o",
@@ -289,14 +636,89 @@ namespace Winter {
             "/usr/lib64/crtn.o",
             "--dynamic-linker",
             "/lib64/ld-linux-x86-64.so.2"};
-        args_v.insert(args_v.end(), files.begin(), files.end());
+        for (const std::string& file : files) { args_v.push_back(file.c_str()); }
         auto args = llvm::ArrayRef(args_v);
         lld::Result result =
             lld::lldMain(args, llvm::outs(), llvm::errs(), {{lld::Flavor::Gnu, &lld::elf::link}});
+        closeAll();
         if (result.retCode) {
             return Error(ErrType::Generator, std::format("lld retcode: {}", result.retCode));
         }
         return {};
     }
 
+    // The number of parameters `main` takes, which `runModule` has to call it with.
+    // Either none, or an i32 argc
+    [[nodiscard]] std::expected<std::size_t, Error> Backend::checkMain() const {
+        const DeclId main =
+            sema == nullptr ? 0 : sema->lookup(Sema::globalScope, intern("main"));
+        if (main == 0 || (*sema)[main].kind != DeclKind::function ||
+            (*sema)[main].node == Decl::noNode) {
+            return std::unexpected(Error(ErrType::Generator, "No main function to run"));
+        }
+
+        auto isI32 = [this](DeclId type) { return sema->builtinOf(type) == BuiltinType::i32; };
+        const auto* fn = std::get_if<funcNode>(&ast->child((*sema)[main].node, 0).data);
+        const std::span<const NodeId> params =
+            fn == nullptr ? std::span<const NodeId>() : ast->range(fn->parameters);
+        const bool argc = params.size() == 1 && isI32((*sema)[sema->declOf(params[0])].type);
+        if (fn == nullptr || !(params.empty() || argc) || !isI32((*sema)[main].type)) {
+            return std::unexpected(Error(
+                ErrType::Generator, "main must be `func() i32` or `func(argc: i32) i32`"));
+        }
+        return params.size();
+    }
+
+    // Compile `mod`, which must have been through `prepareModule`, with ORC's LLJIT and
+    // call its `main` in this process. Anything the module doesn't define, libc included,
+    // is looked up in the running process
+    [[nodiscard]] std::expected<int, Error> Backend::runModule(module_ptr_t& mod) {
+        std::expected<std::size_t, Error> mainParams = checkMain();
+        if (!mainParams.has_value()) { return std::unexpected(mainParams.error()); }
+
+        // registers the native target, which the JIT generates code for
+        std::expected<const Target*, Error> target = getTarget();
+        if (!target.has_value()) { return std::unexpected(target.error()); }
+        if (crossCompiling()) {
+            return std::unexpected(
+                Error(ErrType::Generator, "Only code for this machine can be run"));
+        }
+
+        auto jitError = [](llvm::Error err) {
+            return std::unexpected(Error(
+                ErrType::Generator, std::format("JIT: {}", toString(std::move(err)))));
+        };
+
+        Expected<std::unique_ptr<orc::LLJIT>> jit = orc::LLJITBuilder().create();
+        if (!jit) { return jitError(jit.takeError()); }
+
+        mod->setDataLayout((*jit)->getDataLayout());
+        mod->setTargetTriple((*jit)->getTargetTriple());
+
+        Expected<std::unique_ptr<orc::DynamicLibrarySearchGenerator>> host =
+            orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+                (*jit)->getDataLayout().getGlobalPrefix());
+        if (!host) { return jitError(host.takeError()); }
+        (*jit)->getMainJITDylib().addGenerator(std::move(host.get()));
+
+        // The JIT owns the module it runs, context and all
+        SmallString<0> bitcode;
+        raw_svector_ostream dest(bitcode);
+        WriteBitcodeToFile(*mod, dest);
+        auto jitCtx = std::make_unique<LLVMContext>();
+        std::expected<module_ptr_t, Error> jitModule = readBitcode(bitcode, *jitCtx);
+        if (!jitModule.has_value()) { return std::unexpected(jitModule.error()); }
+
+        llvm::Error added = (*jit)->addIRModule(
+            orc::ThreadSafeModule(std::move(jitModule.value()), std::move(jitCtx)));
+        if (added) { return jitError(std::move(added)); }
+
+        Expected<orc::ExecutorAddr> mainAddr = (*jit)->lookup("main");
+        if (!mainAddr) { return jitError(mainAddr.takeError()); }
+
+        // there is no argv to go with it, so argc only counts the program name
+        if (mainParams.value() == 1) { return mainAddr->toPtr<int (*)(int)>()(1); }
+        return mainAddr->toPtr<int (*)()>()();
+    }
+
 }  // namespace Winter
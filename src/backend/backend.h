@@ -1,44 +1,82 @@
 #ifndef WINTER_BACKEND_H
 #define WINTER_BACKEND_H
 
+#include <cstdint>
 #include <expected>
 #include <memory>
 #include <optional>
 #include <span>
+#include <string>
 #include <string_view>
+#include <vector>
 
+#include <llvm/ADT/SmallVector.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Module.h>
 
 #include "../error.h"
 #include "../frontend/parser.h"
+#include "../frontend/sema.h"
 #include "llvm/Target/TargetMachine.h"
 
 namespace Winter {
     using namespace llvm;
     using module_result_t = std::expected<std::unique_ptr<Module>, Error>;
     using module_ptr_t = std::unique_ptr<Module>;
+    using object_t = SmallVector<char, 0>;  // an object file's bytes
+
+    // How hard to optimize, as given by the driver's `-O` flags
+    enum class OptLevel : std::uint8_t { O0, O1, O2, O3, Os };
+
+    // The level named by what follows `-O`, e.g. "2" or "s"
+    [[nodiscard]] constexpr std::optional<OptLevel> parseOptLevel(std::string_view name) {
+        if (name == "0") { return OptLevel::O0; }
+        if (name == "1") { return OptLevel::O1; }
+        if (name == "2") { return OptLevel::O2; }
+        if (name == "3") { return OptLevel::O3; }
+        if (name == "s") { return OptLevel::Os; }
+        return std::nullopt;
+    }
 
     struct Backend {
         LLVMContext ctx;
-        Node currentNode;
-        std::optional<Triple> targetTriple = std::nullopt;
+        const Ast* ast = nullptr;    // tree being compiled, set by `compileModule`
+        const Sema* sema = nullptr;  // and what analysis found in it
+        NodeId currentNode = 0;
+        std::optional<Triple> targetTriple = std::nullopt;  // the host's, unless set
+        std::unique_ptr<TargetMachine> targetMachine = nullptr;
         std::string_view file_name;
+        std::vector<Function*> functions = {};  // by DeclId
+        OptLevel optLevel = OptLevel::O0;
 
-        Backend(std::string_view fName) : currentNode(Node::tombstone()), file_name(fName) {}
-        [[nodiscard]] std::expected<Type*, Error> getType(std::string_view);
+        Backend(std::string_view fName, OptLevel level = OptLevel::O0)
+            : file_name(fName), optLevel(level) {}
+        [[nodiscard]] std::expected<Type*, Error> getType(BuiltinType);
+        [[nodiscard]] bool crossCompiling() const;
         [[nodiscard]] std::expected<const Target*, Error> getTarget();
+        [[nodiscard]] std::expected<std::unique_ptr<TargetMachine>, Error> createTargetMachine();
+        [[nodiscard]] std::expected<TargetMachine*, Error> getTargetMachine();
         [[nodiscard]] std::optional<Error> createFunction(module_ptr_t&, const letNode*);
-        [[nodiscard]] BasicBlock* createBlock(module_ptr_t&, const letNode*);
-        [[nodiscard]] Value* compileExpression(IRBuilder<>*);
-        [[nodiscard]] Value* compileNumLit();
-        void populateBlock(BasicBlock*);
+        [[nodiscard]] BasicBlock* createBlock(DeclId);
+        [[nodiscard]] std::expected<Value*, Error> compileExpression(IRBuilder<>*);
+        [[nodiscard]] std::expected<Value*, Error> compileNumLit();
+        [[nodiscard]] std::expected<Constant*, Error> numConstant(const NumValue&, BuiltinType);
+        [[nodiscard]] std::optional<Error> populateBlock(BasicBlock*);
         void insertStart(module_ptr_t&);
-        [[nodiscard]] module_result_t compileModule(std::span<Node>);
+        [[nodiscard]] module_result_t compileModule(const Ast&, const Sema&);
         void display_module(module_ptr_t&) const;
-        void emitBitcodeFile(module_ptr_t&) const;
-        [[nodiscard]] std::expected<std::string, Error> outputObjectFile(module_ptr_t&);
-        [[nodiscard]] std::optional<Error> linkModules(std::vector<const char*>);
+        [[nodiscard]] std::string outputStem() const;
+        [[nodiscard]] std::optional<Error> emitBitcodeFile(module_ptr_t&) const;
+        [[nodiscard]] std::optional<Error> optimizeModule(module_ptr_t&, TargetMachine*);
+        [[nodiscard]] std::expected<TargetMachine*, Error> prepareModule(module_ptr_t&);
+        [[nodiscard]] std::expected<object_t, Error> outputObjectFile(module_ptr_t&);
+        [[nodiscard]] std::expected<std::vector<object_t>, Error>
+        outputObjectFiles(module_ptr_t&, std::size_t threads);
+        [[nodiscard]] std::optional<Error>
+        saveTemps(module_ptr_t&, std::span<const object_t>) const;
+        [[nodiscard]] std::optional<Error> linkModules(std::span<const object_t>);
+        [[nodiscard]] std::expected<std::size_t, Error> checkMain() const;
+        [[nodiscard]] std::expected<int, Error> runModule(module_ptr_t&);
     };
 }  // namespace Winter
 
@@ -9,7 +9,9 @@ namespace Winter {
     enum class ErrType : std::uint8_t {
         Lexer,
         Parser,
+        Sema,
         Generator,
+        IO,
         NotImplemented,
         none
     };
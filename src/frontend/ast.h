@@ -1,14 +1,22 @@
 #ifndef WINTER_AST_H
 #define WINTER_AST_H
 
+#include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <format>
+#include <initializer_list>
+#include <limits>
 #include <optional>
+#include <span>
 #include <string>
+#include <type_traits>
 #include <variant>
 #include <vector>
 
+#include "intern.h"
 #include "lexer.h"
+#include "numeric.h"
 
 namespace Winter {
     enum class NodeType : std::uint8_t {
@@ -41,6 +49,8 @@ namespace Winter {
 
         error
     };
+    // `error` is always the last node type
+    inline constexpr std::size_t nodeTypeCount = static_cast<std::size_t>(NodeType::error) + 1;
 }  // namespace Winter
 
 template <>
@@ -119,22 +129,32 @@ namespace Winter {
         [[nodiscard]] std::string display() const { return ""; }
     };
 
+    // Index of a node in its `Ast`
+    using NodeId = std::uint32_t;
+
+    // `count` consecutive entries of `Ast::edges`, starting at `first`
+    struct NodeRange {
+        std::uint32_t first = 0;
+        std::uint32_t count = 0;
+    };
+
     template <typename... Ts>
     struct _Node {
+        using Data = std::variant<Ts...>;
+
         NodeType type;
-        std::variant<Ts...> data;
-        std::vector<_Node> children;
+        Data data;
+        NodeRange children;
 
-        [[nodiscard]] explicit _Node(NodeType t, std::variant<Ts...> d)
-            : type(t), data(d), children({}) {}
+        [[nodiscard]] explicit _Node(NodeType t, Data d) : type(t), data(d), children({}) {}
 
-        [[nodiscard]] explicit _Node(NodeType t, std::variant<Ts...> d, std::vector<_Node> c)
+        [[nodiscard]] explicit _Node(NodeType t, Data d, NodeRange c)
             : type(t), data(d), children(c) {}
 
         [[nodiscard]] static _Node tombstone() { return _Node(NodeType::error, TOMBSTONE()); }
 
         [[nodiscard]] bool operator==(this const _Node& self, const _Node& other) {
-            return self.type == other.type && self.children.size() == other.children.size();
+            return self.type == other.type && self.children.count == other.children.count;
         };
     };
 
@@ -172,7 +192,7 @@ namespace Winter {
             type,
             func
         };
-        std::string ident;
+        Symbol ident;
         childType tag;
 
         [[nodiscard]] std::string display() const {
@@ -182,7 +202,7 @@ namespace Winter {
     };
 
     struct typeAlias {
-        std::string type;
+        Symbol type;
 
         [[nodiscard]] std::string display() const {
             return std::format("typeAlias[ type:{} ]", type);
@@ -198,13 +218,13 @@ namespace Winter {
     };
 
     struct argNode {
-        std::optional<std::string> str;
-        std::optional<int> num;
+        std::optional<Symbol> str;
+        std::optional<NumValue> num;
         std::optional<char> ch;
 
         [[nodiscard]] std::string display() const {
             return std::format(
-                "ArgNode[ str:{} num:{} char:{} ]", str.has_value() ? str.value() : "_",
+                "ArgNode[ str:{} num:{} char:{} ]", str.has_value() ? str.value().str() : "_"sv,
                 num.has_value() ? std::format("{}", num.value()) : "_",
                 ch.has_value() ? std::format("{}", ch.value()) : "_");
         }
@@ -228,7 +248,7 @@ namespace Winter {
 
     struct caseNode {
         bool fallthrough;  // falls through to another node as a child
-        std::string ident;
+        Symbol ident;
         bool defaultCase;
 
         [[nodiscard]] std::string display() const {
@@ -250,12 +270,12 @@ namespace Winter {
     struct classNode {
         int attrCount;
         int methodCount;
-        std::optional<std::string> interface = std::nullopt;
+        std::optional<Symbol> interface = std::nullopt;
 
         [[nodiscard]] std::string display() const {
             return std::format(
                 "ClassNode[ attributes:{}, methods:{}, Interface:{} ]", attrCount, methodCount,
-                interface.has_value() ? interface.value() : "NONE");
+                interface.has_value() ? interface.value().str() : "NONE"sv);
         }
     };
 
@@ -270,8 +290,10 @@ namespace Winter {
     struct exprNode {
         int childCount;
         std::optional<TokenType> op;
+        std::uint32_t offset = 0;  // source offset of the operator, for errors
 
-        explicit exprNode(int c, TokenType tok) : childCount(c), op(tok) {}
+        explicit exprNode(int c, TokenType tok, std::uint32_t at)
+            : childCount(c), op(tok), offset(at) {}
         explicit exprNode(int c) : childCount(c), op(std::nullopt) {}
 
         [[nodiscard]] std::string display() const {
@@ -287,17 +309,17 @@ namespace Winter {
 
     struct funcNode {
         int childCount;
-        std::string name;
-        std::vector<Node> parameters;
-        std::string retType;
+        Symbol name;
+        NodeRange parameters;  // paramNodes, separate from the body in `children`
+        Symbol retType;
 
         [[nodiscard]] std::string display() const {
-            return std::format("FuncNode[ params:{}, returnType:{} ]", parameters.size(), retType);
+            return std::format("FuncNode[ params:{}, returnType:{} ]", parameters.count, retType);
         }
     };
 
     struct funcCallNode {
-        std::string name;
+        Symbol name;
 
         [[nodiscard]] std::string display() const {
             return std::format("FuncCallNode[ name:{} ]", name);
@@ -305,7 +327,7 @@ namespace Winter {
     };
 
     struct identNode {
-        std::string value;
+        Symbol value;
 
         [[nodiscard]] std::string display() const {
             return std::format("identNode[ value:{} ]", value);
@@ -331,7 +353,7 @@ namespace Winter {
 
     struct letNode {
         static const int childCount = 1;
-        std::string name;
+        Symbol name;
         bool isFunc;
         bool isConst;
 
@@ -341,7 +363,7 @@ namespace Winter {
     };
 
     struct modNode {
-        std::string name;
+        Symbol name;
 
         [[nodiscard]] std::string display() const {
             return std::format("ModNode[ name:{} ]", name);
@@ -349,8 +371,8 @@ namespace Winter {
     };
 
     struct paramNode {
-        std::string name;
-        std::string type;
+        Symbol name;
+        Symbol type;
 
         [[nodiscard]] std::string display() const {
             return std::format("ParamNode[ name:{}, type:{} ]", name, type);
@@ -358,7 +380,7 @@ namespace Winter {
     };
 
     struct numlitNode {
-        int value;
+        NumValue value;
 
         [[nodiscard]] std::string display() const {
             return std::format("NumLitNode[ val:{} ]", value);
@@ -370,7 +392,7 @@ namespace Winter {
     };
 
     struct strLitNode {
-        std::string value;
+        Symbol value;
 
         [[nodiscard]] std::string display() const {
             return std::format("strLitNode[ value:{} ]", value);
@@ -378,7 +400,7 @@ namespace Winter {
     };
 
     struct switchNode {
-        std::string ident;
+        Symbol ident;
         int caseCount;     // including default
         bool defaultCase;  // included in children
 
@@ -398,8 +420,8 @@ namespace Winter {
 
     struct varNode {
         int childCount;
-        std::string name;
-        std::string type;
+        Symbol name;
+        Symbol type;
         bool isConst;
 
         [[nodiscard]] std::string display() const {
@@ -409,6 +431,104 @@ namespace Winter {
         }
     };
 
+    // Nodes are copied around freely by index-based code, so payloads must stay plain data.
+    // They are also cached as raw bytes: when changing a payload, bump
+    // `CacheHeader::formatVersion`, list any new Symbol field in cache.cpp and keep its
+    // `payloadTypes` in the same order as `Node::Data`
+    static_assert(std::is_trivially_copyable_v<Node>);
+
+    // Every node of a parsed file, in one pool. Nodes refer to their children by index, and
+    // each node's children are one contiguous run of `edges`, so building a tree costs a
+    // handful of amortised vector growths and freeing it is three deallocations
+    struct Ast {
+        std::vector<Node> nodes = {};
+        std::vector<NodeId> edges = {};
+        std::vector<NodeId> roots = {};  // top-level items, in source order
+
+        [[nodiscard]] NodeRange addRange(std::span<const NodeId> ids) {
+            assert(edges.size() + ids.size() <= std::numeric_limits<std::uint32_t>::max());
+            const auto first = static_cast<std::uint32_t>(edges.size());
+            edges.insert(edges.end(), ids.begin(), ids.end());
+            return NodeRange(first, static_cast<std::uint32_t>(ids.size()));
+        }
+
+        [[nodiscard]] NodeId add(const Node& node) {
+            assert(nodes.size() < std::numeric_limits<NodeId>::max());
+            nodes.push_back(node);
+            return static_cast<NodeId>(nodes.size() - 1);
+        }
+
+        [[nodiscard]] NodeId add(NodeType type, Node::Data data, std::span<const NodeId> children) {
+            return add(Node(type, data, addRange(children)));
+        }
+
+        [[nodiscard]] NodeId
+        add(NodeType type, Node::Data data, std::initializer_list<NodeId> children = {}) {
+            return add(type, data, std::span(children.begin(), children.size()));
+        }
+
+        // Append every node of `other`, shifting its ids and edge ranges past our own.
+        // Its roots follow ours, so trees of consecutive parts of a file join in order
+        void append(const Ast& other) {
+            assert(nodes.size() + other.nodes.size() <= std::numeric_limits<NodeId>::max());
+            assert(edges.size() + other.edges.size() <= std::numeric_limits<std::uint32_t>::max());
+            const auto nodeBase = static_cast<NodeId>(nodes.size());
+            const auto edgeBase = static_cast<std::uint32_t>(edges.size());
+
+            nodes.reserve(nodes.size() + other.nodes.size());
+            for (Node node : other.nodes) {
+                node.children.first += edgeBase;
+                if (auto* fn = std::get_if<funcNode>(&node.data)) {
+                    fn->parameters.first += edgeBase;
+                }
+                nodes.push_back(node);
+            }
+
+            edges.reserve(edges.size() + other.edges.size());
+            for (NodeId id : other.edges) { edges.push_back(nodeBase + id); }
+            for (NodeId id : other.roots) { roots.push_back(nodeBase + id); }
+        }
+
+        // Copy the tree under `id` in `from` into this pool, children first. Child ids wait
+        // on `stack` until their parent is added, and the stack is left as it was found
+        [[nodiscard]] NodeId copyTree(const Ast& from, NodeId id, std::vector<NodeId>& stack) {
+            auto copyAll = [&](std::span<const NodeId> ids) {
+                const std::size_t mark = stack.size();
+                for (NodeId child : ids) { stack.push_back(copyTree(from, child, stack)); }
+                const NodeRange r = addRange(std::span(stack).subspan(mark));
+                stack.resize(mark);
+                return r;
+            };
+
+            Node node = from[id];
+            if (auto* fn = std::get_if<funcNode>(&node.data)) {
+                fn->parameters = copyAll(from.range(fn->parameters));
+            }
+            node.children = copyAll(from.children(id));
+            return add(node);
+        }
+
+        [[nodiscard]] const Node& operator[](NodeId id) const { return nodes[id]; }
+        [[nodiscard]] Node& operator[](NodeId id) { return nodes[id]; }
+        [[nodiscard]] std::size_t size() const noexcept { return nodes.size(); }
+
+        [[nodiscard]] std::span<const NodeId> range(NodeRange r) const {
+            return std::span(edges).subspan(r.first, r.count);
+        }
+
+        [[nodiscard]] std::span<const NodeId> children(NodeId id) const {
+            return range(nodes[id].children);
+        }
+
+        [[nodiscard]] NodeId childId(NodeId id, std::size_t i) const {
+            return children(id)[i];
+        }
+
+        [[nodiscard]] const Node& child(NodeId id, std::size_t i) const {
+            return nodes[childId(id, i)];
+        }
+    };
+
 }  // namespace Winter
 
 #endif  // WINTER_AST_H
@@ -0,0 +1,331 @@
+#include "cache.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <span>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../source.h"
+
+namespace Winter {
+    // Call `fn` on every Symbol in a node's payload. Keep in step with the payloads in
+    // ast.h, as a symbol missed here would be stored as a meaningless id
+    template <typename Fn>
+    static void forEachSymbol(Node& node, Fn&& fn) {
+        std::visit(
+            [&fn](auto& v) {
+                using T = std::decay_t<decltype(v)>;
+                if constexpr (
+                    std::is_same_v<T, aliasNode> || std::is_same_v<T, caseNode> ||
+                    std::is_same_v<T, switchNode>) {
+                    fn(v.ident);
+                } else if constexpr (std::is_same_v<T, typeAlias>) {
+                    fn(v.type);
+                } else if constexpr (std::is_same_v<T, argNode>) {
+                    if (v.str.has_value()) { fn(v.str.value()); }
+                } else if constexpr (std::is_same_v<T, classNode>) {
+                    if (v.interface.has_value()) { fn(v.interface.value()); }
+                } else if constexpr (std::is_same_v<T, funcNode>) {
+                    fn(v.name);
+                    fn(v.retType);
+                } else if constexpr (
+                    std::is_same_v<T, funcCallNode> || std::is_same_v<T, letNode> ||
+                    std::is_same_v<T, modNode>) {
+                    fn(v.name);
+                } else if constexpr (
+                    std::is_same_v<T, identNode> || std::is_same_v<T, strLitNode>) {
+                    fn(v.value);
+                } else if constexpr (std::is_same_v<T, paramNode> || std::is_same_v<T, varNode>) {
+                    fn(v.name);
+                    fn(v.type);
+                }
+            },
+            node.data);
+    }
+
+    template <typename T>
+    static void appendRaw(std::string& out, const T* data, std::size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        out.append(reinterpret_cast<const char*>(data), count * sizeof(T));
+    }
+
+    // Copy `count` values of T off the front of `in`
+    template <typename T>
+    [[nodiscard]] static bool readRaw(std::string_view& in, T* out, std::size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const std::size_t bytes = count * sizeof(T);
+        if (in.size() < bytes) { return false; }
+        if (bytes != 0) { std::memcpy(static_cast<void*>(out), in.data(), bytes); }
+        in.remove_prefix(bytes);
+        return true;
+    }
+
+    // Copy of `node` with every byte that isn't part of its value zeroed: padding, and the
+    // rest of the variant when the payload is smaller than the largest. Otherwise those
+    // bytes are whatever the parser's temporaries left, and the same tree gives a
+    // different file each time
+    static void copyZeroed(Node& to, const Node& from) {
+        std::memset(static_cast<void*>(&to), 0, sizeof(Node));
+        to.type = from.type;
+        to.children = from.children;
+        std::visit(
+            [&to](const auto& v) {
+                [[maybe_unused]] auto& payload = to.data.emplace<std::decay_t<decltype(v)>>(v);
+#if __has_builtin(__builtin_clear_padding)
+                __builtin_clear_padding(&payload);
+#endif
+            },
+            from.data);
+#if __has_builtin(__builtin_clear_padding)
+        __builtin_clear_padding(&to);
+#endif
+    }
+
+    [[nodiscard]] std::string serializeAst(const Ast& tree, const SourceDigest& source) {
+        std::vector<Node> nodes(tree.nodes.size(), Node::tombstone());
+        for (std::size_t i = 0; i < nodes.size(); i++) { copyZeroed(nodes[i], tree.nodes[i]); }
+        std::vector<std::string_view> strings = {""};
+        std::unordered_map<std::uint32_t, std::uint32_t> indices = {{0, 0}};
+
+        for (Node& node : nodes) {
+            forEachSymbol(node, [&strings, &indices](Symbol& sym) {
+                const auto next = static_cast<std::uint32_t>(strings.size());
+                const auto [it, inserted] = indices.try_emplace(sym.id, next);
+                if (inserted) { strings.push_back(sym.str()); }
+                sym = Symbol(it->second);
+            });
+        }
+
+        std::vector<std::uint32_t> lengths = {};
+        lengths.reserve(strings.size());
+        std::size_t stringBytes = 0;
+        for (std::string_view s : strings) {
+            lengths.push_back(static_cast<std::uint32_t>(s.size()));
+            stringBytes += s.size();
+        }
+
+        CacheHeader header = {};
+        header.source = source;
+        header.nodeCount = static_cast<std::uint32_t>(nodes.size());
+        header.edgeCount = static_cast<std::uint32_t>(tree.edges.size());
+        header.rootCount = static_cast<std::uint32_t>(tree.roots.size());
+        header.stringCount = static_cast<std::uint32_t>(strings.size());
+        header.stringBytes = static_cast<std::uint32_t>(stringBytes);
+
+        std::string out = {};
+        out.reserve(
+            sizeof(CacheHeader) + nodes.size() * sizeof(Node) +
+            (tree.edges.size() + tree.roots.size() + lengths.size()) * sizeof(std::uint32_t) +
+            stringBytes);
+        appendRaw(out, &header, 1);
+        appendRaw(out, nodes.data(), nodes.size());
+        appendRaw(out, tree.edges.data(), tree.edges.size());
+        appendRaw(out, tree.roots.data(), tree.roots.size());
+        appendRaw(out, lengths.data(), lengths.size());
+        for (std::string_view s : strings) { out.append(s); }
+        return out;
+    }
+
+    // The NodeType each payload is tagged with, by its index in `Node::Data`
+    static constexpr auto payloadTypes = std::to_array<NodeType>({
+        NodeType::aliasNode, NodeType::typeAlias, NodeType::funcAlias, NodeType::argNode,
+        NodeType::bodyNode, NodeType::boolNode, NodeType::caseNode, NodeType::classNode,
+        NodeType::charLitNode, NodeType::enumNode, NodeType::exprNode, NodeType::forNode,
+        NodeType::callNode, NodeType::funcNode, NodeType::identNode, NodeType::ifNode,
+        NodeType::interfaceNode, NodeType::letNode, NodeType::modNode, NodeType::numlitNode,
+        NodeType::paramNode, NodeType::returnNode, NodeType::strLitNode, NodeType::switchNode,
+        NodeType::typeNode, NodeType::varNode, NodeType::error,
+    });
+    static_assert(payloadTypes.size() == std::variant_size_v<Node::Data>);
+
+    // Every edge in `range` exists and points below `owner`. The arena always adds
+    // children before their parent, so this also keeps a loaded tree free of cycles
+    [[nodiscard]] static bool validRange(const Ast& tree, NodeRange range, NodeId owner) {
+        if (static_cast<std::size_t>(range.first) + range.count > tree.edges.size()) {
+            return false;
+        }
+        return std::ranges::all_of(tree.range(range), [owner](NodeId id) { return id < owner; });
+    }
+
+    template <typename T>
+    [[nodiscard]] static bool holds(const Ast& tree, NodeId id) {
+        return std::holds_alternative<T>(tree[id].data);
+    }
+
+    // The parts of a node's shape that later passes rely on without checking, as the
+    // parser never builds anything else
+    [[nodiscard]] static bool wellShaped(const Ast& tree, const Node& node) {
+        const std::span<const NodeId> children = tree.range(node.children);
+        auto idents = [&tree, children] {
+            return std::ranges::all_of(
+                children, [&tree](NodeId id) { return holds<identNode>(tree, id); });
+        };
+
+        return std::visit(
+            [&](const auto& v) {
+                using T = std::decay_t<decltype(v)>;
+                if constexpr (std::is_same_v<T, letNode>) {
+                    return !children.empty() && (!v.isFunc || holds<funcNode>(tree, children[0]));
+                } else if constexpr (std::is_same_v<T, varNode>) {
+                    return v.childCount == 0 || !children.empty();
+                } else if constexpr (std::is_same_v<T, exprNode>) {
+                    return !v.op.has_value() || children.size() == 1 || children.size() == 2;
+                } else if constexpr (std::is_same_v<T, aliasNode> || std::is_same_v<T, forNode>) {
+                    return !children.empty();
+                } else if constexpr (std::is_same_v<T, enumNode> || std::is_same_v<T, funcAlias>) {
+                    return idents();
+                } else {
+                    return true;
+                }
+            },
+            node.data);
+    }
+
+    [[nodiscard]] std::expected<Ast, Error>
+    deserializeAst(std::string_view in, const SourceDigest& source) {
+        auto invalid = [](std::string_view why) {
+            return std::unexpected(Error(ErrType::IO, std::format("AST cache: {}", why)));
+        };
+
+        CacheHeader header = {};
+        if (!readRaw(in, &header, 1)) { return invalid("truncated header"); }
+        if (header.magic != CacheHeader::expectedMagic) { return invalid("not a cache file"); }
+        if (!header.sameLayout()) { return invalid("written by a different version"); }
+        if (header.source != source) { return invalid("source has changed"); }
+
+        // Sizes are checked against the file before anything is allocated from them
+        const std::size_t indexCount = static_cast<std::size_t>(header.edgeCount) +
+                                       header.rootCount + header.stringCount;
+        const std::size_t expectedSize = header.nodeCount * sizeof(Node) +
+                                         indexCount * sizeof(std::uint32_t) + header.stringBytes;
+        if (in.size() != expectedSize) { return invalid("truncated"); }
+
+        Ast tree = {};
+        std::vector<std::uint32_t> lengths(header.stringCount);
+        tree.nodes.resize(header.nodeCount, Node::tombstone());
+        tree.edges.resize(header.edgeCount);
+        tree.roots.resize(header.rootCount);
+        if (!readRaw(in, tree.nodes.data(), tree.nodes.size()) ||
+            !readRaw(in, tree.edges.data(), tree.edges.size()) ||
+            !readRaw(in, tree.roots.data(), tree.roots.size()) ||
+            !readRaw(in, lengths.data(), lengths.size())) {
+            return invalid("truncated");
+        }
+
+        std::vector<Symbol> symbols = {};
+        symbols.reserve(lengths.size());
+        for (std::uint32_t len : lengths) {
+            if (in.size() < len) { return invalid("bad string table"); }
+            symbols.push_back(intern(in.substr(0, len)));
+            in.remove_prefix(len);
+        }
+        if (!in.empty()) { return invalid("bad string table"); }
+
+        // Check every index and the shape of every node before the tree is handed out,
+        // so a damaged file can't send a later pass out of bounds or round in a cycle
+        for (NodeId id : tree.edges) {
+            if (id >= tree.nodes.size()) { return invalid("bad edge"); }
+        }
+        for (NodeId id : tree.roots) {
+            if (id >= tree.nodes.size()) { return invalid("bad root"); }
+        }
+
+        for (std::size_t i = 0; i < tree.nodes.size(); i++) {
+            Node& node = tree.nodes[i];
+            const auto id = static_cast<NodeId>(i);
+            if (node.data.index() >= std::variant_size_v<Node::Data> ||
+                payloadTypes[node.data.index()] != node.type) {
+                return invalid("bad node");
+            }
+            if (!validRange(tree, node.children, id)) { return invalid("bad edge"); }
+            if (const auto* fn = std::get_if<funcNode>(&node.data)) {
+                if (!validRange(tree, fn->parameters, id)) { return invalid("bad edge"); }
+            }
+
+            bool symbolsOk = true;
+            forEachSymbol(node, [&symbols, &symbolsOk](Symbol& sym) {
+                if (sym.id >= symbols.size()) {
+                    symbolsOk = false;
+                    return;
+                }
+                sym = symbols[sym.id];
+            });
+            if (!symbolsOk) { return invalid("bad symbol"); }
+        }
+        for (const Node& node : tree.nodes) {
+            if (!wellShaped(tree, node)) { return invalid("bad node"); }
+        }
+
+        return tree;
+    }
+
+    [[nodiscard]] std::string AstCache::pathFor(std::uint64_t sourceHash) const {
+        return std::format("{}/{:016x}.ast", dir, sourceHash);
+    }
+
+    // Cache files are mapped rather than read, the same way source files are
+    [[nodiscard]] std::expected<Ast, Error> AstCache::load(std::string_view src) const {
+        const SourceDigest source = digestSource(src);
+        std::expected<SourceFile, Error> file = SourceFile::open(pathFor(source.hash));
+        if (!file.has_value()) { return std::unexpected(file.error()); }
+        return deserializeAst(file.value().text, source);
+    }
+
+    // Written to a temporary file and renamed into place, so concurrent builds sharing a
+    // cache never see a partial entry
+    [[nodiscard]] std::optional<Error>
+    AstCache::store(std::string_view src, const Ast& tree) const {
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+        if (ec) {
+            return Error(
+                ErrType::IO, std::format("Cannot create cache dir '{}': {}", dir, ec.message()));
+        }
+
+        const SourceDigest source = digestSource(src);
+        const std::string bytes = serializeAst(tree, source);
+        const std::string path = pathFor(source.hash);
+        const std::string tmp = std::format("{}.{}.tmp", path, ::getpid());
+
+        const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return Error(
+                ErrType::IO, std::format("Cannot write '{}': {}", tmp, std::strerror(errno)));
+        }
+
+        std::size_t written = 0;
+        while (written < bytes.size()) {
+            const ssize_t n = ::write(fd, bytes.data() + written, bytes.size() - written);
+            if (n < 0) {
+                if (errno == EINTR) { continue; }
+                const int err = errno;
+                ::close(fd);
+                ::unlink(tmp.c_str());
+                return Error(
+                    ErrType::IO, std::format("Cannot write '{}': {}", tmp, std::strerror(err)));
+            }
+            written += static_cast<std::size_t>(n);
+        }
+        ::close(fd);
+
+        if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+            const int err = errno;
+            ::unlink(tmp.c_str());
+            return Error(
+                ErrType::IO, std::format("Cannot write '{}': {}", path, std::strerror(err)));
+        }
+        return std::nullopt;
+    }
+}  // namespace Winter
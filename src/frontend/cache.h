@@ -0,0 +1,67 @@
+#ifndef WINTER_CACHE_H
+#define WINTER_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+
+#include "../error.h"
+#include "ast.h"
+#include "hash.h"
+
+namespace Winter {
+    // Start of a serialized tree. Nodes are stored as their in-memory bytes, so a cache
+    // is only valid for the build that wrote it: bump `formatVersion` whenever a payload
+    // changes. The layout fields catch most changes that are missed: a resized node, or
+    // an added token type, node type or payload. An entry is only used for source of the
+    // same length and both hashes
+    struct CacheHeader {
+        static constexpr std::uint32_t formatVersion = 4;
+        static constexpr std::uint32_t expectedMagic = 0x54534157;  // "WAST"
+
+        std::uint32_t magic = expectedMagic;
+        std::uint32_t version = formatVersion;
+        SourceDigest source = {};
+        std::uint32_t nodeSize = sizeof(Node);
+        std::uint32_t payloadCount = std::variant_size_v<Node::Data>;
+        std::uint32_t nodeTypes = nodeTypeCount;
+        std::uint32_t tokenTypes = tokenTypeCount;
+        std::uint32_t reserved = 0;  // keeps the header free of padding
+        std::uint32_t nodeCount = 0;
+        std::uint32_t edgeCount = 0;
+        std::uint32_t rootCount = 0;
+        std::uint32_t stringCount = 0;  // entries of the string table
+        std::uint32_t stringBytes = 0;  // total length of their text
+
+        [[nodiscard]] bool sameLayout() const noexcept {
+            const CacheHeader current = {};
+            return version == current.version && nodeSize == current.nodeSize &&
+                   payloadCount == current.payloadCount && nodeTypes == current.nodeTypes &&
+                   tokenTypes == current.tokenTypes;
+        }
+    };
+    // written as it is, so every byte has to be a field
+    static_assert(std::has_unique_object_representations_v<CacheHeader>);
+
+    // Layout: header, nodes, edges, roots, string lengths, string text. Symbols in the
+    // nodes are replaced by their index in the string table, and re-interned on load
+    [[nodiscard]] std::string serializeAst(const Ast&, const SourceDigest&);
+    [[nodiscard]] std::expected<Ast, Error> deserializeAst(std::string_view, const SourceDigest&);
+
+    // A directory of serialized trees, one file per distinct source text. Any
+    // missing, stale or damaged entry is reported as an error and treated as a miss
+    struct AstCache {
+        std::string dir;
+
+        [[nodiscard]] std::string pathFor(std::uint64_t sourceHash) const;
+        [[nodiscard]] std::expected<Ast, Error> load(std::string_view src) const;
+        [[nodiscard]] std::optional<Error> store(std::string_view src, const Ast&) const;
+    };
+}  // namespace Winter
+
+#endif  // WINTER_CACHE_H
@@ -0,0 +1,222 @@
+#include "fold.h"
+
+#include <cstdint>
+#include <format>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+
+#include "intern.h"
+#include "lexer.h"
+#include "numeric.h"
+#include "sema.h"
+#include "walk.h"
+
+namespace Winter {
+    // The literal an expression folds to, or nothing if it has to be left for codegen
+    using Fold_Result = std::expected<std::optional<Node>, Error>;
+
+    [[nodiscard]] static Node numLiteral(NumValue value) {
+        return Node(NodeType::numlitNode, numlitNode(value));
+    }
+
+    [[nodiscard]] static Node boolLiteral(bool value) {
+        return Node(NodeType::boolNode, boolNode(value));
+    }
+
+    [[nodiscard]] static std::unexpected<Error>
+    foldError(std::string_view msg, std::int64_t lhs, TokenType op, std::int64_t rhs) {
+        return std::unexpected(Error(
+            ErrType::Sema, std::format("{} in constant expression: {} {} {}", msg, lhs, op, rhs)));
+    }
+
+    [[nodiscard]] static constexpr bool isFloat(BuiltinType type) noexcept {
+        return type == BuiltinType::f32 || type == BuiltinType::f64;
+    }
+
+    // Whether `value` is in the range of the integer type `type`
+    [[nodiscard]] static constexpr bool fits(std::int64_t value, BuiltinType type) noexcept {
+        switch (type) {
+            case BuiltinType::i8:  return std::in_range<std::int8_t>(value);
+            case BuiltinType::i16: return std::in_range<std::int16_t>(value);
+            case BuiltinType::i32: return std::in_range<std::int32_t>(value);
+            case BuiltinType::u8:  return std::in_range<std::uint8_t>(value);
+            case BuiltinType::u16: return std::in_range<std::uint16_t>(value);
+            case BuiltinType::u32: return std::in_range<std::uint32_t>(value);
+            case BuiltinType::u64: return value >= 0;
+            default:               return true;
+        }
+    }
+
+    // Integer arithmetic is done in 64 bits, the range of an integer literal, and the
+    // result has to fit the type analysis gave the expression
+    [[nodiscard]] static Fold_Result
+    foldInt(TokenType op, std::int64_t lhs, std::int64_t rhs, BuiltinType type) {
+        std::int64_t result = 0;
+        bool overflow = false;
+        switch (op) {
+            case TokenType::plus:  overflow = __builtin_add_overflow(lhs, rhs, &result); break;
+            case TokenType::minus: overflow = __builtin_sub_overflow(lhs, rhs, &result); break;
+            case TokenType::star:  overflow = __builtin_mul_overflow(lhs, rhs, &result); break;
+            case TokenType::slash:
+                if (rhs == 0) { return foldError("Division by zero", lhs, op, rhs); }
+                overflow = lhs == std::numeric_limits<std::int64_t>::min() && rhs == -1;
+                if (!overflow) { result = lhs / rhs; }
+                break;
+            default: return std::nullopt;
+        }
+
+        if (overflow || !fits(result, type)) { return foldError("Integer overflow", lhs, op, rhs); }
+        return numLiteral(NumValue(result));
+    }
+
+    [[nodiscard]] static std::optional<Node> foldFloat(TokenType op, double lhs, double rhs) {
+        switch (op) {
+            case TokenType::plus:  return numLiteral(NumValue(lhs + rhs));
+            case TokenType::minus: return numLiteral(NumValue(lhs - rhs));
+            case TokenType::star:  return numLiteral(NumValue(lhs * rhs));
+            case TokenType::slash: return numLiteral(NumValue(lhs / rhs));
+            default:               return std::nullopt;
+        }
+    }
+
+    template <typename T>
+    [[nodiscard]] static std::optional<Node> foldCompare(TokenType op, T lhs, T rhs) {
+        switch (op) {
+            case TokenType::op_equal_eq:   return boolLiteral(lhs == rhs);
+            case TokenType::op_not_eq:     return boolLiteral(lhs != rhs);
+            case TokenType::op_greater:    return boolLiteral(lhs > rhs);
+            case TokenType::op_greater_eq: return boolLiteral(lhs >= rhs);
+            case TokenType::op_less:       return boolLiteral(lhs < rhs);
+            case TokenType::op_less_eq:    return boolLiteral(lhs <= rhs);
+            default:                       return std::nullopt;
+        }
+    }
+
+    [[nodiscard]] static double toDouble(NumValue num) {
+        return num.isInteger() ? static_cast<double>(num.integer().value())
+                               : num.floating().value();
+    }
+
+    // Both operands have `type`, the one analysis settled them to. An integer literal
+    // settled to a float is emitted as one, so it is folded as one too
+    [[nodiscard]] static Fold_Result
+    foldNum(TokenType op, NumValue lhs, NumValue rhs, BuiltinType type) {
+        if (isFloat(type) || !lhs.isInteger() || !rhs.isInteger()) {
+            if (auto cmp = foldCompare(op, toDouble(lhs), toDouble(rhs))) { return cmp; }
+            return foldFloat(op, toDouble(lhs), toDouble(rhs));
+        }
+
+        if (auto cmp = foldCompare(op, lhs.integer().value(), rhs.integer().value())) {
+            return cmp;
+        }
+        return foldInt(op, lhs.integer().value(), rhs.integer().value(), type);
+    }
+
+    [[nodiscard]] static Fold_Result
+    foldUnary(TokenType op, const Node& operand, BuiltinType type) {
+        if (op == TokenType::op_not) {
+            const auto* b = std::get_if<boolNode>(&operand.data);
+            if (b == nullptr) { return std::nullopt; }
+            return boolLiteral(!b->val);
+        }
+
+        const auto* num = std::get_if<numlitNode>(&operand.data);
+        if (op != TokenType::minus || num == nullptr) { return std::nullopt; }
+        if (isFloat(type) || !num->value.isInteger()) {
+            return numLiteral(NumValue(-toDouble(num->value)));
+        }
+
+        const std::int64_t value = num->value.integer().value();
+        if (value == std::numeric_limits<std::int64_t>::min() || !fits(-value, type)) {
+            return std::unexpected(Error(
+                ErrType::Sema, std::format("Integer overflow in constant expression: -{}", value)));
+        }
+        return numLiteral(NumValue(-value));
+    }
+
+    [[nodiscard]] static Fold_Result
+    foldBinary(TokenType op, const Node& lhs, const Node& rhs, BuiltinType type) {
+        // only literals of the same kind combine
+        if (lhs.data.index() != rhs.data.index()) { return std::nullopt; }
+
+        if (const auto* l = std::get_if<numlitNode>(&lhs.data)) {
+            return foldNum(op, l->value, std::get<numlitNode>(rhs.data).value, type);
+        }
+
+        if (const auto* l = std::get_if<boolNode>(&lhs.data)) {
+            const bool r = std::get<boolNode>(rhs.data).val;
+            switch (op) {
+                case TokenType::op_and:      return boolLiteral(l->val && r);
+                case TokenType::op_or:       return boolLiteral(l->val || r);
+                case TokenType::op_equal_eq: return boolLiteral(l->val == r);
+                case TokenType::op_not_eq:   return boolLiteral(l->val != r);
+                default:                     return std::nullopt;
+            }
+        }
+
+        if (const auto* l = std::get_if<charLitNode>(&lhs.data)) {
+            return foldCompare(op, l->value, std::get<charLitNode>(rhs.data).value);
+        }
+
+        if (const auto* l = std::get_if<strLitNode>(&lhs.data)) {
+            const Symbol r = std::get<strLitNode>(rhs.data).value;
+            switch (op) {
+                case TokenType::dot_dot: {
+                    std::string joined = std::string(l->value.str());
+                    joined += r.str();
+                    return Node(NodeType::strLitNode, strLitNode(intern(joined)));
+                }
+                case TokenType::op_equal_eq: return boolLiteral(l->value == r);
+                case TokenType::op_not_eq:   return boolLiteral(l->value != r);
+                default:                     return std::nullopt;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    // Folds in `post`, so literals reach their parent expression before it is looked at.
+    // A folded expression keeps its id, so what analysis recorded for it still holds
+    struct Folder {
+        Ast& ast;
+        const Sema& sema;
+        const Lexer& lexer;  // to say where an error is
+        std::size_t folded = 0;
+        std::optional<Error> error = std::nullopt;
+
+        WalkAction post(WalkPos pos, const exprNode& expr) {
+            if (!expr.op.has_value()) { return WalkAction::Continue; }
+
+            const std::span<const NodeId> operands = ast.children(pos.id);
+            const BuiltinType type = sema.builtinOf(sema.typeOf(operands[0]));
+            Fold_Result result = std::nullopt;
+            if (operands.size() == 1) {
+                result = foldUnary(expr.op.value(), ast[operands[0]], type);
+            } else if (operands.size() == 2) {
+                result = foldBinary(expr.op.value(), ast[operands[0]], ast[operands[1]], type);
+            }
+
+            if (!result.has_value()) {
+                error = Error(
+                    result.error().type,
+                    std::format("{} at {}", result.error().msg, lexer.location(expr.offset)));
+                return WalkAction::Stop;
+            }
+            if (result.value().has_value()) {
+                ast[pos.id] = result.value().value();
+                folded++;
+            }
+            return WalkAction::Continue;
+        }
+    };
+
+    [[nodiscard]] std::expected<std::size_t, Error>
+    foldConstants(Ast& ast, const Sema& sema, const Lexer& lexer) {
+        Folder folder = {ast, sema, lexer};
+        if (!walk(ast, folder)) { return std::unexpected(folder.error.value()); }
+        return folder.folded;
+    }
+}  // namespace Winter
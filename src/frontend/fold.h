@@ -0,0 +1,24 @@
+#ifndef WINTER_FOLD_H
+#define WINTER_FOLD_H
+
+#include <cstddef>
+#include <expected>
+
+#include "../error.h"
+#include "ast.h"
+#include "lexer.h"
+#include "sema.h"
+
+namespace Winter {
+    // Replace every expression whose operands are all literals with the literal it
+    // evaluates to: arithmetic, comparisons, `!`, `&&`, `||` and `..` of two strings.
+    // Runs after `analyze`, and folds at the types it settled: integer overflow of the
+    // expression's type and division by zero are reported rather than folded, as Sema
+    // errors located in the source `lexer` lexed. Each
+    // expression is replaced in place, so the operands it no longer reaches stay in the
+    // arena and every id in the `Sema` stays valid. Returns the number of expressions folded
+    [[nodiscard]] std::expected<std::size_t, Error>
+    foldConstants(Ast&, const Sema&, const Lexer& lexer);
+}  // namespace Winter
+
+#endif  // WINTER_FOLD_H
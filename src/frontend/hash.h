@@ -0,0 +1,72 @@
+#ifndef WINTER_HASH_H
+#define WINTER_HASH_H
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+namespace Winter {
+    // 64-bit FNV-1a of source text, used to recognise text that is unchanged: a cached
+    // tree's source, or a top-level item between reparses
+    [[nodiscard]] constexpr std::uint64_t hashSource(std::string_view src) noexcept {
+        std::uint64_t hash = 0xcbf29ce484222325;
+        for (char c : src) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 0x100000001b3;
+        }
+        return hash;
+    }
+
+    // Finalizer of MurmurHash3: every input bit affects every output bit
+    [[nodiscard]] constexpr std::uint64_t mixBits(std::uint64_t x) noexcept {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccd;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53;
+        x ^= x >> 33;
+        return x;
+    }
+
+    // A second 64-bit hash of source text, unrelated to `hashSource`. Bytes are taken
+    // 8 at a time and each word is mixed in whole
+    [[nodiscard]] constexpr std::uint64_t hashSourceMixed(std::string_view src) noexcept {
+        std::uint64_t hash = 0x9e3779b97f4a7c15 ^ src.size();
+        std::uint64_t word = 0;
+        int shift = 0;
+        for (char c : src) {
+            word |= static_cast<std::uint64_t>(static_cast<unsigned char>(c)) << shift;
+            shift += 8;
+            if (shift == 64) {
+                hash = std::rotl(hash ^ mixBits(word), 27) * 0x9e3779b97f4a7c15;
+                word = 0;
+                shift = 0;
+            }
+        }
+        return mixBits(hash ^ mixBits(word));
+    }
+
+    // What identifies source text, for a cached tree or a reused item: its length and
+    // both hashes must match
+    struct SourceDigest {
+        std::uint64_t length = 0;
+        std::uint64_t hash = 0;   // `hashSource`, which also names the cache file
+        std::uint64_t check = 0;  // `hashSourceMixed`
+
+        [[nodiscard]] bool operator==(const SourceDigest&) const = default;
+    };
+
+    [[nodiscard]] constexpr SourceDigest digestSource(std::string_view src) noexcept {
+        return SourceDigest(src.size(), hashSource(src), hashSourceMixed(src));
+    }
+}  // namespace Winter
+
+template <>
+struct std::hash<Winter::SourceDigest> {
+    [[nodiscard]] std::size_t operator()(const Winter::SourceDigest& digest) const noexcept {
+        return static_cast<std::size_t>(digest.hash);
+    }
+};
+
+#endif  // WINTER_HASH_H
@@ -0,0 +1,73 @@
+#include "intern.h"
+
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <mutex>
+
+namespace Winter {
+    [[nodiscard]] std::string_view Symbol::str() const {
+        return Interner::global().lookup(*this);
+    }
+
+    // Copy `text` into the shared chunk, starting a new one if it doesn't fit. Text
+    // longer than a chunk gets a dedicated allocation and the shared chunk is left as
+    // it was, to be filled by what comes next. Caller must hold the unique lock
+    [[nodiscard]] std::string_view Interner::store(std::string_view text) {
+        if (text.size() > chunkSize) {
+            chunks.push_back(std::make_unique<char[]>(text.size()));
+            std::memcpy(chunks.back().get(), text.data(), text.size());
+            return std::string_view(chunks.back().get(), text.size());
+        }
+
+        if (chunkUsed + text.size() > chunkSize) {
+            chunks.push_back(std::make_unique<char[]>(chunkSize));
+            chunk = chunks.back().get();
+            chunkUsed = 0;
+        }
+
+        char* dest = chunk + chunkUsed;
+        std::memcpy(dest, text.data(), text.size());
+        chunkUsed += text.size();
+        return std::string_view(dest, text.size());
+    }
+
+    [[nodiscard]] Symbol Interner::intern(std::string_view text) {
+        {
+            std::shared_lock lock(mtx);
+            auto found = ids.find(text);
+            if (found != ids.end()) { return Symbol(found->second); }
+        }
+
+        std::unique_lock lock(mtx);
+        // another thread may have interned it between the two locks
+        auto found = ids.find(text);
+        if (found != ids.end()) { return Symbol(found->second); }
+
+        assert(names.size() < std::numeric_limits<std::uint32_t>::max());
+        const std::string_view stored = store(text);
+        const auto id = static_cast<std::uint32_t>(names.size());
+        names.push_back(stored);
+        ids.emplace(stored, id);
+        return Symbol(id);
+    }
+
+    [[nodiscard]] std::string_view Interner::lookup(Symbol sym) {
+        std::shared_lock lock(mtx);
+        return names.at(sym.id);
+    }
+
+    [[nodiscard]] std::size_t Interner::size() {
+        std::shared_lock lock(mtx);
+        return names.size();
+    }
+
+    [[nodiscard]] Interner& Interner::global() {
+        static Interner interner;
+        return interner;
+    }
+
+    [[nodiscard]] Symbol intern(std::string_view text) {
+        return Interner::global().intern(text);
+    }
+}  // namespace Winter
@@ -0,0 +1,70 @@
+#ifndef WINTER_INTERN_H
+#define WINTER_INTERN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Winter {
+    // Handle to an interned string. Two symbols compare equal exactly when their text
+    // does, so name comparisons are a single integer compare
+    struct Symbol {
+        std::uint32_t id = 0;  // 0 is always the empty string
+
+        [[nodiscard]] std::string_view str() const;
+        [[nodiscard]] bool empty() const noexcept { return id == 0; }
+        [[nodiscard]] bool operator==(const Symbol&) const = default;
+    };
+
+    // Process-wide string table backing `Symbol`. Interned text lives in fixed-size
+    // chunks that are never moved or freed, so views handed out stay valid for the
+    // lifetime of the process. Safe to use from multiple threads at once
+    struct Interner {
+        static constexpr std::size_t chunkSize = 64 * 1024;
+
+        std::shared_mutex mtx;
+        std::vector<std::unique_ptr<char[]>> chunks;
+        char* chunk = nullptr;  // shared chunk being filled, oversized text has its own
+        std::size_t chunkUsed = chunkSize;
+        std::vector<std::string_view> names = {""};
+        std::unordered_map<std::string_view, std::uint32_t> ids = {{"", 0}};
+
+        [[nodiscard]] std::string_view store(std::string_view);
+        [[nodiscard]] Symbol intern(std::string_view);
+        [[nodiscard]] std::string_view lookup(Symbol);
+        [[nodiscard]] std::size_t size();
+        [[nodiscard]] static Interner& global();
+    };
+
+    [[nodiscard]] Symbol intern(std::string_view);
+}  // namespace Winter
+
+template <>
+struct std::hash<Winter::Symbol> {
+    [[nodiscard]] std::size_t operator()(Winter::Symbol sym) const noexcept {
+        return std::hash<std::uint32_t> {}(sym.id);
+    }
+};
+
+template <>
+struct std::formatter<Winter::Symbol> {
+    constexpr auto parse(std::format_parse_context& ctx) {
+        auto it = ctx.begin();
+        if (it != ctx.end() && *it != '}') {
+            throw std::format_error("Invalid format specifier for Symbol");
+        }
+        return it;
+    }
+
+    auto format(Winter::Symbol sym, std::format_context& ctx) const {
+        return std::format_to(ctx.out(), "{}", sym.str());
+    }
+};
+
+#endif  // WINTER_INTERN_H
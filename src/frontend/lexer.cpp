@@ -1,57 +1,91 @@
 #include "lexer.h"
 
 #include <algorithm>
-#include <array>
 #include <cassert>
+#include <limits>
+#include <utility>
 
 #include "../error.h"
+#include "scan.h"
 
 namespace Winter {
     [[nodiscard]] bool between(int min, int max, int val) noexcept {
         return (min <= val && val <= max);
     }
 
+    [[nodiscard]] std::size_t Token::length(const Lexer* L) const noexcept {
+        if (len != longLen) { return len; }
+
+        auto found = L->longTokens.find(start);
+        return found == L->longTokens.end() ? len : found->second;
+    }
+
     [[nodiscard]] std::string Token::toString(const Lexer* L) const noexcept {
-        return std::string(L->src.substr(start, len));
+        return std::string(L->src.substr(start, length(L)));
+    }
+
+    [[nodiscard]] Symbol Token::toSymbol(const Lexer* L) const {
+        return intern(L->src.substr(start, length(L)));
     }
 
-    [[nodiscard]] int Token::toNum(const Lexer* L) const noexcept {
-        return std::stoi(std::string(L->src.substr(start, len)));
+    [[nodiscard]] std::expected<NumValue, Error> Token::toNum(const Lexer* L) const noexcept {
+        auto num = parseNumLiteral(L->src.substr(start, length(L)));
+        if (!num.has_value()) {
+            return std::unexpected(Error(
+                num.error().type, std::format("{} at {}", num.error().msg, L->location(start))));
+        }
+        return num;
     }
 
     [[nodiscard]] char Token::toChar(const Lexer* L) const noexcept {
         return L->src.at(start);
     }
 
+    [[nodiscard]] Token TokenBuffer::at(std::size_t i) const noexcept {
+        return Token(types[i], starts[i], lens[i]);
+    }
+
+    void TokenBuffer::reserve(std::size_t n) {
+        types.reserve(n);
+        starts.reserve(n);
+        lens.reserve(n);
+    }
+
+    void TokenBuffer::push(const Token& tok) {
+        types.push_back(tok.type);
+        starts.push_back(static_cast<std::uint32_t>(tok.start));
+        lens.push_back(tok.len);
+    }
+
+    // Copy of the tokens in [begin, end). Tokens only refer to the source by offset, so
+    // a slice is parsed against the same lexer as the whole buffer
+    [[nodiscard]] TokenBuffer TokenBuffer::slice(std::size_t begin, std::size_t end) const {
+        const auto first = static_cast<std::ptrdiff_t>(begin);
+        const auto last = static_cast<std::ptrdiff_t>(end);
+        TokenBuffer out = {};
+        out.types.assign(types.begin() + first, types.begin() + last);
+        out.starts.assign(starts.begin() + first, starts.begin() + last);
+        out.lens.assign(lens.begin() + first, lens.begin() + last);
+        return out;
+    }
+
+    // Build a token, recording its real length if it doesn't fit in the packed token
+    [[nodiscard]] Token Lexer::makeToken(TokenType type, std::size_t start, std::size_t len) {
+        if (len >= Token::longLen) { longTokens[static_cast<std::uint32_t>(start)] = len; }
+        return Token(type, start, len);
+    }
+
     void Lexer::skipWhitespace() noexcept {
-        static constexpr std::array<char, 3> whitespace = {' ', '\n', '\t'};
-        while (playhead < src.size()) {
-            const char c = src[playhead];
-            const bool is_ws =
-                std::any_of(whitespace.begin(), whitespace.end(), [c](char w) { return w == c; });
-            if (!is_ws) { break; }
-            playhead++;
-        }
+        playhead = scanner().whitespace(src, playhead);
     }
 
     void Lexer::skipComment() noexcept {
-        auto loc = src.find_first_of('\n', playhead);
-        if (loc == std::string_view::npos) {
-            playhead = src.size();
-            return;
-        }
-
-        playhead = loc;
-        return;
+        playhead = scanner().newline(src, playhead);
     }
 
     [[nodiscard]] bool Lexer::isNumeric() noexcept {
         if (playhead >= src.size()) { return false; }
-        static constexpr std::array<char, 11> digits = {'0', '1', '2', '3', '4', '5',
-                                                        '6', '7', '8', '9', '.'};
-
-        auto cmp = [&](const char c) { return c == src.at(playhead); };
-        return std::any_of(digits.begin(), digits.end(), cmp);
+        return between(48, 57, src.at(playhead));
     }
 
     [[nodiscard]] bool Lexer::isLetter() noexcept {
@@ -69,7 +103,7 @@ namespace Winter {
     [[nodiscard]] std::expected<Token, Error>
     Lexer::lexDouble(char c, TokenType single, TokenType pair) {
         playhead++;
-        if (src.at(playhead) == c) {
+        if (playhead < src.size() && src[playhead] == c) {
             playhead++;
             return Token(pair, playhead - 2, 2);
         }
@@ -80,7 +114,7 @@ namespace Winter {
         playhead += 2;
         if (playhead >= src.size() || src.at(playhead) != '\'') {
             return std::unexpected(
-                Error(ErrType::Lexer, std::format("Malformed char at pos {}", playhead)));
+                Error(ErrType::Lexer, std::format("Malformed char at {}", location(playhead))));
         }
 
         playhead++;
@@ -96,52 +130,68 @@ namespace Winter {
         std::size_t strlen = 1;
         playhead++;
         // TODO: handle escaped quotes
-        while (src.at(playhead) != '"') {
-            if (playhead >= src.size()) { break; }
-
+        while (playhead < src.size() && src[playhead] != '"') {
             strlen++;
             playhead++;
+        }
 
-            if (playhead > src.size()) {
-                return std::unexpected(Error(ErrType::Lexer, "Unclosed string"));
-            }
+        if (playhead >= src.size()) {
+            return std::unexpected(Error(
+                ErrType::Lexer,
+                std::format("Unclosed string starting at {}", location(playhead - strlen))));
         }
 
         // Include the closing quote
         strlen++;
         playhead++;
 
-        return Token(TokenType::str_literal, playhead - strlen, strlen);
+        return makeToken(TokenType::str_literal, playhead - strlen, strlen);
     }
 
     [[nodiscard]] std::expected<Token, Error> Lexer::lexNumeric() {
-        Token t = Token(TokenType::num_literal, playhead);
-        while (isNumeric()) {
-            t.len++;
-            playhead++;
-            if (playhead >= src.size()) { break; }
+        const std::size_t start = playhead;
+        if (!isNumeric()) {
+            return std::unexpected(Error(
+                ErrType::Lexer, std::format("Invalid numeric found at {}", location(playhead))));
         }
 
-        if (t.len == 0) {
-            return std::unexpected(
-                Error(ErrType::Lexer, std::format("Invalid numeric found at {}", playhead)));
+        // Only the shape of the literal is found here, `parseNumLiteral` validates it.
+        // Letters and `_` cover prefixes, hex digits, exponents and separators
+        const bool hex = src.size() - start > 1 && src[start] == '0' &&
+                         (src[start + 1] == 'x' || src[start + 1] == 'X');
+        auto digitAt = [&](std::size_t i) { return i < src.size() && between(48, 57, src[i]); };
+
+        while (playhead < src.size()) {
+            const char c = src[playhead];
+            if (isLetter()) {
+                playhead++;
+            } else if (c == '.' && !hex && digitAt(playhead + 1)) {
+                // a fraction, not the start of `..`
+                playhead++;
+            } else if ((c == '+' || c == '-') && !hex &&
+                       (src[playhead - 1] == 'e' || src[playhead - 1] == 'E') &&
+                       digitAt(playhead + 1)) {
+                playhead++;
+            } else {
+                break;
+            }
         }
 
-        return t;
+        return makeToken(TokenType::num_literal, start, playhead - start);
     }
 
     [[nodiscard]] std::expected<Token, Error> Lexer::lexIdentKeyword() {
         const std::size_t start = playhead;
         while (isLetter()) { playhead++; }
 
-        TokenType type = TokenType::ident;
-        if (keywords.contains(src.substr(start, playhead - start))) {
-            type = keywords.at(src.substr(start, playhead - start));
-        }
+        const std::string_view word = src.substr(start, playhead - start);
+        TokenType type = keywordType(word);
 
-        if (types.contains(src.substr(start, playhead - start))) { type = TokenType::type_literal; }
+        if (type == TokenType::ident && !types.empty() && types.contains(word)) {
+            type = TokenType::type_literal;
+        }
 
-        return Token(type, start, playhead - start);
+        return makeToken(type, start, playhead - start);
     }
 
     [[nodiscard]] std::expected<Token, Error> Lexer::operator()() {
@@ -184,6 +234,187 @@ namespace Winter {
         if (isLetter()) { return lexIdentKeyword(); }
 
         return std::unexpected(
-            Error(ErrType::Lexer, std::format("Invalid token found at {}", playhead)));
+            Error(ErrType::Lexer, std::format("Invalid token found at {}", location(playhead))));
+    }
+
+    [[nodiscard]] const std::vector<std::uint32_t>& Lexer::lines() const {
+        if (lineStarts.has_value()) { return lineStarts.value(); }
+
+        std::vector<std::uint32_t> starts = {0};
+        const Scanner& scan = scanner();
+        for (std::size_t pos = scan.newline(src, 0); pos < src.size();
+             pos = scan.newline(src, pos + 1)) {
+            starts.push_back(static_cast<std::uint32_t>(pos + 1));
+        }
+
+        lineStarts = std::move(starts);
+        return lineStarts.value();
+    }
+
+    // Binary search for the line containing `offset`. Offsets past the end of the source
+    // are reported on its last line
+    [[nodiscard]] SourceLocation Lexer::location(std::size_t offset) const {
+        const std::vector<std::uint32_t>& starts = lines();
+        const auto next = std::upper_bound(starts.begin(), starts.end(), offset);
+        const auto line = static_cast<std::size_t>(next - starts.begin());
+        return SourceLocation(
+            static_cast<std::uint32_t>(line),
+            static_cast<std::uint32_t>(offset - starts[line - 1] + 1));
+    }
+
+    // Lex the remainder of `src` into `buf`, stopping after the eof token. On error the
+    // tokens lexed so far are left in `buf`
+    [[nodiscard]] std::optional<Error> Lexer::lexAll(TokenBuffer& buf) {
+        if (src.size() > std::numeric_limits<std::uint32_t>::max()) {
+            return Error(ErrType::Lexer, "Source file too large to lex");
+        }
+
+        // Most real sources average well over 4 bytes per token
+        buf.reserve(buf.size() + (src.size() - playhead) / 4 + 1);
+        while (true) {
+            std::expected<Token, Error> ret = (*this)();
+            if (!ret.has_value()) { return ret.error(); }
+
+            buf.push(ret.value());
+            if (ret.value().type == TokenType::eof) { break; }
+        }
+
+        return {};
+    }
+
+    // Update `buf`, previously lexed from `src` by this lexer, for `newSrc` which is
+    // `src` with `edit` applied. Lexing restarts after the last token that can't have
+    // been touched by the edit and stops as soon as a token lines up with one from the
+    // old buffer past the edit, from where the old tokens only need their offsets
+    // shifted. `buf` must end in eof, and on error holds the tokens lexed so far
+    [[nodiscard]] std::optional<Error>
+    Lexer::relex(TokenBuffer& buf, std::string_view newSrc, const TextEdit& edit) {
+        const std::size_t oldSize = src.size();
+        const std::size_t oldEditEnd = edit.offset + edit.removed;
+        if (oldEditEnd > oldSize ||
+            newSrc.size() != oldSize - edit.removed + edit.inserted.size()) {
+            return Error(ErrType::Lexer, "Edit does not match the source");
+        }
+        if (buf.size() == 0 || buf.types.back() != TokenType::eof) {
+            return Error(ErrType::Lexer, "Can only relex a complete token buffer");
+        }
+        if (newSrc.size() > std::numeric_limits<std::uint32_t>::max()) {
+            return Error(ErrType::Lexer, "Source file too large to lex");
+        }
+
+        auto oldLength = [&](std::size_t i) -> std::size_t {
+            if (buf.lens[i] != Token::longLen) { return buf.lens[i]; }
+            return longTokens.at(buf.starts[i]);
+        };
+
+        // A token's end is decided by up to one byte of lookahead, so only tokens ending
+        // at least two bytes before the edit are certain to be unchanged
+        std::size_t keep = 0;
+        {
+            std::size_t lo = 0;
+            std::size_t hi = buf.size() - 1;  // eof is never kept
+            while (lo < hi) {
+                const std::size_t mid = lo + (hi - lo) / 2;
+                if (buf.starts[mid] + oldLength(mid) + 2 <= edit.offset) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            keep = lo;
+        }
+        const std::size_t restart = keep == 0 ? 0 : buf.starts[keep - 1] + oldLength(keep - 1);
+
+        // Long token lengths past the restart point are keyed by old offsets, set them
+        // aside so the new tokens can be recorded without clashing
+        std::unordered_map<std::uint32_t, std::size_t> oldLong = {};
+        for (auto it = longTokens.begin(); it != longTokens.end();) {
+            if (it->first >= restart) {
+                oldLong.insert(*it);
+                it = longTokens.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        src = newSrc;
+        playhead = restart;
+        lineStarts.reset();
+
+        const std::size_t newEditEnd = edit.offset + edit.inserted.size();
+        const std::int64_t delta =
+            static_cast<std::int64_t>(newEditEnd) - static_cast<std::int64_t>(oldEditEnd);
+        // eof is always last and always at offset 0, so it's left out of every search
+        const std::size_t eof = buf.size() - 1;
+        const auto oldStarts = buf.starts.begin();
+        auto old = static_cast<std::size_t>(
+            std::lower_bound(oldStarts, oldStarts + static_cast<std::ptrdiff_t>(eof), oldEditEnd) -
+            oldStarts);
+
+        TokenBuffer fresh = {};
+        while (true) {
+            std::expected<Token, Error> ret = (*this)();
+            if (!ret.has_value()) {
+                buf.types.resize(keep);
+                buf.starts.resize(keep);
+                buf.lens.resize(keep);
+                for (std::size_t i = 0; i < fresh.size(); i++) { buf.push(fresh.at(i)); }
+                return ret.error();
+            }
+            const Token tok = ret.value();
+            if (tok.type == TokenType::eof) {
+                old = eof;
+                break;
+            }
+
+            // Past the edit, the stream is back in sync once a token starts where an old
+            // one did (after shifting) and covers the same bytes
+            if (tok.start >= newEditEnd) {
+                const auto target = static_cast<std::int64_t>(tok.start) - delta;
+                while (old < eof && static_cast<std::int64_t>(buf.starts[old]) < target) {
+                    old++;
+                }
+
+                if (old < eof && static_cast<std::int64_t>(buf.starts[old]) == target &&
+                    buf.types[old] == tok.type && buf.lens[old] == tok.len &&
+                    (tok.len != Token::longLen ||
+                     oldLong.at(buf.starts[old]) == longTokens.at(tok.start))) {
+                    break;
+                }
+            }
+
+            fresh.push(tok);
+        }
+
+        // Splice the relexed tokens in between the kept head and the shifted old tail
+        const std::size_t tail = old;
+        if (tail < eof) {
+            for (const auto& [start, len] : oldLong) {
+                if (start >= buf.starts[tail]) {
+                    longTokens[static_cast<std::uint32_t>(start + delta)] = len;
+                }
+            }
+        }
+        for (std::size_t i = tail; i < eof; i++) {
+            buf.starts[i] = static_cast<std::uint32_t>(buf.starts[i] + delta);
+        }
+
+        auto splice = [&](auto& dest, const auto& mid) {
+            const auto first = dest.begin() + static_cast<std::ptrdiff_t>(keep);
+            const auto last = dest.begin() + static_cast<std::ptrdiff_t>(tail);
+            const auto common = static_cast<std::ptrdiff_t>(std::min(mid.size(), tail - keep));
+            std::copy(mid.begin(), mid.begin() + common, first);
+            if (mid.size() > tail - keep) {
+                dest.insert(first + common, mid.begin() + common, mid.end());
+            } else {
+                dest.erase(first + common, last);
+            }
+        };
+        splice(buf.types, fresh.types);
+        splice(buf.starts, fresh.starts);
+        splice(buf.lens, fresh.lens);
+
+        playhead = src.size();
+        return {};
     }
 }  // namespace Winter
@@ -1,14 +1,20 @@
 #ifndef WINTER_LEXER_H
 #define WINTER_LEXER_H
 
+#include <algorithm>
+#include <array>
 #include <cstddef>
 #include <cstdint>
 #include <expected>
 #include <format>
+#include <optional>
 #include <string_view>
 #include <unordered_map>
+#include <vector>
 
 #include "../error.h"
+#include "intern.h"
+#include "numeric.h"
 
 namespace Winter {
     enum class TokenType : std::uint8_t {
@@ -78,61 +84,146 @@ namespace Winter {
         eof,
         error
     };
+    // `error` is always the last token type
+    inline constexpr std::size_t tokenTypeCount = static_cast<std::size_t>(TokenType::error) + 1;
 
     struct Lexer;
+    // A token's index is its position in the TokenBuffer it was lexed into, so tokens
+    // carry no shared state and any number of lexers can run concurrently.
+    //
+    // Tokens are packed into 8 bytes. Lengths that don't fit in 16 bits (only very long
+    // string literals in practice) are stored as `longLen` and the real length is kept
+    // by the Lexer, so use `length()` rather than reading `len` directly
     struct Token {
-        static inline std::size_t counter = 0;
+        static constexpr std::uint16_t longLen = 0xFFFF;
 
+        std::uint32_t start;
+        std::uint16_t len;
         TokenType type;
-        std::size_t start;
-        std::size_t len;
-        std::size_t idx;
-
-        explicit Token(TokenType t, std::size_t s) : Token(t, s, 0) {}
-        explicit Token(TokenType t, std::size_t s, std::size_t l)
-            : type(t), start(s), len(l), idx(counter) {
-            counter++;
-        }
+
+        explicit constexpr Token(TokenType t, std::size_t s) : Token(t, s, 0) {}
+        explicit constexpr Token(TokenType t, std::size_t s, std::size_t l)
+            : start(static_cast<std::uint32_t>(s)),
+              len(l >= longLen ? longLen : static_cast<std::uint16_t>(l)),
+              type(t) {}
         [[nodiscard]] constexpr static Token tombstone() { return Token(TokenType::error, 0); }
 
+        [[nodiscard]] std::size_t length(const Lexer* L) const noexcept;
         [[nodiscard]] std::string toString(const Lexer* L) const noexcept;
-        [[nodiscard]] int toNum(const Lexer* L) const noexcept;
+        [[nodiscard]] Symbol toSymbol(const Lexer* L) const;
+        [[nodiscard]] std::expected<NumValue, Error> toNum(const Lexer* L) const noexcept;
         [[nodiscard]] char toChar(const Lexer* L) const noexcept;
     };
 
+    static_assert(sizeof(Token) == 8);
+
+    // Struct-of-arrays storage for a fully lexed source file. Each field is its own
+    // contiguous array so walking the types (the common case in the parser) stays
+    // within as few cache lines as possible
+    struct TokenBuffer {
+        std::vector<TokenType> types;
+        std::vector<std::uint32_t> starts;
+        std::vector<std::uint16_t> lens;  // `Token::longLen` escapes as in Token
+
+        [[nodiscard]] std::size_t size() const noexcept { return types.size(); }
+        [[nodiscard]] Token at(std::size_t) const noexcept;
+        void reserve(std::size_t);
+        void push(const Token&);
+        [[nodiscard]] TokenBuffer slice(std::size_t, std::size_t) const;
+    };
+
     using namespace std::literals::string_view_literals;
+    struct Keyword {
+        std::string_view text;
+        TokenType type;
+    };
+
+    inline constexpr std::array keywordList = {
+        Keyword {"alias"sv, TokenType::kw_alias},
+        Keyword {"break"sv, TokenType::kw_break},
+        Keyword {"continue"sv, TokenType::kw_continue},
+        Keyword {"const"sv, TokenType::kw_const},
+        Keyword {"case"sv, TokenType::kw_case},
+        Keyword {"class"sv, TokenType::kw_class},
+        Keyword {"default"sv, TokenType::kw_default},
+        Keyword {"enum"sv, TokenType::kw_enum},
+        Keyword {"else"sv, TokenType::kw_else},
+        Keyword {"fallthrough"sv, TokenType::kw_fallthrough},
+        Keyword {"false"sv, TokenType::kw_false},
+        Keyword {"for"sv, TokenType::kw_for},
+        Keyword {"func"sv, TokenType::kw_func},
+        Keyword {"if"sv, TokenType::kw_if},
+        Keyword {"implements"sv, TokenType::kw_implements},
+        Keyword {"interface"sv, TokenType::kw_interface},
+        Keyword {"let"sv, TokenType::kw_let},
+        Keyword {"mod"sv, TokenType::kw_mod},
+        Keyword {"return"sv, TokenType::kw_return},
+        Keyword {"static"sv, TokenType::kw_static},
+        Keyword {"switch"sv, TokenType::kw_switch},
+        Keyword {"true"sv, TokenType::kw_true},
+        Keyword {"type"sv, TokenType::kw_type},
+    };
+
+    // Perfect hash over `keywordList`: the first two characters and the length are enough
+    // to give every keyword its own slot. Collisions are rejected at compile time below
+    [[nodiscard]] constexpr std::size_t keywordHash(std::string_view s) noexcept {
+        const auto c0 = static_cast<std::size_t>(static_cast<unsigned char>(s[0]));
+        const auto c1 = static_cast<std::size_t>(static_cast<unsigned char>(s[1]));
+        return (c0 + c1 * 11 + s.size() * 3) & 63;
+    }
+
+    inline constexpr std::array<Keyword, 64> keywordTable = [] {
+        std::array<Keyword, 64> table = {};
+        for (const Keyword& kw : keywordList) { table[keywordHash(kw.text)] = kw; }
+        return table;
+    }();
+
+    static_assert(
+        static_cast<std::size_t>(std::ranges::count_if(
+            keywordTable, [](const Keyword& kw) { return !kw.text.empty(); })) ==
+            keywordList.size(),
+        "keywordHash has collisions: adjust its multipliers");
+
+    inline constexpr std::size_t keywordMaxLen =
+        std::ranges::max(keywordList, {}, [](const Keyword& kw) { return kw.text.size(); })
+            .text.size();
+
+    // Classify an identifier as a keyword without any hashing of the whole string or
+    // allocation. Returns `TokenType::ident` for anything that isn't a keyword
+    [[nodiscard]] constexpr TokenType keywordType(std::string_view s) noexcept {
+        if (s.size() < 2 || s.size() > keywordMaxLen) { return TokenType::ident; }
+        const Keyword& kw = keywordTable[keywordHash(s)];
+        return kw.text == s ? kw.type : TokenType::ident;
+    }
+
+    // A single edit to a source file: `removed` bytes at `offset` were replaced by
+    // `inserted`
+    struct TextEdit {
+        std::size_t offset;
+        std::size_t removed;
+        std::string_view inserted;
+    };
+
+    // 1-based line and column of a byte offset, for diagnostics
+    struct SourceLocation {
+        std::uint32_t line;
+        std::uint32_t column;
+    };
+
     struct Lexer {
         std::size_t playhead;
         std::string_view src;
-        const std::unordered_map<std::string_view, TokenType> keywords = {
-            {"alias"sv, TokenType::kw_alias},
-            {"break"sv, TokenType::kw_break},
-            {"continue"sv, TokenType::kw_continue},
-            {"const"sv, TokenType::kw_const},
-            {"case"sv, TokenType::kw_case},
-            {"class"sv, TokenType::kw_class},
-            {"default"sv, TokenType::kw_default},
-            {"enum"sv, TokenType::kw_enum},
-            {"else"sv, TokenType::kw_else},
-            {"fallthrough"sv, TokenType::kw_fallthrough},
-            {"false"sv, TokenType::kw_false},
-            {"for"sv, TokenType::kw_for},
-            {"func"sv, TokenType::kw_func},
-            {"if"sv, TokenType::kw_if},
-            {"implements"sv, TokenType::kw_implements},
-            {"interface"sv, TokenType::kw_interface},
-            {"let"sv, TokenType::kw_let},
-            {"mod"sv, TokenType::kw_mod},
-            {"return"sv, TokenType::kw_return},
-            {"static"sv, TokenType::kw_static},
-            {"switch"sv, TokenType::kw_switch},
-            {"true"sv, TokenType::kw_true},
-            {"type"sv, TokenType::kw_type},
-        };
 
         std::unordered_map<std::string_view, TokenType> types = {};
-
+        // start offset -> length, for tokens too long for `Token::len`
+        std::unordered_map<std::uint32_t, std::size_t> longTokens = {};
+        // Offset of the first byte of every line in `src`. Only built the first time a
+        // location is asked for, so lexing itself never pays for it
+        mutable std::optional<std::vector<std::uint32_t>> lineStarts = std::nullopt;
         explicit Lexer(std::string_view src) : playhead(0), src(src) {}
+        [[nodiscard]] const std::vector<std::uint32_t>& lines() const;
+        [[nodiscard]] SourceLocation location(std::size_t offset) const;
+        [[nodiscard]] Token makeToken(TokenType, std::size_t, std::size_t);
         void skipWhitespace() noexcept;
         void skipComment() noexcept;
         [[nodiscard]] bool isNumeric() noexcept;
@@ -144,6 +235,8 @@ namespace Winter {
         [[nodiscard]] std::expected<Token, Error> lexNumeric();
         [[nodiscard]] std::expected<Token, Error> lexIdentKeyword();
         [[nodiscard]] std::expected<Token, Error> operator()();
+        [[nodiscard]] std::optional<Error> lexAll(TokenBuffer&);
+        [[nodiscard]] std::optional<Error> relex(TokenBuffer&, std::string_view, const TextEdit&);
     };
 
     [[nodiscard]] bool between(int min, int max, int val) noexcept;
@@ -239,8 +332,22 @@ struct std::formatter<Winter::Token> {
 
     auto format(Winter::Token tok, std::format_context& ctx) const {
         return std::format_to(
-            ctx.out(), "IDX: {}, Type: {}, start: {}, len: {}", tok.idx, tok.type, tok.start,
-            tok.len);
+            ctx.out(), "Type: {}, start: {}, len: {}", tok.type, tok.start, tok.len);
+    }
+};
+
+template <>
+struct std::formatter<Winter::SourceLocation> {
+    constexpr auto parse(std::format_parse_context& ctx) {
+        auto it = ctx.begin();
+        if (it != ctx.end() && *it != '}') {
+            throw std::format_error("Invalid format specifier for SourceLocation");
+        }
+        return it;
+    }
+
+    auto format(Winter::SourceLocation loc, std::format_context& ctx) const {
+        return std::format_to(ctx.out(), "{}:{}", loc.line, loc.column);
     }
 };
 
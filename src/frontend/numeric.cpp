@@ -0,0 +1,98 @@
+#include "numeric.h"
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <limits>
+#include <system_error>
+
+namespace Winter {
+    [[nodiscard]] std::optional<std::int64_t> NumValue::integer() const noexcept {
+        if (const auto* i = std::get_if<std::int64_t>(&value)) { return *i; }
+        return std::nullopt;
+    }
+
+    [[nodiscard]] std::optional<double> NumValue::floating() const noexcept {
+        if (const auto* f = std::get_if<double>(&value)) { return *f; }
+        return std::nullopt;
+    }
+
+    [[nodiscard]] static constexpr bool isDigit(char c, int base) noexcept {
+        if (base == 16) {
+            return ('0' <= c && c <= '9') || ('a' <= c && c <= 'f') || ('A' <= c && c <= 'F');
+        }
+        return '0' <= c && c <= '9';
+    }
+
+    [[nodiscard]] static std::unexpected<Error>
+    numError(std::string_view msg, std::string_view text) {
+        return std::unexpected(Error(ErrType::Lexer, std::format("{}: '{}'", msg, text)));
+    }
+
+    [[nodiscard]] std::expected<NumValue, Error> parseNumLiteral(std::string_view text) noexcept {
+        int base = 10;
+        if (text.size() > 2 && text[0] == '0') {
+            switch (text[1]) {
+                case 'x':
+                case 'X': base = 16; break;
+                case 'b':
+                case 'B': base = 2; break;
+                case 'o':
+                case 'O': base = 8; break;
+                default:  break;
+            }
+        }
+        const std::size_t prefix = base == 10 ? 0 : 2;
+
+        // Longest useful literal is a 64 digit binary number. Anything longer only fits
+        // with separators, which are stripped into this buffer
+        std::array<char, 128> buf;
+        std::string_view digits = text.substr(prefix);
+
+        if (digits.find('_') != std::string_view::npos) {
+            std::size_t n = 0;
+            for (std::size_t i = 0; i < digits.size(); i++) {
+                if (digits[i] != '_') {
+                    if (n == buf.size()) { return numError("Numeric literal too long", text); }
+                    buf[n++] = digits[i];
+                    continue;
+                }
+
+                const bool between = i > 0 && i + 1 < digits.size() &&
+                                     isDigit(digits[i - 1], base) && isDigit(digits[i + 1], base);
+                if (!between) { return numError("Misplaced digit separator", text); }
+            }
+            digits = std::string_view(buf.data(), n);
+        }
+
+        const char* first = digits.data();
+        const char* last = digits.data() + digits.size();
+        const bool isFloat = base == 10 && digits.find_first_of(".eE") != std::string_view::npos;
+
+        if (isFloat) {
+            double value = 0;
+            const auto [ptr, ec] = std::from_chars(first, last, value, std::chars_format::general);
+            if (ec == std::errc::result_out_of_range) {
+                return numError("Float literal out of range", text);
+            }
+            if (ec != std::errc() || ptr != last) {
+                return numError("Malformed float literal", text);
+            }
+            return NumValue(value);
+        }
+
+        // Parsed unsigned so a sign is never accepted, then range checked against int64
+        std::uint64_t value = 0;
+        const auto [ptr, ec] = std::from_chars(first, last, value, base);
+        if (ec == std::errc::result_out_of_range ||
+            (ec == std::errc() &&
+             value > static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max()))) {
+            return numError("Integer literal out of range", text);
+        }
+        if (ec != std::errc() || ptr != last) {
+            return numError("Malformed integer literal", text);
+        }
+
+        return NumValue(static_cast<std::int64_t>(value));
+    }
+}  // namespace Winter
@@ -0,0 +1,49 @@
+#ifndef WINTER_NUMERIC_H
+#define WINTER_NUMERIC_H
+
+#include <cstdint>
+#include <expected>
+#include <format>
+#include <optional>
+#include <string_view>
+#include <variant>
+
+#include "../error.h"
+
+namespace Winter {
+    // Decoded value of a numeric literal
+    struct NumValue {
+        std::variant<std::int64_t, double> value;
+
+        [[nodiscard]] bool isInteger() const noexcept {
+            return std::holds_alternative<std::int64_t>(value);
+        }
+        [[nodiscard]] std::optional<std::int64_t> integer() const noexcept;
+        [[nodiscard]] std::optional<double> floating() const noexcept;
+        [[nodiscard]] bool operator==(const NumValue&) const = default;
+    };
+
+    // Decode the text of a numeric literal without allocating. Supports:
+    //   decimal, `0x` hex, `0b` binary and `0o` octal 64-bit signed integers
+    //   decimal floats with an optional exponent: `1.5`, `2e10`, `3.0e-2`
+    //   `_` digit separators between any two digits: `1_000_000`, `0xFF_FF`
+    [[nodiscard]] std::expected<NumValue, Error> parseNumLiteral(std::string_view) noexcept;
+}  // namespace Winter
+
+template <>
+struct std::formatter<Winter::NumValue> {
+    constexpr auto parse(std::format_parse_context& ctx) {
+        auto it = ctx.begin();
+        if (it != ctx.end() && *it != '}') {
+            throw std::format_error("Invalid format specifier for NumValue");
+        }
+        return it;
+    }
+
+    auto format(const Winter::NumValue& num, std::format_context& ctx) const {
+        if (num.isInteger()) { return std::format_to(ctx.out(), "{}", num.integer().value()); }
+        return std::format_to(ctx.out(), "{}", num.floating().value());
+    }
+};
+
+#endif  // WINTER_NUMERIC_H
@@ -1,22 +1,45 @@
 #include "parser.h"
 
 #include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <format>
+#include <limits>
 #include <print>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "hash.h"
+#include "walk.h"
 
 namespace Winter {
+    // Lex the whole source up front. If the lexer fails, the buffer is terminated with a
+    // tombstone so the parser stops at the same place it would have when lexing lazily
+    void Parser::tokenize() {
+        lexError = L.lexAll(tokens);
+        if (lexError.has_value()) { tokens.push(Token::tombstone()); }
+    }
+
     [[nodiscard]] bool Parser::check(const TokenType& type) const noexcept {
         return current.type == type;
     }
 
+    // Look `n` tokens ahead of the next token to be consumed. Reading past the end
+    // returns the final token in the buffer (eof or a tombstone)
+    [[nodiscard]] Token Parser::peek(std::size_t n) const noexcept {
+        if (tokens.size() == 0) { return Token::tombstone(); }
+        return tokens.at(std::min(cursor + n, tokens.size() - 1));
+    }
+
     void Parser::consume() noexcept {
         prev = current;
-        auto ret = L();
-        if (!ret.has_value()) {
-            current = Token::tombstone();
-        } else {
-            current = ret.value();
-        }
+        current = peek(0);
+        if (cursor < tokens.size()) { cursor++; }
     }
 
     [[nodiscard]] bool Parser::consume(std::initializer_list<TokenType> tokens) noexcept {
@@ -29,13 +52,110 @@ namespace Winter {
         return false;
     }
 
+    // Move the children pushed since `mark` into the tree's edge pool
+    [[nodiscard]] NodeRange Parser::popChildren(std::size_t mark) {
+        const NodeRange range = ast.addRange(std::span(scratch).subspan(mark));
+        scratch.resize(mark);
+        return range;
+    }
+
+    // As above, but with the children of type `first` placed ahead of the rest. Source
+    // order is kept within each group
+    [[nodiscard]] NodeRange Parser::popChildren(std::size_t mark, NodeType first) {
+        const std::span<const NodeId> pending = std::span(scratch).subspan(mark);
+        assert(ast.edges.size() + pending.size() <= std::numeric_limits<std::uint32_t>::max());
+        const auto start = static_cast<std::uint32_t>(ast.edges.size());
+
+        for (NodeId id : pending) {
+            if (ast[id].type == first) { ast.edges.push_back(id); }
+        }
+        for (NodeId id : pending) {
+            if (ast[id].type != first) { ast.edges.push_back(id); }
+        }
+
+        const auto count = static_cast<std::uint32_t>(pending.size());
+        scratch.resize(mark);
+        return NodeRange(start, count);
+    }
+
+    // Keep an error to report once the parse is done. eof has no offset of its own
+    void Parser::report(const Error& err) {
+        const std::size_t offset = check(TokenType::eof) ? L.src.size() : current.start;
+        errors.push_back(ParseError(err, offset));
+    }
+
+    // Skip the rest of a statement that failed to parse, from wherever in it the error was
+    // found. Stops after the `;` or block that ends it, or at the `}` closing the body, or
+    // at a keyword that starts the next statement when the `;` is missing. A `;` inside
+    // parens is part of a for loop's header, or the parens are never closed; either way
+    // the statement ends at the next block
+    void Parser::syncStatement(std::size_t start) noexcept {
+        std::size_t braces = 0;
+        std::size_t parens = 0;
+        auto track = [&braces, &parens](TokenType type) {
+            switch (type) {
+                case TokenType::lbrace:
+                    braces++;
+                    parens = 0;
+                    break;
+                case TokenType::rbrace:
+                    if (braces > 0) { braces--; }
+                    parens = 0;
+                    break;
+                case TokenType::lparen: parens++; break;
+                case TokenType::rparen:
+                    if (parens > 0) { parens--; }
+                    break;
+                default: break;
+            }
+        };
+
+        // the nesting the error was found at
+        for (std::size_t i = start; i + 1 < cursor; i++) { track(tokens.types[i]); }
+
+        while (!check(TokenType::eof) && !check(TokenType::error)) {
+            if (braces == 0) {
+                switch (current.type) {
+                    case TokenType::rbrace: return;  // closes the body
+
+                    case TokenType::semicolon:
+                        if (parens == 0) {
+                            consume();
+                            return;
+                        }
+                        break;
+
+                    case TokenType::kw_return:
+                    case TokenType::kw_if:
+                    case TokenType::kw_let:
+                    case TokenType::kw_for:
+                    case TokenType::kw_const:
+                    case TokenType::kw_switch:
+                    case TokenType::kw_type:
+                        if (parens == 0 && cursor - 1 > start) { return; }
+                        break;
+
+                    default: break;
+                }
+            }
+
+            track(current.type);
+            // a block ends the statement, unless an `else` follows it
+            if (braces == 0 && check(TokenType::rbrace) && peek(0).type != TokenType::kw_else) {
+                consume();
+                return;
+            }
+            consume();
+        }
+    }
+
     [[nodiscard]] Node_Result Parser::parseAlias() noexcept {
         if (!check(TokenType::kw_alias)) {
             return std::unexpected(Error(ErrType::Parser, "Unexpected token: expected kw_alias"));
         }
         consume();
 
-        const std::string ident = current.toString(&L);
+        const Symbol ident = current.toSymbol(&L);
 
         if (!consume({TokenType::op_equal})) {
             return std::unexpected(Error(ErrType::Parser, "Unexpected token: alias not set"));
@@ -50,37 +170,42 @@ namespace Winter {
             }
             consume();  // consume lparen
 
-            std::vector<Node> params = {};
+            const std::size_t mark = scratch.size();
             while (!check(TokenType::rparen)) {
-                params.push_back(Node(NodeType::identNode, identNode(current.toString(&L))));
+                if (check(TokenType::eof) || check(TokenType::error)) {
+                    return std::unexpected(
+                        Error(ErrType::Parser, "Unexpected end of file: expected rparen"));
+                }
+                scratch.push_back(ast.add(NodeType::identNode, identNode(current.toSymbol(&L))));
                 consume();
                 if (check(TokenType::comma)) { consume(); }
             }
 
             consume();  // consume rparen
-            const int paramcount = static_cast<int>(params.size());
+            const int paramcount = static_cast<int>(scratch.size() - mark);
             if (!check(TokenType::semicolon)) {
-                params.push_back(Node(NodeType::identNode, identNode(current.toString(&L))));
+                scratch.push_back(ast.add(NodeType::identNode, identNode(current.toSymbol(&L))));
                 consume();
             }
 
             consume();  // consume semicolon
-            Node f = Node(NodeType::funcAlias, funcAlias(paramcount), params);
-            return Node(NodeType::aliasNode, aliasNode(ident, aliasNode::childType::func), {f});
+            const NodeId f =
+                ast.add(Node(NodeType::funcAlias, funcAlias(paramcount), popChildren(mark)));
+            return ast.add(NodeType::aliasNode, aliasNode(ident, aliasNode::childType::func), {f});
 
         } else {
             // type alias
-            Node t = Node(NodeType::typeAlias, typeAlias(current.toString(&L)));
+            const NodeId t = ast.add(NodeType::typeAlias, typeAlias(current.toSymbol(&L)));
             consume();  // consume ident
             consume();  // consume semicolon;
-            return Node(NodeType::aliasNode, aliasNode(ident, aliasNode::childType::type), {t});
+            return ast.add(NodeType::aliasNode, aliasNode(ident, aliasNode::childType::type), {t});
         }
 
         return std::unexpected(Error(ErrType::Parser, "Unexpected error in parsing alias"));
     }
 
     [[nodiscard]] Node_Result Parser::parseArg() noexcept {
-        std::vector<TokenType> valid_types = {
+        static constexpr std::array<TokenType, 4> valid_types = {
             TokenType::num_literal,
             TokenType::char_literal,
             TokenType::str_literal,
@@ -94,16 +219,19 @@ namespace Winter {
         }
 
         if (check(TokenType::str_literal) || check(TokenType::ident)) {
-            return Node(
-                NodeType::argNode, argNode(current.toString(&L), std::nullopt, std::nullopt));
+            return ast.add(
+                NodeType::argNode, argNode(current.toSymbol(&L), std::nullopt, std::nullopt));
         }
 
         if (check(TokenType::num_literal)) {
-            return Node(NodeType::argNode, argNode(std::nullopt, current.toNum(&L), std::nullopt));
+            auto num = current.toNum(&L);
+            if (!num.has_value()) { return std::unexpected(num.error()); }
+            return ast.add(NodeType::argNode, argNode(std::nullopt, num.value(), std::nullopt));
         }
 
         if (check(TokenType::char_literal)) {
-            return Node(NodeType::argNode, argNode(std::nullopt, std::nullopt, current.toChar(&L)));
+            return ast.add(
+                NodeType::argNode, argNode(std::nullopt, std::nullopt, current.toChar(&L)));
         }
 
         return std::unexpected(Error(ErrType::Parser, "Unknown arg type"));
@@ -116,10 +244,17 @@ namespace Winter {
 
         consume();
 
-        std::vector<Node> children = {};
+        const std::size_t mark = scratch.size();
         while (!check(TokenType::rbrace)) {
-            Node_Result maybe_return =
-                std::unexpected(Error(ErrType::Parser, "Token not known in body"));
+            if (check(TokenType::eof) || check(TokenType::error)) {
+                return std::unexpected(
+                    Error(ErrType::Parser, "Unexpected end of file: expected rbrace"));
+            }
+            const std::size_t start = cursor - 1;
+            const std::size_t statementMark = scratch.size();
+
+            // Errors are only built on failure, as their message is heap allocated
+            Node_Result maybe_return = NodeId {};
 
             if (check(TokenType::kw_return)) {
                 maybe_return = parseReturn();
@@ -131,13 +266,11 @@ namespace Winter {
                 maybe_return = parseIf();
 
             } else if (check(TokenType::kw_let)) {
-                Node_Result maybe_return = parseLet(false);
-                if (!maybe_return.has_value()) { return std::unexpected(maybe_return.error()); }
-                children.push_back(maybe_return.value());
-                if (maybe_return.value().type == NodeType::varNode) {
+                maybe_return = parseLet(false);
+                if (maybe_return.has_value() &&
+                    ast[maybe_return.value()].type == NodeType::varNode) {
                     consume();  // consume ';'
                 }
-                continue;
 
             } else if (check(TokenType::kw_for)) {
                 maybe_return = parseFor();
@@ -151,14 +284,27 @@ namespace Winter {
             } else if (check(TokenType::kw_type)) {
                 maybe_return = parseType();
                 consume();  // consume final rbrace
+
+            } else {
+                maybe_return = std::unexpected(Error(ErrType::Parser, "Token not known in body"));
             }
 
-            if (!maybe_return.has_value()) { return std::unexpected(maybe_return.error()); }
-            children.push_back(maybe_return.value());
+            if (!maybe_return.has_value()) {
+                // nothing is left to carry on with, so the caller reports it
+                if (check(TokenType::eof)) { return std::unexpected(maybe_return.error()); }
+
+                // Leave the statement out of the body and carry on with the next one
+                report(maybe_return.error());
+                scratch.resize(statementMark);
+                syncStatement(start);
+                continue;
+            }
+            scratch.push_back(maybe_return.value());
         }
 
         consume();  // consume '}'
-        return Node(NodeType::bodyNode, bodyNode(static_cast<int>(children.size())), children);
+        const auto count = static_cast<int>(scratch.size() - mark);
+        return ast.add(Node(NodeType::bodyNode, bodyNode(count), popChildren(mark)));
     }
 
     [[nodiscard]] Node_Result Parser::parseCallOrVariable() noexcept {
@@ -178,9 +324,9 @@ namespace Winter {
         const bool default_case = (current.type == TokenType::kw_default);
         consume();  // consume kw_case
 
-        std::string ident = "";
+        Symbol ident = {};
         if (!default_case) {
-            ident = current.toString(&L);
+            ident = current.toSymbol(&L);
             consume();
         }
 
@@ -190,11 +336,11 @@ namespace Winter {
 
             Node_Result case_node = parseCase();
             if (!case_node.has_value()) { return std::unexpected(case_node.error()); }
-            return Node(NodeType::caseNode, caseNode(true, ident, false), {case_node.value()});
+            return ast.add(NodeType::caseNode, caseNode(true, ident, false), {case_node.value()});
         } else if (check(TokenType::lbrace)) {
             Node_Result body_node = parseBody();
             if (!body_node.has_value()) { return std::unexpected(body_node.error()); }
-            return Node(
+            return ast.add(
                 NodeType::caseNode, caseNode(false, ident, default_case), {body_node.value()});
         }
 
@@ -208,7 +354,7 @@ namespace Winter {
         }
 
         current.start++;  // jump past opening quote
-        return Node(NodeType::charLitNode, charLitNode(current.toChar(&L)));
+        return ast.add(NodeType::charLitNode, charLitNode(current.toChar(&L)));
     }
 
     [[nodiscard]] Node_Result Parser::parseClass() noexcept {
@@ -217,10 +363,10 @@ namespace Winter {
         }
         consume();
 
-        std::optional<std::string> interface_name;
+        std::optional<Symbol> interface_name;
         if (check(TokenType::kw_implements)) {
             consume();
-            interface_name = current.toString(&L);
+            interface_name = current.toSymbol(&L);
             consume();
         }
 
@@ -231,8 +377,7 @@ namespace Winter {
 
         int attrCount = 0;
         int methodCount = 0;
-        std::vector<Node> attrs = {};
-        std::vector<Node> methods = {};
+        const std::size_t mark = scratch.size();
 
         while (!check(TokenType::rbrace)) {
             bool isConst = check(TokenType::kw_const);
@@ -241,12 +386,13 @@ namespace Winter {
             Node_Result innerLet = parseLet(isConst);
             if (!innerLet.has_value()) { return std::unexpected(innerLet.error()); }
 
-            if (innerLet.value().type == NodeType::varNode) {
-                attrs.push_back(innerLet.value());
+            const NodeType innerType = ast[innerLet.value()].type;
+            if (innerType == NodeType::varNode) {
+                scratch.push_back(innerLet.value());
                 consume();
                 attrCount++;
-            } else if (innerLet.value().type == NodeType::letNode) {
-                methods.push_back(innerLet.value());
+            } else if (innerType == NodeType::letNode) {
+                scratch.push_back(innerLet.value());
                 methodCount++;
             } else {
                 return std::unexpected(
@@ -254,10 +400,10 @@ namespace Winter {
             }
         }
 
-        // Merge attrs and methods lists
         // we want to ensure that all attrs are before all methods
-        attrs.insert(attrs.end(), methods.begin(), methods.end());
-        return Node(NodeType::classNode, classNode(attrCount, methodCount, interface_name), attrs);
+        return ast.add(Node(
+            NodeType::classNode, classNode(attrCount, methodCount, interface_name),
+            popChildren(mark, NodeType::varNode)));
     }
 
     [[nodiscard]] Node_Result Parser::parseConst() noexcept {
@@ -270,7 +416,7 @@ namespace Winter {
         if (check(TokenType::kw_let)) {
             Node_Result maybe_return = parseLet(true);
             if (!maybe_return.has_value()) { return std::unexpected(maybe_return.error()); }
-            if (maybe_return.value().type == NodeType::varNode) {
+            if (ast[maybe_return.value()].type == NodeType::varNode) {
                 consume();  // consume ';'
             }
             return maybe_return.value();
@@ -289,21 +435,22 @@ namespace Winter {
         }
         consume();
 
-        std::vector<Node> idents = {};
+        const std::size_t mark = scratch.size();
         while (!check(TokenType::rbrace)) {
-            std::string ident = current.toString(&L);
-            idents.push_back(Node(NodeType::identNode, identNode(ident)));
+            Symbol ident = current.toSymbol(&L);
+            scratch.push_back(ast.add(NodeType::identNode, identNode(ident)));
             consume();
 
             if (check(TokenType::comma)) { consume(); }
             if (!check(TokenType::ident)) { break; }
         }
 
-        return Node(NodeType::enumNode, enumNode(static_cast<int>(idents.size())), idents);
+        const auto count = static_cast<int>(scratch.size() - mark);
+        return ast.add(Node(NodeType::enumNode, enumNode(count), popChildren(mark)));
     }
 
     [[nodiscard]] Node_Result Parser::parseExpr(std::size_t min_bp) noexcept {
-        Node lhs = Node::tombstone();
+        NodeId lhs = 0;
         switch (current.type) {
             case TokenType::num_literal: {
                 Node_Result lhs_ret = parseNumLit();
@@ -327,8 +474,8 @@ namespace Winter {
             } break;
 
             case TokenType::ident: {
-                std::string ident = current.toString(&L);
-                lhs = Node(NodeType::identNode, identNode(ident));
+                Symbol ident = current.toSymbol(&L);
+                lhs = ast.add(NodeType::identNode, identNode(ident));
                 consume();
             } break;
 
@@ -345,17 +492,27 @@ namespace Winter {
             } break;
 
             case TokenType::kw_true: {
-                lhs = Node(NodeType::boolNode, boolNode(true));
+                lhs = ast.add(NodeType::boolNode, boolNode(true));
                 consume();
             } break;
 
             case TokenType::kw_false: {
-                lhs = Node(NodeType::boolNode, boolNode(false));
+                lhs = ast.add(NodeType::boolNode, boolNode(false));
+                consume();
+            } break;
+
+            case TokenType::minus:
+            case TokenType::op_not: {
+                const TokenType op = current.type;
+                const std::uint32_t at = current.start;
                 consume();
+                Node_Result operand = parseExpr(opInfo(op).prefix);
+                if (!operand.has_value()) { return std::unexpected(operand.error()); }
+                lhs = ast.add(NodeType::exprNode, exprNode(1, op, at), {operand.value()});
             } break;
 
-            case TokenType::semicolon: break;
-            case TokenType::rparen:    break;
+            case TokenType::semicolon:
+            case TokenType::rparen:    lhs = ast.add(Node::tombstone()); break;
             default:
                 return std::unexpected(Error(ErrType::Parser, "Unexpected token in pratt parsing"));
         };
@@ -365,19 +522,31 @@ namespace Winter {
             if (check(TokenType::rparen)) { return lhs; }
 
             const TokenType op = current.type;
-            const auto bp = infixBindingPower.find(op);
-            if (bp == infixBindingPower.end()) {
+            const std::uint32_t at = current.start;
+            const OpInfo& info = opInfo(op);
+
+            if (info.postfix != 0) {
+                if (info.postfix < min_bp) { break; }
+                consume();
+                lhs = ast.add(NodeType::exprNode, exprNode(1, op, at), {lhs});
+                continue;
+            }
+
+            if (info.infix == 0) {
                 return std::unexpected(
                     Error(ErrType::Parser, std::format("No bp found for op: {}", op)));
             }
 
-            if (bp->second < min_bp) { break; }
+            if (info.infix < min_bp) { break; }
             consume();
 
-            Node_Result rhs = parseExpr(bp->second);
+            // The right operand binds one tighter for left associative operators, so an
+            // operator of the same power ends it and is folded in by this loop instead
+            const std::size_t rhs_bp = info.assoc == Assoc::left ? info.infix + 1u : info.infix;
+            Node_Result rhs = parseExpr(rhs_bp);
             if (!rhs.has_value()) { return std::unexpected(rhs.error()); }
 
-            lhs = Node(NodeType::exprNode, exprNode(2, op), {lhs, rhs.value()});
+            lhs = ast.add(NodeType::exprNode, exprNode(2, op, at), {lhs, rhs.value()});
         }
 
         return lhs;
@@ -393,13 +562,13 @@ namespace Winter {
         }
         consume();  // consume lparen
 
-        std::vector<Node> children = {};
+        const std::size_t mark = scratch.size();
 
         if (check(TokenType::kw_let)) {
             // basic for-loop
             Node_Result start = parseLet(false);
             if (!start.has_value()) { return std::unexpected(start.error()); }
-            if (start.value().type == NodeType::varNode) {
+            if (ast[start.value()].type == NodeType::varNode) {
                 consume();  // consume ';'
             }
 
@@ -409,19 +578,20 @@ namespace Winter {
             Node_Result step = parseExpr(0);
             if (!step.has_value()) { return std::unexpected(step.error()); }
 
-            children = {start.value(), stop.value(), step.value()};
+            scratch.insert(scratch.end(), {start.value(), stop.value(), step.value()});
         } else if (check(TokenType::ident)) {
-            Node ident = Node(NodeType::identNode, identNode(current.toString(&L)));
+            const NodeId ident = ast.add(NodeType::identNode, identNode(current.toSymbol(&L)));
 
             if (!consume({TokenType::colon})) {
                 return std::unexpected(Error(ErrType::Parser, "No container found in for-each"));
             }
             consume();
 
-            Node container = Node(NodeType::identNode, identNode(current.toString(&L)));
+            const NodeId container =
+                ast.add(NodeType::identNode, identNode(current.toSymbol(&L)));
             consume();
 
-            children = {ident, container};
+            scratch.insert(scratch.end(), {ident, container});
         } else {
             return std::unexpected(
                 Error(ErrType::Parser, "Incorrect token found when parsing kw_for"));
@@ -433,9 +603,9 @@ namespace Winter {
 
         Node_Result body = parseBody();
         if (!body.has_value()) { return std::unexpected(body.error()); }
-        children.push_back(body.value());
+        scratch.push_back(body.value());
 
-        return Node(NodeType::forNode, forNode(), children);
+        return ast.add(Node(NodeType::forNode, forNode(), popChildren(mark)));
     }
 
     [[nodiscard]] Node_Result Parser::parseFunc() noexcept {
@@ -451,14 +621,14 @@ namespace Winter {
         consume();  // Consume the lparen we've just moved to
 
         // Contents
-        std::vector<Node> parameters = {};
-        std::string retType;
+        const std::size_t mark = scratch.size();
+        Symbol retType;
 
         while (!check(TokenType::rparen)) {
             auto param = parseParam();
             if (!param.has_value()) { return std::unexpected(param.error()); }
 
-            parameters.push_back(param.value());
+            scratch.push_back(param.value());
             // Move forward to next token. If it's a comma, move ahead again
             if (consume({TokenType::comma})) { consume(); }
         }
@@ -467,19 +637,21 @@ namespace Winter {
             return std::unexpected(Error(ErrType::Parser, "function return type not found"));
         }
 
-        retType = current.toString(&L);
+        retType = current.toSymbol(&L);
 
         if (!consume({TokenType::lbrace})) {
             return std::unexpected(Error(ErrType::Parser, "function body not not found"));
         }
 
+        // The parameters stay on the scratch stack below anything the body pushes
         Node_Result expected_body = parseBody();
         if (!expected_body.has_value()) { return std::unexpected(expected_body.error()); }
 
         // TODO: Refactor how funcNodes are created as we can probably return them straight
         // from parseLet -- I don't think we need letNodes
-        return Node(
-            NodeType::funcNode, funcNode(1, "", parameters, retType), {expected_body.value()});
+        return ast.add(
+            NodeType::funcNode, funcNode(1, Symbol {}, popChildren(mark), retType),
+            {expected_body.value()});
     }
 
     [[nodiscard]] Node_Result Parser::parseFuncCall() noexcept {
@@ -488,8 +660,8 @@ namespace Winter {
         }
 
         // NOTE: the function name token is at `prev`
-        std::string funcName = prev.toString(&L);
-        std::vector<Node> args = {};
+        Symbol funcName = prev.toSymbol(&L);
+        const std::size_t mark = scratch.size();
 
         consume();
 
@@ -497,14 +669,14 @@ namespace Winter {
             auto arg = parseArg();
             if (!arg.has_value()) { return std::unexpected(arg.error()); }
 
-            args.push_back(arg.value());
+            scratch.push_back(arg.value());
             // Move forward to next token. If it's a comma, move ahead again
             if (consume({TokenType::comma})) { consume(); }
         }
 
         consume();  // consume rparen
         consume();  // consume semicolon
-        return Node(NodeType::callNode, funcCallNode(funcName), args);
+        return ast.add(Node(NodeType::callNode, funcCallNode(funcName), popChildren(mark)));
     }
 
     [[nodiscard]] Node_Result Parser::parseIf() noexcept {
@@ -523,9 +695,9 @@ namespace Winter {
 
         consume();
         Node_Result body = parseBody();
-        if (!body.has_value()) { return conditional; }
+        if (!body.has_value()) { return std::unexpected(body.error()); }
 
-        Node else_node = Node::tombstone();
+        std::optional<NodeId> else_node = std::nullopt;
         if (check(TokenType::kw_else)) {
             // else if ...
             if (consume({TokenType::kw_if})) {
@@ -541,9 +713,12 @@ namespace Winter {
             }
         }
 
-        std::vector<Node> children = {conditional.value(), body.value()};
-        if (else_node != Node::tombstone()) { children.push_back(else_node); }
-        return Node(NodeType::ifNode, ifNode(children.size()), children);
+        if (else_node.has_value()) {
+            const NodeId else_id = else_node.value();
+            return ast.add(
+                NodeType::ifNode, ifNode(3), {conditional.value(), body.value(), else_id});
+        }
+        return ast.add(NodeType::ifNode, ifNode(2), {conditional.value(), body.value()});
     }
 
     [[nodiscard]] Node_Result Parser::parseInterfaceInner() noexcept {
@@ -559,7 +734,7 @@ namespace Winter {
             return std::unexpected(Error(ErrType::Parser, "No name found for let"));
         }
 
-        const std::string name = current.toString(&L);
+        const Symbol name = current.toSymbol(&L);
 
         if (!consume({TokenType::op_equal, TokenType::colon})) {
             return std::unexpected(
@@ -575,7 +750,7 @@ namespace Winter {
                     Error(ErrType::Parser, "Malformed `let`: no type specified after colon"));
             }
 
-            std::string type_lit = current.toString(&L);
+            Symbol type_lit = current.toSymbol(&L);
 
             if (!consume({TokenType::semicolon})) {
                 return std::unexpected(Error(
@@ -583,7 +758,7 @@ namespace Winter {
             }
 
             consume();
-            return Node(NodeType::varNode, varNode(0, name, type_lit, isConst));
+            return ast.add(NodeType::varNode, varNode(0, name, type_lit, isConst));
 
         } else if (check(TokenType::op_equal)) {
             // method
@@ -595,26 +770,26 @@ namespace Winter {
             consume();  // kw_func
             consume();  // lparen
 
-            std::vector<Node> parameters = {};
+            const std::size_t mark = scratch.size();
             while (!check(TokenType::rparen)) {
                 Node_Result param = parseParam();
                 if (!param.has_value()) { return std::unexpected(param.error()); }
 
-                parameters.push_back(param.value());
+                scratch.push_back(param.value());
                 // Move forward to next token. If it's a comma, move ahead again
                 if (consume({TokenType::comma})) { consume(); }
             }
 
             consume();  // rparen
 
-            std::string ret_type = current.toString(&L);
+            Symbol ret_type = current.toSymbol(&L);
             if (!consume({TokenType::semicolon})) {
                 return std::unexpected(
                     Error(ErrType::Parser, "Interface method never closed. Expected `;`"));
             }
             consume();
 
-            return Node(NodeType::funcNode, funcNode(0, name, parameters, ret_type));
+            return ast.add(NodeType::funcNode, funcNode(0, name, popChildren(mark), ret_type));
         }
 
         return std::unexpected(Error(ErrType::Parser, "Unexpected type in interface"));
@@ -634,19 +809,19 @@ namespace Winter {
 
         int attrCount = 0;
         int methodCount = 0;
-        std::vector<Node> attrs = {};
-        std::vector<Node> methods = {};
+        const std::size_t mark = scratch.size();
 
         while (!check(TokenType::rbrace)) {
             Node_Result val = parseInterfaceInner();
             if (!val.has_value()) { return std::unexpected(val.error()); }
 
-            if (val.value().type == NodeType::varNode) {
+            const NodeType valType = ast[val.value()].type;
+            if (valType == NodeType::varNode) {
                 attrCount++;
-                attrs.push_back(val.value());
-            } else if (val.value().type == NodeType::funcNode) {
+                scratch.push_back(val.value());
+            } else if (valType == NodeType::funcNode) {
                 methodCount++;
-                methods.push_back(val.value());
+                scratch.push_back(val.value());
             } else {
                 return std::unexpected(Error(
                     ErrType::Parser,
@@ -654,8 +829,9 @@ namespace Winter {
             }
         }
 
-        attrs.insert(attrs.end(), methods.begin(), methods.end());
-        return Node(NodeType::interfaceNode, interfaceNode(attrCount, methodCount), attrs);
+        return ast.add(Node(
+            NodeType::interfaceNode, interfaceNode(attrCount, methodCount),
+            popChildren(mark, NodeType::varNode)));
     }
 
     [[nodiscard]] Node_Result Parser::parseLet(const bool isConst) noexcept {
@@ -667,7 +843,7 @@ namespace Winter {
             return std::unexpected(Error(ErrType::Parser, "No name found for let"));
         }
 
-        const std::string name = current.toString(&L);
+        const Symbol name = current.toSymbol(&L);
 
         if (!consume({TokenType::op_equal, TokenType::colon})) {
             return std::unexpected(
@@ -682,7 +858,7 @@ namespace Winter {
                     Error(ErrType::Parser, "Malformed `let`: no type specified after colon"));
             }
 
-            std::string type_lit = current.toString(&L);
+            Symbol type_lit = current.toSymbol(&L);
 
             if (!consume({TokenType::op_equal, TokenType::semicolon})) {
                 return std::unexpected(
@@ -690,13 +866,13 @@ namespace Winter {
             }
 
             if (check(TokenType::semicolon)) {
-                return Node(NodeType::varNode, varNode(0, name, type_lit, isConst));
+                return ast.add(NodeType::varNode, varNode(0, name, type_lit, isConst));
             }
 
             consume();  // consume `=`
             Node_Result rhs = parseExpr(0);
             if (!rhs.has_value()) { return std::unexpected(rhs.error()); }
-            return Node(NodeType::varNode, varNode(1, name, type_lit, isConst), {rhs.value()});
+            return ast.add(NodeType::varNode, varNode(1, name, type_lit, isConst), {rhs.value()});
         }
 
         if (!consume({TokenType::kw_func})) {
@@ -705,17 +881,10 @@ namespace Winter {
 
         // TODO: we might not need the `let` node at all, just return a funcNode her, as we
         // return a varNode above instead.
-        bool isFunc = false;
-        Node rhs = Node::tombstone();
-        if (check(TokenType::kw_func)) {
-            Node_Result func = parseFunc();
-            if (!func.has_value()) { return std::unexpected(func.error()); }
-
-            rhs = func.value();
-            isFunc = true;
-        }
+        Node_Result func = parseFunc();
+        if (!func.has_value()) { return std::unexpected(func.error()); }
 
-        return Node(NodeType::letNode, letNode(name, isFunc, isConst), {rhs});
+        return ast.add(NodeType::letNode, letNode(name, true, isConst), {func.value()});
     }
 
     [[nodiscard]] Node_Result Parser::parseMod() noexcept {
@@ -727,7 +896,7 @@ namespace Winter {
             return std::unexpected(Error(ErrType::Parser, "No module name found"));
         }
 
-        std::string name = current.toString(&L);
+        Symbol name = current.toSymbol(&L);
 
         if (!consume({TokenType::semicolon})) {
             return std::unexpected(
@@ -735,7 +904,7 @@ namespace Winter {
         }
         consume();  // consume semicolon
 
-        return Node(NodeType::modNode, modNode(name));
+        return ast.add(NodeType::modNode, modNode(name));
     }
 
     [[nodiscard]] Node_Result Parser::parseNumLit() noexcept {
@@ -744,7 +913,9 @@ namespace Winter {
                 Error(ErrType::Parser, "Unexpected token: expected num literal"));
         }
 
-        return Node(NodeType::numlitNode, numlitNode(current.toNum(&L)));
+        auto num = current.toNum(&L);
+        if (!num.has_value()) { return std::unexpected(num.error()); }
+        return ast.add(NodeType::numlitNode, numlitNode(num.value()));
     }
 
     [[nodiscard]] Node_Result Parser::parseParam() noexcept {
@@ -753,16 +924,16 @@ namespace Winter {
                 Error(ErrType::Parser, "Unexpected token: expected parameter ident"));
         }
 
-        std::string name = current.toString(&L);
+        Symbol name = current.toSymbol(&L);
 
         if (!consume({TokenType::colon})) {
             return std::unexpected(
                 Error(ErrType::Parser, "Unexpected token: parameter type not set"));
         }
         consume();
-        std::string type = current.toString(&L);
+        Symbol type = current.toSymbol(&L);
 
-        return Node(NodeType::paramNode, paramNode(name, type));
+        return ast.add(NodeType::paramNode, paramNode(name, type));
     }
 
     [[nodiscard]] Node_Result Parser::parseReturn() noexcept {
@@ -776,7 +947,7 @@ namespace Winter {
 
         if (check(TokenType::semicolon)) { consume(); }
 
-        return Node(NodeType::returnNode, returnNode(), {expr.value()});
+        return ast.add(NodeType::returnNode, returnNode(), {expr.value()});
     }
 
     [[nodiscard]] Node_Result Parser::parseStrLit() noexcept {
@@ -785,11 +956,10 @@ namespace Winter {
                 Error(ErrType::Parser, "Unexpected token: expected str_literal"));
         }
 
-        // try to strip off the quotes
-        current.start++;
-        current.len -= 2;
-
-        return Node(NodeType::strLitNode, strLitNode(current.toString(&L)));
+        // strip off the quotes
+        const std::size_t len = current.length(&L);
+        return ast.add(
+            NodeType::strLitNode, strLitNode(intern(L.src.substr(current.start + 1, len - 2))));
     }
 
     [[nodiscard]] Node_Result Parser::parseSwitch() noexcept {
@@ -803,16 +973,16 @@ namespace Winter {
         }
         consume();  // consume lparen
 
-        const std::string value = current.toString(&L);
+        const Symbol value = current.toSymbol(&L);
         consume();  // consume ident
         consume();  // consume rparen
         consume();  // consume lbrace
 
-        std::vector<Node> cases = {};
+        const std::size_t mark = scratch.size();
         while (check(TokenType::kw_case)) {
             Node_Result case_node = parseCase();
             if (!case_node.has_value()) { return std::unexpected(case_node.error()); }
-            cases.push_back(case_node.value());
+            scratch.push_back(case_node.value());
         }
 
         bool hasDefault = false;
@@ -820,13 +990,13 @@ namespace Winter {
             hasDefault = true;
             Node_Result case_node = parseCase();
             if (!case_node.has_value()) { return std::unexpected(case_node.error()); }
-            cases.push_back(case_node.value());
+            scratch.push_back(case_node.value());
         }
 
         consume();  // consume '}'
-        return Node(
-            NodeType::switchNode, switchNode(value, static_cast<int>(cases.size()), hasDefault),
-            cases);
+        const auto count = static_cast<int>(scratch.size() - mark);
+        return ast.add(Node(
+            NodeType::switchNode, switchNode(value, count, hasDefault), popChildren(mark)));
     }
 
     [[nodiscard]] Node_Result Parser::parseType() noexcept {
@@ -835,13 +1005,13 @@ namespace Winter {
         }
         consume();
 
-        const std::string name = current.toString(&L);
+        const Symbol name = current.toSymbol(&L);
         if (!consume({TokenType::op_equal})) {
             return std::unexpected(Error(ErrType::Parser, "Unexpected token: No type body found"));
         }
         consume();
 
-        Node_Result body = Node::tombstone();
+        Node_Result body = NodeId {};
         NodeType childType;
 
         switch (current.type) {
@@ -862,51 +1032,340 @@ namespace Winter {
 
         if (!body.has_value()) { return std::unexpected(body.error()); }
 
-        return Node(NodeType::typeNode, typeNode(childType), {body.value()});
+        return ast.add(NodeType::typeNode, typeNode(childType), {body.value()});
     }
 
     [[nodiscard]] Node_Result Parser::parseVariable() noexcept {
         return std::unexpected(Error(ErrType::NotImplemented, "parseVariable"));
     }
 
-    [[nodiscard]] std::expected<std::vector<Node>, Error> Parser::operator()() {
-        std::vector<Node> code = {};
+    // Parse one top-level item, leaving `current` on the first token after it
+    [[nodiscard]] Node_Result Parser::parseTopLevel() noexcept {
+        if (current.type == TokenType::kw_let) {
+            return parseLet(false);
+        } else if (current.type == TokenType::kw_mod) {
+            return parseMod();
+        } else if (current.type == TokenType::kw_const) {
+            return parseConst();
+        } else if (current.type == TokenType::kw_alias) {
+            return parseAlias();
+        } else if (current.type == TokenType::kw_type) {
+            Node_Result expected = parseType();
+            consume();
+            return expected;
+        }
+
+        return std::unexpected(
+            Error(ErrType::Parser, "Unexpected token found. Expected top-level keyword"));
+    }
+
+    // Parse every top-level item. On success the tree is moved out of the parser. On
+    // failure the first error is returned, with every error in `errors` and the items
+    // that did parse left in `ast`
+    [[nodiscard]] std::expected<Ast, Error> Parser::operator()() {
+        if (lexError.has_value()) { return std::unexpected(lexError.value()); }
+
+        errors.clear();
+        std::vector<std::size_t> items = {};  // only needed once something fails
 
         consume();  // start
         while (!check(TokenType::eof)) {
-            Node_Result expected = std::unexpected(
-                Error(ErrType::Parser, "Unexpected token found. Expected top-level keyword"));
-
-            if (current.type == TokenType::kw_let) {
-                expected = parseLet(false);
-            } else if (current.type == TokenType::kw_mod) {
-                expected = parseMod();
-            } else if (current.type == TokenType::kw_const) {
-                expected = parseConst();
-            } else if (current.type == TokenType::kw_alias) {
-                expected = parseAlias();
-            } else if (current.type == TokenType::kw_type) {
-                expected = parseType();
-                consume();
+            const std::size_t start = cursor - 1;
+            const std::size_t mark = scratch.size();
+            const std::size_t firstError = errors.size();
+            Node_Result expected = parseTopLevel();
+            if (expected.has_value()) {
+                ast.roots.push_back(expected.value());
+                continue;
+            }
+
+            // Resume at the next item. A broken item can run on into the ones after it,
+            // so errors found past that point are dropped, as they are found again
+            if (items.empty()) { items = topLevelItems(); }
+            const auto next = std::ranges::upper_bound(items, start);
+            std::size_t resume = tokens.size() - 1;
+            if (next != items.end()) {
+                resume = *next;
+                const auto found = std::ranges::remove_if(
+                    errors.begin() + static_cast<std::ptrdiff_t>(firstError), errors.end(),
+                    [this, resume](const ParseError& err) {
+                        return err.offset >= tokens.starts[resume];
+                    });
+                errors.erase(found.begin(), found.end());
             }
 
-            if (!expected.has_value()) { return std::unexpected(expected.error()); }
-            code.push_back(expected.value());
+            report(expected.error());
+            scratch.resize(mark);
+            cursor = resume;
+            consume();
+        }
+
+        if (!errors.empty()) {
+            std::ranges::stable_sort(errors, {}, &ParseError::offset);
+            return std::unexpected(errors.front().error);
+        }
+        return std::move(ast);
+    }
+
+    // Source text of tokens [begin, end). Whitespace and comments between the tokens are
+    // included, so editing them still counts as a change
+    [[nodiscard]] SourceSpan Parser::itemSpan(std::size_t begin, std::size_t end) const {
+        if (begin >= end) { return {0, 0}; }
+        const Token last = tokens.at(end - 1);
+        return {tokens.starts[begin], last.start + last.length(&L)};
+    }
+
+    // The digest `previous` has for the item at `span`, if `edit` left its text alone and
+    // it was an item before too. Text after the edit only moved
+    [[nodiscard]] static std::optional<SourceDigest>
+    keptDigest(const ParseSnapshot& previous, SourceSpan span, const TextEdit& edit) {
+        std::size_t begin = span.begin;
+        if (span.end > edit.offset) {
+            if (span.begin < edit.offset + edit.inserted.size()) { return std::nullopt; }
+            begin = span.begin - edit.inserted.size() + edit.removed;
+        }
+
+        const auto found =
+            std::ranges::lower_bound(previous.itemSpans, begin, {}, &SourceSpan::begin);
+        if (found == previous.itemSpans.end() || found->begin != begin ||
+            found->end - found->begin != span.end - span.begin) {
+            return std::nullopt;
+        }
+        return previous.itemDigests[static_cast<std::size_t>(found - previous.itemSpans.begin())];
+    }
+
+    // Call `fn` with every node of the trees under `roots`, parameters included
+    template <typename Fn>
+    static void forEachNode(const Ast& tree, std::span<const NodeId> roots, Fn&& fn) {
+        std::vector<NodeId> stack(roots.begin(), roots.end());
+        while (!stack.empty()) {
+            const NodeId id = stack.back();
+            stack.pop_back();
+            fn(id);
+            const std::span<const NodeId> children = tree.children(id);
+            stack.insert(stack.end(), children.begin(), children.end());
+            if (const auto* func = std::get_if<funcNode>(&tree[id].data)) {
+                const std::span<const NodeId> params = tree.range(func->parameters);
+                stack.insert(stack.end(), params.begin(), params.end());
+            }
         }
+    }
 
-        return code;
+    // Nodes reachable from the roots of `tree`
+    [[nodiscard]] static std::size_t liveNodes(const Ast& tree) {
+        std::size_t count = 0;
+        forEachNode(tree, tree.roots, [&count](NodeId) { count++; });
+        return count;
     }
 
-    void Parser::display_syntax_tree(const std::vector<Node>& tree) const noexcept {
-        auto helper = [](this auto self, const Node x, const int offset) -> void {
-            std::print("{}", std::string(offset, ' '));
+    // Move the source offsets kept in the tree under `root` from `from` to `to`, for an
+    // item that is reused where the edit moved it
+    static void moveItem(Ast& tree, NodeId root, std::size_t from, std::size_t to) {
+        if (from == to) { return; }
+        // offsets fit in 32 bits, so wrapping arithmetic moves them either way
+        const auto delta = static_cast<std::uint32_t>(to - from);
+        forEachNode(tree, std::span(&root, 1), [&tree, delta](NodeId id) {
+            if (auto* expr = std::get_if<exprNode>(&tree[id].data)) { expr->offset += delta; }
+        });
+    }
 
-            std::visit([](auto&& v) { std::println("{}", v.display()); }, x.data);
-            for (auto child : x.children) { self(child, offset + 2); }
+    // Parse the file again, reusing the trees of top-level items whose text is unchanged
+    // since `previous`. Items are matched by digest rather than position, so inserting or
+    // moving an item costs no more than editing one.
+    //
+    // The new snapshot takes over `previous`'s arena: reused roots are the subtrees
+    // already in it, and only reparsed items are added. Trees of items that changed stay
+    // behind, unreachable, until they outnumber the live nodes and the rest are copied
+    // into a fresh arena, or a parse falls back to the whole file.
+    // Pair this with `Lexer::relex` and the `Parser(const Lexer&, TokenBuffer)`
+    // constructor to skip lexing the file again; given the same `edit`, items it didn't
+    // touch keep their digests rather than being hashed again
+    [[nodiscard]] std::expected<ParseSnapshot, Error>
+    Parser::reparse(ParseSnapshot previous, std::optional<TextEdit> edit) {
+        if (lexError.has_value()) { return std::unexpected(lexError.value()); }
+
+        const std::vector<std::size_t> items = topLevelItems();
+        const std::size_t eof = tokens.size() - 1;
+        auto itemEnd = [&items, eof](std::size_t i) {
+            return i + 1 < items.size() ? items[i + 1] : eof;
+        };
+
+        if (previous.itemSpans.size() != previous.itemDigests.size()) { edit = std::nullopt; }
+        ParseSnapshot next = {};
+        next.itemDigests.reserve(items.size());
+        next.itemSpans.reserve(items.size());
+        for (std::size_t i = 0; i < items.size(); i++) {
+            const SourceSpan span = itemSpan(items[i], itemEnd(i));
+            std::optional<SourceDigest> digest = std::nullopt;
+            if (edit.has_value()) { digest = keptDigest(previous, span, edit.value()); }
+            if (!digest.has_value()) {
+                digest = digestSource(L.src.substr(span.begin, span.end - span.begin));
+            }
+            next.itemSpans.push_back(span);
+            next.itemDigests.push_back(digest.value());
+        }
+
+        // Anything the item scan can't vouch for is handled by parsing the whole file,
+        // so errors and odd input give exactly the result of a normal parse
+        auto parseAll = [this, &next]() -> std::expected<ParseSnapshot, Error> {
+            ast = {};
+            scratch.clear();
+            cursor = 0;
+            std::expected<Ast, Error> full = (*this)();
+            if (!full.has_value()) { return std::unexpected(full.error()); }
+
+            next.ast = std::move(full.value());
+            next.reparsedItems = next.ast.roots.size();
+            if (next.ast.roots.size() != next.itemDigests.size()) {
+                next.itemDigests.clear();
+                next.itemSpans.clear();
+            }
+            return std::move(next);
         };
 
+        const bool strayTokens = items.empty() ? eof != 0 : items.front() != 0;
+        if (strayTokens) { return parseAll(); }
+
+        // A 64-bit hash matching isn't enough to swap in another item's tree, so the
+        // length and second hash of the digest have to match too
+        std::unordered_multimap<SourceDigest, std::size_t> reusable = {};
+        if (previous.itemDigests.size() == previous.ast.roots.size() &&
+            previous.itemSpans.size() == previous.ast.roots.size()) {
+            for (std::size_t i = 0; i < previous.itemDigests.size(); i++) {
+                reusable.emplace(previous.itemDigests[i], i);
+            }
+        }
+        const std::vector<NodeId> previousRoots = std::move(previous.ast.roots);
+        ast = std::move(previous.ast);
+        ast.roots.clear();
+
+        for (std::size_t i = 0; i < items.size(); i++) {
+            const auto found = reusable.find(next.itemDigests[i]);
+            if (found != reusable.end()) {
+                const std::size_t old = found->second;
+                moveItem(
+                    ast, previousRoots[old], previous.itemSpans[old].begin,
+                    next.itemSpans[i].begin);
+                ast.roots.push_back(previousRoots[old]);
+                reusable.erase(found);
+                continue;
+            }
+
+            cursor = items[i];
+            consume();
+            Node_Result item = parseTopLevel();
+            // the parser must finish exactly where the scan says the next item starts
+            if (!item.has_value() || !errors.empty() || cursor - 1 != itemEnd(i)) {
+                return parseAll();
+            }
+            ast.roots.push_back(item.value());
+            next.reparsedItems++;
+        }
+
+        // Memory follows the size of the file rather than the number of edits
+        const std::size_t live = liveNodes(ast);
+        if (ast.size() - live > live) {
+            Ast compact = {};
+            compact.nodes.reserve(live);
+            std::vector<NodeId> stack = {};
+            for (NodeId root : ast.roots) {
+                compact.roots.push_back(compact.copyTree(ast, root, stack));
+            }
+            ast = std::move(compact);
+        }
+
+        next.ast = std::move(ast);
+        return next;
+    }
+
+    // Token index of the first token of each top-level item. Items can only start at
+    // bracket depth 0, so this is one pass over the token types without parsing anything
+    [[nodiscard]] std::vector<std::size_t> Parser::topLevelItems() const {
+        std::vector<std::size_t> items = {};
+        std::size_t depth = 0;
+
+        for (std::size_t i = 0; i < tokens.size(); i++) {
+            switch (tokens.types[i]) {
+                case TokenType::lparen:
+                case TokenType::lbrace:
+                case TokenType::lsquacket: depth++; break;
+
+                case TokenType::rparen:
+                case TokenType::rbrace:
+                case TokenType::rsquacket:
+                    if (depth > 0) { depth--; }
+                    break;
+
+                case TokenType::kw_let:
+                case TokenType::kw_mod:
+                case TokenType::kw_const:
+                case TokenType::kw_alias:
+                case TokenType::kw_type:
+                    // `const let` is one item
+                    if (depth == 0 && (i == 0 || tokens.types[i - 1] != TokenType::kw_const)) {
+                        items.push_back(i);
+                    }
+                    break;
+
+                default: break;
+            }
+        }
+
+        return items;
+    }
+
+    // Parse on up to `jobs` threads. The tokens are split at top-level item boundaries,
+    // each part is parsed into its own tree, and the trees are joined in source order
+    [[nodiscard]] std::expected<Ast, Error> Parser::operator()(std::size_t jobs) {
+        if (lexError.has_value()) { return std::unexpected(lexError.value()); }
+
+        const std::vector<std::size_t> items = topLevelItems();
+        const std::size_t parts = std::min(jobs, items.size() / minItemsPerJob);
+        if (parts <= 1) { return (*this)(); }
+
+        // Part `i` is tokens [bounds[i], bounds[i + 1]). The first part also takes anything
+        // before the first item, so stray tokens are still reported
+        std::vector<std::size_t> bounds = {0};
+        for (std::size_t i = 1; i < parts; i++) {
+            bounds.push_back(items[i * items.size() / parts]);
+        }
+        bounds.push_back(tokens.size() - 1);  // the final eof is added to every part
+
+        std::vector<std::expected<Ast, Error>> results(parts);
+        {
+            std::vector<std::jthread> workers = {};
+            workers.reserve(parts);
+            for (std::size_t i = 0; i < parts; i++) {
+                workers.emplace_back([this, &bounds, &results, i] {
+                    TokenBuffer buf = tokens.slice(bounds[i], bounds[i + 1]);
+                    buf.push(Token(TokenType::eof, 0));
+                    Parser worker = Parser(L, std::move(buf));
+                    results[i] = worker();
+                });
+            }
+        }
+
+        // A boundary found inside malformed code can make a part fail differently to the
+        // whole file, so errors always come from a sequential parse
+        for (const auto& result : results) {
+            if (!result.has_value()) { return (*this)(); }
+        }
+
+        for (const auto& result : results) { ast.append(result.value()); }
+        return std::move(ast);
+    }
+
+    // One line per node, indented under its parent
+    struct TreePrinter {
+        void pre(WalkPos pos, const auto& payload) const {
+            std::println("{}{}", std::string(pos.depth * 2, ' '), payload.display());
+        }
+    };
+
+    void Parser::display_syntax_tree(const Ast& tree) noexcept {
         std::println("=== PARSER ===");
-        for (Node elem : tree) { helper(elem, 0); }
+        TreePrinter printer = {};
+        walk(tree, printer);
         std::println();
     }
 
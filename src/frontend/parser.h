@@ -1,54 +1,128 @@
 #ifndef WINTER_PARSER_H
 #define WINTER_PARSER_H
 
+#include <array>
+#include <cstdint>
 #include <expected>
 #include <initializer_list>
 #include <memory>
+#include <optional>
 #include <string_view>
+#include <utility>
 #include <variant>
 #include <vector>
 
 #include "../error.h"
 #include "ast.h"
+#include "hash.h"
 #include "lexer.h"
 
 namespace Winter {
-    using Node_Result = std::expected<Node, Error>;
+    using Node_Result = std::expected<NodeId, Error>;
+
+    enum class Assoc : std::uint8_t { left, right };
+
+    // How a token behaves in an expression. A binding power of 0 means the token can't
+    // be used in that position
+    struct OpInfo {
+        std::uint8_t infix = 0;
+        Assoc assoc = Assoc::left;
+        std::uint8_t prefix = 0;  // binding power of the operand of a unary operator
+        std::uint8_t postfix = 0;
+    };
+
+    inline constexpr std::array<OpInfo, tokenTypeCount> opTable = [] {
+        std::array<OpInfo, tokenTypeCount> table = {};
+        auto set = [&table](TokenType type, OpInfo info) {
+            table[static_cast<std::size_t>(type)] = info;
+        };
+
+        // clang-format off
+        //   token                        infix  assoc         prefix  postfix
+        set(TokenType::plus_plus,        {0,     Assoc::left,  0,      10});
+        set(TokenType::minus_minus,      {0,     Assoc::left,  0,      10});
+        set(TokenType::dot,              {9,     Assoc::left,  0,      0});
+        set(TokenType::lparen,           {9,     Assoc::left,  0,      0});
+        set(TokenType::op_not,           {0,     Assoc::left,  8,      0});
+        set(TokenType::star,             {7,     Assoc::left,  0,      0});
+        set(TokenType::slash,            {7,     Assoc::left,  0,      0});
+        set(TokenType::plus,             {6,     Assoc::left,  0,      0});
+        set(TokenType::minus,            {6,     Assoc::left,  8,      0});
+        set(TokenType::dot_dot,          {6,     Assoc::left,  0,      0});
+        set(TokenType::op_greater,       {5,     Assoc::left,  0,      0});
+        set(TokenType::op_greater_eq,    {5,     Assoc::left,  0,      0});
+        set(TokenType::op_less,          {5,     Assoc::left,  0,      0});
+        set(TokenType::op_less_eq,       {5,     Assoc::left,  0,      0});
+        set(TokenType::op_equal_eq,      {4,     Assoc::left,  0,      0});
+        set(TokenType::op_not_eq,        {4,     Assoc::left,  0,      0});
+        set(TokenType::op_and,           {3,     Assoc::left,  0,      0});
+        set(TokenType::op_or,            {2,     Assoc::left,  0,      0});
+        set(TokenType::op_equal,         {1,     Assoc::right, 0,      0});
+        // clang-format on
+
+        return table;
+    }();
+
+    [[nodiscard]] constexpr const OpInfo& opInfo(TokenType type) noexcept {
+        return opTable[static_cast<std::size_t>(type)];
+    }
+
+    // Source offsets [begin, end)
+    struct SourceSpan {
+        std::size_t begin;
+        std::size_t end;
+    };
+
+    // A parse kept for `Parser::reparse`
+    struct ParseSnapshot {
+        Ast ast = {};
+        std::vector<SourceDigest> itemDigests = {};  // one per root, in the same order
+        std::vector<SourceSpan> itemSpans = {};      // source text of each root, likewise
+        std::size_t reparsedItems = 0;               // items parsed rather than reused
+    };
+
+    // An error the parser recovered from, and the source offset of the token it was found at
+    struct ParseError {
+        Error error;
+        std::size_t offset;
+    };
 
     struct Parser {
         Lexer L;
+        TokenBuffer tokens;
+        Ast ast = {};
+        // Children of the nodes currently being parsed. Each parse function pushes its
+        // children above the size it saw on entry and pops them with `popChildren`
+        std::vector<NodeId> scratch = {};
+        std::size_t cursor = 0;
+        std::optional<Error> lexError = std::nullopt;
+        // Every error found by the last parse, in source order. A broken statement or
+        // top-level item is skipped and parsing carries on after it, so one parse reports
+        // all of them, and `ast` keeps whatever did parse
+        std::vector<ParseError> errors = {};
         Token current;
         Token prev;
 
-        // clang-format off
-        const std::unordered_map<TokenType, std::size_t> infixBindingPower = {
-            {TokenType::dot,            9},
-            {TokenType::lparen,         9},
-            {TokenType::rparen,         9},
-            {TokenType::star,           7},
-            {TokenType::slash,          7},
-            {TokenType::plus,           6},
-            {TokenType::minus,          6},
-            {TokenType::dot_dot,        6},
-            {TokenType::plus_plus,      6},
-            {TokenType::minus_minus,    6},
-            {TokenType::op_greater,     5},
-            {TokenType::op_greater_eq,  5},
-            {TokenType::op_less,        5},
-            {TokenType::op_less_eq,     5},
-            {TokenType::op_equal_eq,    4},
-            {TokenType::op_not_eq,      4},
-            {TokenType::op_and,         3},
-            {TokenType::op_or,          2},
-            {TokenType::op_equal,       1}
-        };
-        // clang-format on
+        // Top-level items given to each thread by a parallel parse, at least
+        static constexpr std::size_t minItemsPerJob = 8;
 
         explicit Parser(std::string_view src)
-            : L(Lexer(src)), current(Token::tombstone()), prev(Token::tombstone()) {}
+            : L(Lexer(src)), current(Token::tombstone()), prev(Token::tombstone()) {
+            tokenize();
+        }
+        // Parse tokens already lexed by `lexer`, which must end in eof
+        explicit Parser(const Lexer& lexer, TokenBuffer buf)
+            : L(lexer), tokens(std::move(buf)), current(Token::tombstone()),
+              prev(Token::tombstone()) {}
+        void tokenize();
         [[nodiscard]] bool check(const TokenType&) const noexcept;
+        [[nodiscard]] Token peek(std::size_t) const noexcept;
         void consume() noexcept;
         [[nodiscard]] bool consume(std::initializer_list<TokenType> tokens) noexcept;
+        [[nodiscard]] NodeRange popChildren(std::size_t);
+        [[nodiscard]] NodeRange popChildren(std::size_t, NodeType);
+        void report(const Error&);
+        void syncStatement(std::size_t) noexcept;
 
         [[nodiscard]] Node_Result parseAlias() noexcept;
         [[nodiscard]] Node_Result parseArg() noexcept;
@@ -73,11 +147,17 @@ namespace Winter {
         [[nodiscard]] Node_Result parseReturn() noexcept;
         [[nodiscard]] Node_Result parseStrLit() noexcept;
         [[nodiscard]] Node_Result parseSwitch() noexcept;
+        [[nodiscard]] Node_Result parseTopLevel() noexcept;
         [[nodiscard]] Node_Result parseType() noexcept;
         [[nodiscard]] Node_Result parseVariable() noexcept;
 
-        [[nodiscard]] std::expected<std::vector<Node>, Error> operator()();
-        void display_syntax_tree(const std::vector<Node>&) const noexcept;
+        [[nodiscard]] std::vector<std::size_t> topLevelItems() const;
+        [[nodiscard]] std::expected<Ast, Error> operator()();
+        [[nodiscard]] std::expected<Ast, Error> operator()(std::size_t jobs);
+        [[nodiscard]] SourceSpan itemSpan(std::size_t, std::size_t) const;
+        [[nodiscard]] std::expected<ParseSnapshot, Error>
+        reparse(ParseSnapshot, std::optional<TextEdit> = std::nullopt);
+        static void display_syntax_tree(const Ast&) noexcept;
     };
 
 }  // namespace Winter
@@ -0,0 +1,142 @@
+#include "scan.h"
+
+#include <bit>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+    #define WINTER_SCAN_X86 1
+#endif
+
+namespace Winter {
+    [[nodiscard]] static constexpr bool isWhitespace(char c) noexcept {
+        return c == ' ' || c == '\n' || c == '\t';
+    }
+
+    [[nodiscard]] static std::size_t
+    whitespaceScalar(std::string_view src, std::size_t pos) noexcept {
+        while (pos < src.size() && isWhitespace(src[pos])) { pos++; }
+        return pos;
+    }
+
+    [[nodiscard]] static std::size_t newlineScalar(std::string_view src, std::size_t pos) noexcept {
+        while (pos < src.size() && src[pos] != '\n') { pos++; }
+        return pos;
+    }
+
+#ifdef WINTER_SCAN_X86
+    [[nodiscard]] static std::size_t
+    whitespaceSse2(std::string_view src, std::size_t pos) noexcept {
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i newline = _mm_set1_epi8('\n');
+        const __m128i tab = _mm_set1_epi8('\t');
+
+        while (pos + 16 <= src.size()) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src.data() + pos));
+            const __m128i ws = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, newline)),
+                _mm_cmpeq_epi8(v, tab));
+
+            const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(ws)) ^ 0xFFFFu;
+            if (mask != 0) { return pos + static_cast<std::size_t>(std::countr_zero(mask)); }
+            pos += 16;
+        }
+
+        return whitespaceScalar(src, pos);
+    }
+
+    [[nodiscard]] static std::size_t newlineSse2(std::string_view src, std::size_t pos) noexcept {
+        const __m128i newline = _mm_set1_epi8('\n');
+
+        while (pos + 16 <= src.size()) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src.data() + pos));
+            const auto mask =
+                static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)));
+            if (mask != 0) { return pos + static_cast<std::size_t>(std::countr_zero(mask)); }
+            pos += 16;
+        }
+
+        return newlineScalar(src, pos);
+    }
+
+    [[nodiscard, gnu::target("avx2")]] static std::size_t
+    whitespaceAvx2(std::string_view src, std::size_t pos) noexcept {
+        const __m256i space = _mm256_set1_epi8(' ');
+        const __m256i newline = _mm256_set1_epi8('\n');
+        const __m256i tab = _mm256_set1_epi8('\t');
+
+        while (pos + 32 <= src.size()) {
+            const __m256i v =
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src.data() + pos));
+            const __m256i ws = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, newline)),
+                _mm256_cmpeq_epi8(v, tab));
+
+            const auto mask = ~static_cast<std::uint32_t>(_mm256_movemask_epi8(ws));
+            if (mask != 0) { return pos + static_cast<std::size_t>(std::countr_zero(mask)); }
+            pos += 32;
+        }
+
+        return whitespaceSse2(src, pos);
+    }
+
+    [[nodiscard, gnu::target("avx2")]] static std::size_t
+    newlineAvx2(std::string_view src, std::size_t pos) noexcept {
+        const __m256i newline = _mm256_set1_epi8('\n');
+
+        while (pos + 32 <= src.size()) {
+            const __m256i v =
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src.data() + pos));
+            const auto mask =
+                static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline)));
+            if (mask != 0) { return pos + static_cast<std::size_t>(std::countr_zero(mask)); }
+            pos += 32;
+        }
+
+        return newlineSse2(src, pos);
+    }
+#endif
+
+    static constexpr Scanner scalarScanner = {ScanIsa::scalar, whitespaceScalar, newlineScalar};
+#ifdef WINTER_SCAN_X86
+    static constexpr Scanner sse2Scanner = {ScanIsa::sse2, whitespaceSse2, newlineSse2};
+    static constexpr Scanner avx2Scanner = {ScanIsa::avx2, whitespaceAvx2, newlineAvx2};
+#endif
+
+    [[nodiscard]] bool scanIsaSupported(ScanIsa isa) noexcept {
+        switch (isa) {
+            case ScanIsa::scalar: return true;
+#ifdef WINTER_SCAN_X86
+            case ScanIsa::sse2: return __builtin_cpu_supports("sse2");
+            case ScanIsa::avx2: return __builtin_cpu_supports("avx2");
+#else
+            case ScanIsa::sse2: return false;
+            case ScanIsa::avx2: return false;
+#endif
+        }
+        return false;
+    }
+
+    [[nodiscard]] const Scanner& scanner(ScanIsa isa) noexcept {
+        if (!scanIsaSupported(isa)) { return scalarScanner; }
+
+        switch (isa) {
+            case ScanIsa::scalar: return scalarScanner;
+#ifdef WINTER_SCAN_X86
+            case ScanIsa::sse2: return sse2Scanner;
+            case ScanIsa::avx2: return avx2Scanner;
+#else
+            default: break;
+#endif
+        }
+        return scalarScanner;
+    }
+
+    [[nodiscard]] const Scanner& scanner() noexcept {
+        static const Scanner& best = []() -> const Scanner& {
+            if (scanIsaSupported(ScanIsa::avx2)) { return scanner(ScanIsa::avx2); }
+            if (scanIsaSupported(ScanIsa::sse2)) { return scanner(ScanIsa::sse2); }
+            return scalarScanner;
+        }();
+        return best;
+    }
+}  // namespace Winter
@@ -0,0 +1,53 @@
+#ifndef WINTER_SCAN_H
+#define WINTER_SCAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <string_view>
+
+namespace Winter {
+    enum class ScanIsa : std::uint8_t {
+        scalar,
+        sse2,
+        avx2
+    };
+
+    // Byte classifiers used by the lexer's hot loops. Each takes the source and a
+    // starting offset and returns the offset of the first match, or `src.size()`
+    struct Scanner {
+        ScanIsa isa;
+        // first byte that is not ' ', '\t' or '\n'
+        std::size_t (*whitespace)(std::string_view, std::size_t) noexcept;
+        // first '\n'
+        std::size_t (*newline)(std::string_view, std::size_t) noexcept;
+    };
+
+    // The fastest implementation supported by the running CPU, selected once
+    [[nodiscard]] const Scanner& scanner() noexcept;
+    // A specific implementation, falling back to scalar if the CPU doesn't support it
+    [[nodiscard]] const Scanner& scanner(ScanIsa) noexcept;
+    [[nodiscard]] bool scanIsaSupported(ScanIsa) noexcept;
+}  // namespace Winter
+
+template <>
+struct std::formatter<Winter::ScanIsa> {
+    constexpr auto parse(std::format_parse_context& ctx) {
+        auto it = ctx.begin();
+        if (it != ctx.end() && *it != '}') {
+            throw std::format_error("Invalid format specifier for ScanIsa");
+        }
+        return it;
+    }
+
+    auto format(Winter::ScanIsa isa, std::format_context& ctx) const {
+        switch (isa) {
+            case Winter::ScanIsa::scalar: return std::format_to(ctx.out(), "scalar");
+            case Winter::ScanIsa::sse2:   return std::format_to(ctx.out(), "sse2");
+            case Winter::ScanIsa::avx2:   return std::format_to(ctx.out(), "avx2");
+        }
+        return std::format_to(ctx.out(), "");
+    }
+};
+
+#endif  // WINTER_SCAN_H
@@ -0,0 +1,524 @@
+#include "sema.h"
+
+#include <format>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+#include "lexer.h"
+#include "walk.h"
+
+namespace Winter {
+    [[nodiscard]] static constexpr bool isInteger(BuiltinType t) noexcept {
+        return (BuiltinType::i8 <= t && t <= BuiltinType::u64) || t == BuiltinType::intLiteral;
+    }
+
+    [[nodiscard]] static constexpr bool isNumeric(BuiltinType t) noexcept {
+        return isInteger(t) || t == BuiltinType::f32 || t == BuiltinType::f64 ||
+               t == BuiltinType::floatLiteral;
+    }
+
+    [[nodiscard]] static constexpr bool isLiteral(DeclId type) noexcept {
+        return type == builtinDecl(BuiltinType::intLiteral) ||
+               type == builtinDecl(BuiltinType::floatLiteral);
+    }
+
+    // What a literal nothing else settles becomes: i32 or f64
+    [[nodiscard]] static constexpr DeclId defaultType(DeclId type) noexcept {
+        if (type == builtinDecl(BuiltinType::intLiteral)) { return builtinDecl(BuiltinType::i32); }
+        if (type == builtinDecl(BuiltinType::floatLiteral)) {
+            return builtinDecl(BuiltinType::f64);
+        }
+        return type;
+    }
+
+    [[nodiscard]] DeclId Sema::lookup(ScopeId scope, Symbol name) const {
+        while (true) {
+            const Scope& s = scopes[scope];
+            if (auto found = s.names.find(name); found != s.names.end()) { return found->second; }
+            if (scope == globalScope) { return 0; }
+            scope = s.parent;
+        }
+    }
+
+    // Walks the tree once, keeping the scope it is in. Top-level names are declared up
+    // front so items can refer to each other in any order; everything else is declared
+    // where it appears. Hooks record the first error and stop the walk
+    struct Analyzer {
+        const Ast& ast;
+        Sema& sema;
+        ScopeId scope = Sema::globalScope;
+        std::vector<DeclId> returnTypes = {};  // of the functions being walked, innermost last
+        std::optional<Error> error = std::nullopt;
+
+        WalkAction fail(std::string msg) {
+            error = Error(ErrType::Sema, std::move(msg));
+            return WalkAction::Stop;
+        }
+
+        [[nodiscard]] std::string_view typeName(DeclId type) const {
+            return type == 0 ? "unknown"sv : sema[type].name.str();
+        }
+
+        void enterScope() {
+            sema.scopes.push_back(Scope(scope));
+            scope = static_cast<ScopeId>(sema.scopes.size() - 1);
+        }
+
+        void leaveScope() { scope = sema.scopes[scope].parent; }
+
+        [[nodiscard]] std::expected<DeclId, Error> declare(Decl decl) {
+            const auto id = static_cast<DeclId>(sema.decls.size());
+            if (!sema.scopes[scope].names.try_emplace(decl.name, id).second) {
+                return std::unexpected(
+                    Error(ErrType::Sema, std::format("Redeclaration of '{}'", decl.name)));
+            }
+            sema.decls.push_back(decl);
+            if (decl.node != Decl::noNode) { sema.resolved[decl.node] = id; }
+            return id;
+        }
+
+        // The type `name` stands for, with aliases followed to what they name
+        [[nodiscard]] std::expected<DeclId, Error> resolveType(Symbol name) const {
+            const DeclId id = sema.lookup(scope, name);
+            if (id == 0) {
+                return std::unexpected(
+                    Error(ErrType::Sema, std::format("Unknown type '{}'", name)));
+            }
+            if (sema[id].kind != DeclKind::type) {
+                return std::unexpected(
+                    Error(ErrType::Sema, std::format("'{}' is not a type", name)));
+            }
+            return sema[id].type != 0 ? sema[id].type : id;
+        }
+
+        // Whether a value of type `from` can be stored where `to` is expected. Unknown
+        // types are let through, as the checks they need are not written yet
+        [[nodiscard]] bool assignable(DeclId to, DeclId from) const {
+            if (to == 0 || from == 0 || to == from) { return true; }
+            if (from == builtinDecl(BuiltinType::intLiteral)) {
+                return isNumeric(sema.builtinOf(to));
+            }
+            if (from == builtinDecl(BuiltinType::floatLiteral)) {
+                const BuiltinType t = sema.builtinOf(to);
+                return t == BuiltinType::f32 || t == BuiltinType::f64;
+            }
+            return false;
+        }
+
+        // The common type of two operands, or an error if there isn't one
+        [[nodiscard]] std::expected<DeclId, Error> unify(DeclId lhs, DeclId rhs) const {
+            if (lhs == 0 || rhs == 0) { return 0; }
+            if (assignable(lhs, rhs)) { return lhs; }
+            if (assignable(rhs, lhs)) { return rhs; }
+            return std::unexpected(Error(
+                ErrType::Sema,
+                std::format("Mismatched types: {} and {}", typeName(lhs), typeName(rhs))));
+        }
+
+        // Give a value of a literal type the concrete type `to`, along with the literals it
+        // is computed from, so codegen knows how wide each one is
+        void settle(NodeId id, DeclId to) {
+            if (to == 0 || isLiteral(to) || !isLiteral(sema.typeOf(id))) { return; }
+            sema.types[id] = to;
+            if (std::holds_alternative<exprNode>(ast[id].data)) {
+                for (NodeId operand : ast.children(id)) { settle(operand, to); }
+            }
+        }
+
+        WalkAction checkAssign(DeclId to, NodeId value) {
+            const DeclId from = sema.typeOf(value);
+            if (assignable(to, from)) {
+                settle(value, to);
+                return WalkAction::Continue;
+            }
+            return fail(std::format(
+                "Mismatched types: expected {}, found {}", typeName(to), typeName(from)));
+        }
+
+        WalkAction declareLet(NodeId id, const letNode& let) {
+            if (sema.declOf(id) != 0) { return WalkAction::Continue; }
+
+            Decl decl = {DeclKind::variable, let.name, id};
+            decl.isConst = let.isConst;
+            if (let.isFunc) {
+                const auto& fn = std::get<funcNode>(ast.child(id, 0).data);
+                std::expected<DeclId, Error> ret = resolveType(fn.retType);
+                if (!ret.has_value()) { return fail(ret.error().msg); }
+                decl.kind = DeclKind::function;
+                decl.type = ret.value();
+            }
+
+            std::expected<DeclId, Error> declared = declare(decl);
+            if (!declared.has_value()) { return fail(declared.error().msg); }
+            return WalkAction::Continue;
+        }
+
+        WalkAction declareVar(NodeId id, const varNode& var) {
+            if (sema.declOf(id) != 0) { return WalkAction::Continue; }
+
+            std::expected<DeclId, Error> type = resolveType(var.type);
+            if (!type.has_value()) { return fail(type.error().msg); }
+
+            Decl decl = {DeclKind::variable, var.name, id, type.value()};
+            decl.isConst = var.isConst;
+            std::expected<DeclId, Error> declared = declare(decl);
+            if (!declared.has_value()) { return fail(declared.error().msg); }
+            return WalkAction::Continue;
+        }
+
+        WalkAction declareAlias(NodeId id, const aliasNode& alias) {
+            Decl decl = {DeclKind::type, alias.ident, id};
+            if (const auto* target = std::get_if<typeAlias>(&ast.child(id, 0).data)) {
+                std::expected<DeclId, Error> type = resolveType(target->type);
+                if (!type.has_value()) { return fail(type.error().msg); }
+                decl.type = type.value();
+                decl.builtin = sema.builtinOf(type.value());
+            }
+
+            std::expected<DeclId, Error> declared = declare(decl);
+            if (!declared.has_value()) { return fail(declared.error().msg); }
+            return WalkAction::Continue;
+        }
+
+        // Types and modules first, as declaring a function or variable resolves its type
+        WalkAction declareTopLevel() {
+            for (NodeId root : ast.roots) {
+                WalkAction action = WalkAction::Continue;
+                if (const auto* alias = std::get_if<aliasNode>(&ast[root].data)) {
+                    action = declareAlias(root, *alias);
+                } else if (const auto* mod = std::get_if<modNode>(&ast[root].data)) {
+                    std::expected<DeclId, Error> declared =
+                        declare(Decl(DeclKind::module, mod->name, root));
+                    if (!declared.has_value()) { action = fail(declared.error().msg); }
+                }
+                if (action == WalkAction::Stop) { return action; }
+            }
+
+            for (NodeId root : ast.roots) {
+                WalkAction action = WalkAction::Continue;
+                if (const auto* let = std::get_if<letNode>(&ast[root].data)) {
+                    action = declareLet(root, *let);
+                } else if (const auto* var = std::get_if<varNode>(&ast[root].data)) {
+                    action = declareVar(root, *var);
+                }
+                if (action == WalkAction::Stop) { return action; }
+            }
+            return WalkAction::Continue;
+        }
+
+        // Declarations
+
+        WalkAction pre(WalkPos pos, const aliasNode& alias) {
+            if (sema.declOf(pos.id) != 0) { return WalkAction::Continue; }
+            return declareAlias(pos.id, alias);
+        }
+
+        WalkAction pre(WalkPos pos, const letNode& let) { return declareLet(pos.id, let); }
+
+        // The initializer is checked before the name is declared, so it can't use it
+        WalkAction post(WalkPos pos, const varNode& var) {
+            if (declareVar(pos.id, var) == WalkAction::Stop) { return WalkAction::Stop; }
+            if (var.childCount == 0) { return WalkAction::Continue; }
+            return checkAssign(sema[sema.declOf(pos.id)].type, ast.childId(pos.id, 0));
+        }
+
+        WalkAction pre(WalkPos pos, const funcNode& fn) {
+            std::expected<DeclId, Error> ret = resolveType(fn.retType);
+            if (!ret.has_value()) { return fail(ret.error().msg); }
+
+            // interface methods are named by the funcNode itself
+            if (!fn.name.empty() && sema.declOf(pos.id) == 0) {
+                std::expected<DeclId, Error> declared =
+                    declare(Decl(DeclKind::function, fn.name, pos.id, ret.value()));
+                if (!declared.has_value()) { return fail(declared.error().msg); }
+            }
+
+            returnTypes.push_back(ret.value());
+            enterScope();
+            return WalkAction::Continue;
+        }
+
+        void post(WalkPos, const funcNode&) {
+            leaveScope();
+            returnTypes.pop_back();
+        }
+
+        WalkAction pre(WalkPos pos, const paramNode& param) {
+            std::expected<DeclId, Error> type = resolveType(param.type);
+            if (!type.has_value()) { return fail(type.error().msg); }
+
+            std::expected<DeclId, Error> declared =
+                declare(Decl(DeclKind::parameter, param.name, pos.id, type.value()));
+            if (!declared.has_value()) { return fail(declared.error().msg); }
+            return WalkAction::Continue;
+        }
+
+        // Enum values are declared in the enclosing scope, as the tree doesn't keep the
+        // enum's own name
+        WalkAction pre(WalkPos pos, const enumNode&) {
+            for (NodeId value : ast.children(pos.id)) {
+                const Symbol name = std::get<identNode>(ast[value].data).value;
+                std::expected<DeclId, Error> declared =
+                    declare(Decl(DeclKind::enumValue, name, value));
+                if (!declared.has_value()) { return fail(declared.error().msg); }
+            }
+            return WalkAction::SkipChildren;
+        }
+
+        void pre(WalkPos, const classNode&) {
+            enterScope();
+            const auto id = static_cast<DeclId>(sema.decls.size());
+            sema.scopes[scope].names.emplace(intern("this"), id);
+            sema.decls.push_back(Decl(DeclKind::variable, intern("this")));
+        }
+
+        void post(WalkPos, const classNode&) { leaveScope(); }
+        void pre(WalkPos, const interfaceNode&) { enterScope(); }
+        void post(WalkPos, const interfaceNode&) { leaveScope(); }
+        void pre(WalkPos, const bodyNode&) { enterScope(); }
+        void post(WalkPos, const bodyNode&) { leaveScope(); }
+
+        // A foreach loop declares its first identifier rather than naming it
+        WalkAction pre(WalkPos pos, const forNode&) {
+            enterScope();
+            const NodeId first = ast.childId(pos.id, 0);
+            if (const auto* ident = std::get_if<identNode>(&ast[first].data)) {
+                std::expected<DeclId, Error> declared =
+                    declare(Decl(DeclKind::variable, ident->value, first));
+                if (!declared.has_value()) { return fail(declared.error().msg); }
+            }
+            return WalkAction::Continue;
+        }
+
+        void post(WalkPos, const forNode&) { leaveScope(); }
+
+        // Each identifier of a function alias is a type
+        WalkAction pre(WalkPos pos, const funcAlias&) {
+            for (NodeId type : ast.children(pos.id)) {
+                std::expected<DeclId, Error> resolved =
+                    resolveType(std::get<identNode>(ast[type].data).value);
+                if (!resolved.has_value()) { return fail(resolved.error().msg); }
+                sema.resolved[type] = resolved.value();
+            }
+            return WalkAction::SkipChildren;
+        }
+
+        // References
+
+        WalkAction pre(WalkPos pos, const identNode& ident) {
+            if (sema.declOf(pos.id) != 0) { return WalkAction::Continue; }
+
+            const DeclId id = sema.lookup(scope, ident.value);
+            if (id == 0) { return fail(std::format("Undeclared identifier '{}'", ident.value)); }
+            sema.resolved[pos.id] = id;
+            if (sema[id].kind == DeclKind::variable || sema[id].kind == DeclKind::parameter) {
+                sema.types[pos.id] = sema[id].type;
+            }
+            return WalkAction::Continue;
+        }
+
+        WalkAction pre(WalkPos pos, const funcCallNode& call) {
+            const DeclId id = sema.lookup(scope, call.name);
+            if (id == 0) { return fail(std::format("Undeclared function '{}'", call.name)); }
+            if (sema[id].kind != DeclKind::function) {
+                return fail(std::format("'{}' is not a function", call.name));
+            }
+            sema.resolved[pos.id] = id;
+            sema.types[pos.id] = sema[id].type;
+            return WalkAction::Continue;
+        }
+
+        // An argument is a literal or the name of a variable
+        WalkAction pre(WalkPos pos, const argNode& arg) {
+            if (arg.num.has_value()) {
+                sema.types[pos.id] = builtinDecl(
+                    arg.num.value().isInteger() ? BuiltinType::intLiteral
+                                                : BuiltinType::floatLiteral);
+            } else if (arg.ch.has_value()) {
+                sema.types[pos.id] = builtinDecl(BuiltinType::character);
+            } else if (arg.str.has_value() && arg.str.value().str().starts_with('"')) {
+                sema.types[pos.id] = builtinDecl(BuiltinType::string);
+            } else if (arg.str.has_value()) {
+                const DeclId id = sema.lookup(scope, arg.str.value());
+                if (id == 0) {
+                    return fail(std::format("Undeclared identifier '{}'", arg.str.value()));
+                }
+                sema.resolved[pos.id] = id;
+                sema.types[pos.id] = sema[id].type;
+            }
+            return WalkAction::Continue;
+        }
+
+        WalkAction pre(WalkPos, const switchNode& sw) {
+            if (sema.lookup(scope, sw.ident) == 0) {
+                return fail(std::format("Undeclared identifier '{}'", sw.ident));
+            }
+            return WalkAction::Continue;
+        }
+
+        // Types of values
+
+        void pre(WalkPos pos, const numlitNode& num) {
+            sema.types[pos.id] = builtinDecl(
+                num.value.isInteger() ? BuiltinType::intLiteral : BuiltinType::floatLiteral);
+        }
+
+        void pre(WalkPos pos, const boolNode&) {
+            sema.types[pos.id] = builtinDecl(BuiltinType::boolean);
+        }
+
+        void pre(WalkPos pos, const charLitNode&) {
+            sema.types[pos.id] = builtinDecl(BuiltinType::character);
+        }
+
+        void pre(WalkPos pos, const strLitNode&) {
+            sema.types[pos.id] = builtinDecl(BuiltinType::string);
+        }
+
+        // Only the object of a member access is looked up: the member is found through
+        // its type, which isn't tracked yet
+        WalkAction pre(WalkPos pos, const exprNode& expr) {
+            if (expr.op != TokenType::dot) { return WalkAction::Continue; }
+            if (!walk(ast, ast.childId(pos.id, 0), *this, pos.depth + 1)) {
+                return WalkAction::Stop;
+            }
+            return WalkAction::SkipChildren;
+        }
+
+        WalkAction post(WalkPos pos, const exprNode& expr) {
+            if (!expr.op.has_value() || expr.op == TokenType::dot) {
+                return WalkAction::Continue;
+            }
+            const std::span<const NodeId> operands = ast.children(pos.id);
+            const TokenType op = expr.op.value();
+
+            const DeclId lhs = sema.typeOf(operands[0]);
+            if (operands.size() == 1) {
+                const BuiltinType t = sema.builtinOf(lhs);
+                const bool ok = lhs == 0 ||
+                                (op == TokenType::op_not ? t == BuiltinType::boolean
+                                                         : isNumeric(t));
+                if (!ok) { return invalidOperand(op, lhs); }
+                const bool mutates = op == TokenType::plus_plus || op == TokenType::minus_minus;
+                if (mutates && checkMutable(operands[0]) == WalkAction::Stop) {
+                    return WalkAction::Stop;
+                }
+                sema.types[pos.id] = lhs;
+                return WalkAction::Continue;
+            }
+
+            const DeclId rhs = sema.typeOf(operands[1]);
+            if (op == TokenType::op_equal) {
+                if (checkMutable(operands[0]) == WalkAction::Stop) { return WalkAction::Stop; }
+                sema.types[pos.id] = lhs;
+                return checkAssign(lhs, operands[1]);
+            }
+
+            std::expected<DeclId, Error> common = unify(lhs, rhs);
+            if (!common.has_value()) { return fail(common.error().msg); }
+            // The result of arithmetic on two literals is still a literal, settled by
+            // whatever it is used for. A comparison is the last use of its operands
+            const bool arithmetic = op == TokenType::plus || op == TokenType::minus ||
+                                    op == TokenType::star || op == TokenType::slash;
+            const DeclId operandType = arithmetic ? common.value() : defaultType(common.value());
+            settle(operands[0], operandType);
+            settle(operands[1], operandType);
+            const BuiltinType t = sema.builtinOf(common.value());
+            auto expect = [&](bool ok) {
+                if (ok || common.value() == 0) { return WalkAction::Continue; }
+                return invalidOperand(op, common.value());
+            };
+
+            switch (op) {
+                case TokenType::plus:
+                case TokenType::minus:
+                case TokenType::star:
+                case TokenType::slash:
+                    sema.types[pos.id] = common.value();
+                    return expect(isNumeric(t));
+                case TokenType::dot_dot:
+                    sema.types[pos.id] = builtinDecl(BuiltinType::string);
+                    return expect(t == BuiltinType::string);
+                case TokenType::op_greater:
+                case TokenType::op_greater_eq:
+                case TokenType::op_less:
+                case TokenType::op_less_eq:
+                    sema.types[pos.id] = builtinDecl(BuiltinType::boolean);
+                    return expect(isNumeric(t) || t == BuiltinType::character);
+                case TokenType::op_equal_eq:
+                case TokenType::op_not_eq:
+                    sema.types[pos.id] = builtinDecl(BuiltinType::boolean);
+                    return WalkAction::Continue;
+                case TokenType::op_and:
+                case TokenType::op_or:
+                    sema.types[pos.id] = builtinDecl(BuiltinType::boolean);
+                    return expect(t == BuiltinType::boolean);
+                default: return WalkAction::Continue;
+            }
+        }
+
+        WalkAction invalidOperand(TokenType op, DeclId type) {
+            return fail(std::format("Invalid operand type for {}: {}", op, typeName(type)));
+        }
+
+        WalkAction checkMutable(NodeId target) {
+            const DeclId id = sema.declOf(target);
+            if (id != 0 && sema[id].isConst) {
+                return fail(std::format("Cannot assign to constant '{}'", sema[id].name));
+            }
+            return WalkAction::Continue;
+        }
+
+        WalkAction post(WalkPos pos, const returnNode&) {
+            if (returnTypes.empty() || ast.children(pos.id).empty()) {
+                return WalkAction::Continue;
+            }
+            return checkAssign(returnTypes.back(), ast.childId(pos.id, 0));
+        }
+    };
+
+    // Run after `Analyzer`, parents first, so a literal expression nothing gave a type to
+    // settles as a whole rather than one operand at a time
+    struct LiteralDefaults {
+        Analyzer& analyzer;
+
+        void pre(WalkPos pos, const auto&) {
+            analyzer.settle(pos.id, defaultType(analyzer.sema.typeOf(pos.id)));
+        }
+    };
+
+    [[nodiscard]] std::expected<Sema, Error> analyze(const Ast& ast) {
+        Sema sema = {};
+        sema.scopes.push_back(Scope(Sema::globalScope));
+        sema.resolved.resize(ast.size(), 0);
+        sema.types.resize(ast.size(), 0);
+
+        sema.decls.push_back(Decl());
+        for (auto t = BuiltinType::i8; t != BuiltinType::count;
+             t = static_cast<BuiltinType>(static_cast<int>(t) + 1)) {
+            Decl decl = {DeclKind::type, intern(builtinName(t))};
+            decl.builtin = t;
+            if (t != BuiltinType::intLiteral && t != BuiltinType::floatLiteral) {
+                sema.scopes[Sema::globalScope].names.emplace(decl.name, builtinDecl(t));
+            }
+            sema.decls.push_back(decl);
+        }
+
+        // not a part of the language yet, but every example calls it
+        Decl print = {DeclKind::function, intern("print")};
+        print.type = builtinDecl(BuiltinType::void_);
+        sema.scopes[Sema::globalScope].names.emplace(print.name, sema.decls.size());
+        sema.decls.push_back(print);
+
+        Analyzer analyzer = {ast, sema};
+        if (analyzer.declareTopLevel() == WalkAction::Stop || !walk(ast, analyzer)) {
+            return std::unexpected(analyzer.error.value());
+        }
+
+        LiteralDefaults defaults = {analyzer};
+        walk(ast, defaults);
+        return sema;
+    }
+}  // namespace Winter
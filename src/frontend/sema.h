@@ -0,0 +1,127 @@
+#ifndef WINTER_SEMA_H
+#define WINTER_SEMA_H
+
+#include <cstdint>
+#include <expected>
+#include <limits>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../error.h"
+#include "ast.h"
+#include "intern.h"
+
+namespace Winter {
+    using namespace std::literals::string_view_literals;
+
+    // Index of a declaration in `Sema::decls`. 0 is no declaration, or a type that
+    // isn't known
+    using DeclId = std::uint32_t;
+    using ScopeId = std::uint32_t;
+
+    // Types the language provides. The first decls of every `Sema` are these, in this
+    // order, so the decl of a builtin type is its enum value
+    enum class BuiltinType : std::uint8_t {
+        none,
+        i8,
+        i16,
+        i32,
+        i64,
+        u8,
+        u16,
+        u32,
+        u64,
+        f32,
+        f64,
+        boolean,
+        character,
+        string,
+        void_,
+        intLiteral,    // an integer literal, until it meets a concrete numeric type
+        floatLiteral,  // likewise for floats
+
+        count
+    };
+
+    [[nodiscard]] constexpr DeclId builtinDecl(BuiltinType type) noexcept {
+        return static_cast<DeclId>(type);
+    }
+
+    // The literal types can't be written, so their names are ones no identifier can match
+    [[nodiscard]] constexpr std::string_view builtinName(BuiltinType t) noexcept {
+        switch (t) {
+            case BuiltinType::i8:           return "i8"sv;
+            case BuiltinType::i16:          return "i16"sv;
+            case BuiltinType::i32:          return "i32"sv;
+            case BuiltinType::i64:          return "i64"sv;
+            case BuiltinType::u8:           return "u8"sv;
+            case BuiltinType::u16:          return "u16"sv;
+            case BuiltinType::u32:          return "u32"sv;
+            case BuiltinType::u64:          return "u64"sv;
+            case BuiltinType::f32:          return "f32"sv;
+            case BuiltinType::f64:          return "f64"sv;
+            case BuiltinType::boolean:      return "bool"sv;
+            case BuiltinType::character:    return "char"sv;
+            case BuiltinType::string:       return "String"sv;
+            case BuiltinType::void_:        return "void"sv;
+            case BuiltinType::intLiteral:   return "{integer}"sv;
+            case BuiltinType::floatLiteral: return "{float}"sv;
+            case BuiltinType::none:
+            case BuiltinType::count:        return ""sv;
+        }
+        return ""sv;
+    }
+
+    enum class DeclKind : std::uint8_t {
+        none,
+        type,
+        module,
+        function,
+        variable,
+        parameter,
+        enumValue,
+    };
+
+    struct Decl {
+        DeclKind kind = DeclKind::none;
+        Symbol name = {};
+        NodeId node = noNode;  // declaring node, `noNode` for builtins
+        DeclId type = 0;       // type of a value, return type of a function, or target of an alias
+        BuiltinType builtin = BuiltinType::none;  // of a type, through any aliases
+        bool isConst = false;
+
+        static constexpr NodeId noNode = std::numeric_limits<NodeId>::max();
+    };
+
+    struct Scope {
+        ScopeId parent;
+        std::unordered_map<Symbol, DeclId> names = {};
+    };
+
+    // What semantic analysis learned about a tree, kept in tables beside it rather than
+    // in its nodes. Names are resolved once here, so later passes look things up by id
+    struct Sema {
+        static constexpr ScopeId globalScope = 0;
+
+        std::vector<Decl> decls = {};
+        std::vector<Scope> scopes = {};
+        std::vector<DeclId> resolved = {};  // by NodeId: what the node declares or names
+        std::vector<DeclId> types = {};     // by NodeId: type of a value node
+
+        // Search `scope` and then each enclosing scope. 0 if the name isn't declared
+        [[nodiscard]] DeclId lookup(ScopeId scope, Symbol name) const;
+
+        [[nodiscard]] const Decl& operator[](DeclId id) const { return decls[id]; }
+        [[nodiscard]] DeclId declOf(NodeId id) const { return resolved[id]; }
+        [[nodiscard]] DeclId typeOf(NodeId id) const { return types[id]; }
+        [[nodiscard]] BuiltinType builtinOf(DeclId type) const { return decls[type].builtin; }
+    };
+
+    // Build the scopes of `ast`, resolve every name and type in it, and check the types
+    // of expressions, initializers and returns. Every literal ends up with the concrete
+    // type it is used as, i32 or f64 where nothing decides. Stops at the first error
+    [[nodiscard]] std::expected<Sema, Error> analyze(const Ast&);
+}  // namespace Winter
+
+#endif  // WINTER_SEMA_H
@@ -0,0 +1,115 @@
+#ifndef WINTER_WALK_H
+#define WINTER_WALK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <variant>
+
+#include "ast.h"
+
+namespace Winter {
+    enum class WalkAction : std::uint8_t {
+        Continue,
+        SkipChildren,  // from `pre` only: go straight to this node's `post`
+        Stop,          // end the whole walk, skipping every remaining hook
+    };
+
+    // The node a hook is called for, and how many ancestors it has below the walk's root
+    struct WalkPos {
+        NodeId id;
+        std::size_t depth;
+    };
+
+    // Run a hook, treating one that returns nothing as `Continue`
+    template <typename Fn>
+    [[nodiscard]] constexpr WalkAction walkAction(Fn&& hook) {
+        if constexpr (std::is_void_v<std::invoke_result_t<Fn>>) {
+            hook();
+            return WalkAction::Continue;
+        } else {
+            return hook();
+        }
+    }
+
+    // Call the visitor's hook for this node's payload type, if it has one
+    template <typename Visitor>
+    [[nodiscard]] WalkAction walkPre(Visitor& visitor, const Node& node, WalkPos pos) {
+        return std::visit(
+            [&visitor, pos](const auto& payload) {
+                if constexpr (requires { visitor.pre(pos, payload); }) {
+                    return walkAction([&] { return visitor.pre(pos, payload); });
+                } else {
+                    return WalkAction::Continue;
+                }
+            },
+            node.data);
+    }
+
+    // As above, once the node's subtree is done
+    template <typename Visitor>
+    [[nodiscard]] WalkAction walkPost(Visitor& visitor, const Node& node, WalkPos pos) {
+        return std::visit(
+            [&visitor, pos](const auto& payload) {
+                if constexpr (requires { visitor.post(pos, payload); }) {
+                    return walkAction([&] { return visitor.post(pos, payload); });
+                } else {
+                    return WalkAction::Continue;
+                }
+            },
+            node.data);
+    }
+
+    // Depth-first walk of an `Ast`. A visitor is any type with hooks named `pre` and
+    // `post`, called before and after a node's subtree, taking `(WalkPos, const T&)` for
+    // the payload types it cares about:
+    //
+    //     struct CountCalls {
+    //         std::size_t calls = 0;
+    //         void pre(WalkPos, const funcCallNode&) { calls++; }
+    //     };
+    //
+    // A hook taking `const auto&` catches every payload without a hook of its own. Hooks
+    // return `WalkAction` or nothing, which continues. Which hook runs is chosen at
+    // compile time from the payload type, so there is no virtual dispatch and nodes are
+    // never copied. A funcNode's parameters are walked ahead of its children.
+    //
+    // Children are looked up by index as the walk reaches them, so hooks may add nodes or
+    // overwrite the node they are called for, as long as existing child ranges are kept.
+    // Returns false if a hook stopped the walk
+    template <typename Visitor>
+    bool walk(const Ast& ast, NodeId root, Visitor& visitor, std::size_t depth = 0) {
+        const WalkPos pos = {root, depth};
+        const WalkAction action = walkPre(visitor, ast[root], pos);
+        if (action == WalkAction::Stop) { return false; }
+
+        if (action == WalkAction::Continue) {
+            auto walkRange = [&](NodeRange range) {
+                for (std::uint32_t i = 0; i < range.count; i++) {
+                    if (!walk(ast, ast.edges[range.first + i], visitor, depth + 1)) {
+                        return false;
+                    }
+                }
+                return true;
+            };
+
+            if (const auto* fn = std::get_if<funcNode>(&ast[root].data)) {
+                if (!walkRange(fn->parameters)) { return false; }
+            }
+            if (!walkRange(ast[root].children)) { return false; }
+        }
+
+        return walkPost(visitor, ast[root], pos) != WalkAction::Stop;
+    }
+
+    // Walk every top-level item, in source order
+    template <typename Visitor>
+    bool walk(const Ast& ast, Visitor& visitor) {
+        for (std::size_t i = 0; i < ast.roots.size(); i++) {
+            if (!walk(ast, ast.roots[i], visitor)) { return false; }
+        }
+        return true;
+    }
+}  // namespace Winter
+
+#endif  // WINTER_WALK_H
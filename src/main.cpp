@@ -1,19 +1,25 @@
-#include <fstream>
+#include <algorithm>
+#include <charconv>
+#include <format>
 #include <memory>
 #include <optional>
 #include <print>
 #include <span>
-#include <sstream>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 
 #include <llvm/IR/Module.h>
 
 #include "backend/backend.h"
 #include "error.h"
+#include "frontend/cache.h"
+#include "frontend/fold.h"
 #include "frontend/lexer.h"
 #include "frontend/parser.h"
+#include "frontend/sema.h"
+#include "source.h"
 
 using namespace std::literals::string_view_literals;
 
@@ -21,10 +27,24 @@ using namespace std::literals::string_view_literals;
     const std::string usage =
         "Usage:\n"
         "    winter [options] [file...]\n"
+        "    winter run [options] [file]\n"
+        "\n"
+        "   `run` compiles in memory and calls `main` straight away, exiting with its result\n"
+        "   Otherwise `foo.wtx` is linked into `foo`, in the working directory\n"
         "\n"
         "   Options:\n"
+        "   -               read the source file from stdin\n"
         "   -D              enable debug mode and print debug info at each stage\n"
-        "   --emit-llvm     emit llvm bytecode to `output.bc` instead of linking\n";
+        "   -j[N]           parse on N threads, or one per core if N is omitted\n"
+        "   -O0 .. -O3, -Os optimization level, -O0 if not given\n"
+        "   --codegen-threads=N\n"
+        "                   split the module into N parts and generate code for each on\n"
+        "                   its own thread\n"
+        "   --ast-cache=DIR reuse parsed trees of unchanged files, cached in DIR\n"
+        "   --target=TRIPLE generate code for TRIPLE rather than this machine, which\n"
+        "                   needs --emit-llvm unless TRIPLE is this machine's\n"
+        "   --emit-llvm     write llvm bitcode to `foo.bc` instead of linking\n"
+        "   --save-temps    also write the optimized IR and object, named after the input\n";
     "";
 
     std::println("{}", usage);
@@ -37,75 +57,157 @@ using namespace std::literals::string_view_literals;
     return 1;
 }
 
-[[nodiscard]] std::string getSourceCode(std::string_view path) {
-    std::ifstream ifs(path.data());
-    std::stringstream buf_stream;
-    buf_stream << ifs.rdbuf();
-    return buf_stream.str();
-}
+struct Options {
+    bool debug = false;
+    bool emitLlvm = false;
+    bool saveTemps = false;
+    bool run = false;  // JIT and run rather than linking
+    std::size_t jobs = 1;
+    std::size_t codegenThreads = 1;
+    Winter::OptLevel optLevel = Winter::OptLevel::O0;
+    std::string astCache = "";  // empty to always parse
+    std::string target = "";    // empty for the host
+};
 
-[[nodiscard]] int compile(std::string_view file_name, bool dbg, bool emit_llvm) noexcept {
-    std::string src = getSourceCode(file_name);
+// Lex and parse `text`, unless the AST cache already has its tree
+[[nodiscard]] std::expected<Winter::Ast, Winter::Error>
+frontend(std::string_view text, const Options& opts) {
+    const Winter::AstCache cache = {opts.astCache};
+    if (!opts.astCache.empty()) {
+        std::expected<Winter::Ast, Winter::Error> cached = cache.load(text);
+        if (cached.has_value()) { return cached; }
+        if (opts.debug) { std::println("AST cache miss: {}", cached.error().msg); }
+    }
 
-    // Lexer
-    Winter::Lexer L = Winter::Lexer(src);
-    Winter::Token t = Winter::Token::tombstone();
-    if (dbg) {
+    // Lexer -- the parser lexes the whole file up front into its token buffer
+    Winter::Parser P = Winter::Parser(text);
+    if (opts.debug) {
         std::println("=== LEXER ===");
-        while (t.type != Winter::TokenType::eof) {
-            auto ret = L();
-            if (!ret.has_value()) {
-                std::println("ERROR: {}", ret.error().msg);
-                return -1;
-            }
-
-            t = ret.value();
-            std::println("{}", ret.value());
+        for (std::size_t i = 0; i < P.tokens.size(); i++) {
+            const Winter::Token tok = P.tokens.at(i);
+            std::println("IDX: {}, {} ({})", i, tok, P.L.location(tok.start));
         }
+        if (P.lexError.has_value()) { return std::unexpected(P.lexError.value()); }
 
         std::println();
-        Winter::Token::counter = 0;
     }
 
     // Parser
-    Winter::Parser P = Winter::Parser(src);
-    std::expected<std::vector<Winter::Node>, Winter::Error> result = P();
+    std::expected<Winter::Ast, Winter::Error> result = P(opts.jobs);
+    if (!result.has_value() && !P.errors.empty()) {
+        // Report every error of the parse, the last one through the caller like any other
+        auto located = [&P](const Winter::ParseError& err) {
+            return Winter::Error(
+                err.error.type, std::format("{} at {}", err.error.msg, P.L.location(err.offset)));
+        };
+        for (std::size_t i = 0; i + 1 < P.errors.size(); i++) {
+            std::println("ERROR: {}", located(P.errors[i]).msg);
+        }
+        return std::unexpected(located(P.errors.back()));
+    }
+    if (result.has_value() && !opts.astCache.empty()) {
+        // A cache that can't be written only costs the next build time
+        std::optional<Winter::Error> err = cache.store(text, result.value());
+        if (err.has_value()) { std::println("WARNING: {}", err.value().msg); }
+    }
+    return result;
+}
+
+[[nodiscard]] int compile(std::string_view file_name, const Options& opts) noexcept {
+    // The source stays mapped until compilation finishes -- tokens and the lexer view it
+    std::expected<Winter::SourceFile, Winter::Error> src = Winter::SourceFile::open(file_name);
+    if (!src.has_value()) {
+        std::println("ERROR: {}", src.error().msg);
+        return -1;
+    }
+
+    std::expected<Winter::Ast, Winter::Error> result = frontend(src.value().text, opts);
     if (!result.has_value()) {
         std::println("ERROR: {}", result.error().msg);
         return -1;
     }
 
-    if (dbg) { P.display_syntax_tree(result.value()); }
+    std::expected<Winter::Sema, Winter::Error> sema = Winter::analyze(result.value());
+    if (!sema.has_value()) {
+        std::println("ERROR: {}", sema.error().msg);
+        return -1;
+    }
+
+    // Folded at the types analysis settled, which every literal is emitted at
+    std::expected<std::size_t, Winter::Error> folded =
+        Winter::foldConstants(result.value(), sema.value(), Winter::Lexer(src.value().text));
+    if (!folded.has_value()) {
+        std::println("ERROR: {}", folded.error().msg);
+        return -1;
+    }
+
+    if (opts.debug) {
+        std::println("Folded {} constant expressions", folded.value());
+        Winter::Parser::display_syntax_tree(result.value());
+    }
 
     // backend
-    Winter::Backend B = Winter::Backend(file_name);
-    Winter::module_result_t backendRet = B.compileModule(result.value());
+    Winter::Backend B = Winter::Backend(file_name, opts.optLevel);
+    if (!opts.target.empty()) { B.targetTriple = llvm::Triple(opts.target); }
+    if (B.crossCompiling() && !opts.emitLlvm) {
+        std::println(
+            "ERROR: Code for {} can't be linked or run here, use --emit-llvm", opts.target);
+        return -1;
+    }
+    Winter::module_result_t backendRet = B.compileModule(result.value(), sema.value());
     if (!backendRet.has_value()) {
         std::println("ERROR: {}", backendRet.error().msg);
         return -1;
     }
 
-    if (dbg) { B.display_module(backendRet.value()); }
-    if (emit_llvm) {
-        B.emitBitcodeFile(backendRet.value());
+    // Optimized before anything looks at it, so the dump and --emit-llvm show what the
+    // objects are made from
+    std::expected<llvm::TargetMachine*, Winter::Error> prepared =
+        B.prepareModule(backendRet.value());
+    if (!prepared.has_value()) {
+        std::println("ERROR: {}", prepared.error().msg);
+        return -1;
+    }
+
+    if (opts.debug) { B.display_module(backendRet.value()); }
+    if (opts.run) {
+        std::expected<int, Winter::Error> exitCode = B.runModule(backendRet.value());
+        if (!exitCode.has_value()) {
+            std::println("ERROR: {}", exitCode.error().msg);
+            return -1;
+        }
+        return exitCode.value();
+    }
+    if (opts.emitLlvm) {
+        std::optional<Winter::Error> err = B.emitBitcodeFile(backendRet.value());
+        if (err.has_value()) {
+            std::println("ERROR: {}", err.value().msg);
+            return -1;
+        }
         return 0;
     }
 
-    std::expected<std::string, Winter::Error> obj_err = B.outputObjectFile(backendRet.value());
-    if (!obj_err.has_value()) {
-        std::println("ERROR: {}", obj_err.error().msg);
+    std::expected<std::vector<Winter::object_t>, Winter::Error> objects =
+        B.outputObjectFiles(backendRet.value(), opts.codegenThreads);
+    if (!objects.has_value()) {
+        std::println("ERROR: {}", objects.error().msg);
         return -1;
     }
 
-    if (!emit_llvm) {
-        std::vector<const char*> files = {obj_err.value().data()};
-        std::optional<Winter::Error> linkErr = B.linkModules(files);
-        if (linkErr.has_value()) {
-            std::println("ERROR: {}", linkErr.value().msg);
+    if (opts.saveTemps) {
+        std::optional<Winter::Error> err = B.saveTemps(backendRet.value(), objects.value());
+        if (err.has_value()) {
+            std::println("ERROR: {}", err.value().msg);
             return -1;
         }
     }
 
+    std::optional<Winter::Error> linkErr = B.linkModules(objects.value());
+    if (linkErr.has_value()) {
+        std::println("ERROR: {}", linkErr.value().msg);
+        return -1;
+    }
+
     return 0;
 }
 
@@ -113,19 +215,45 @@ int main(int argc, char* argv[]) {
     auto args = std::vector<std::string_view>(
         std::from_range, std::span {argv, static_cast<std::size_t>(argc)});
 
-    bool enable_debug = false;
-    bool emit_llvm = false;
+    Options opts = {};
     std::string file = "";
 
     // TODO: -o flag for binary name
     if (args.size() == 1) { return default_output(); }
+    if (args[1] == "run"sv) { opts.run = true; }
     for (auto&& arg : args) {
-        if (arg == "-D"sv) { enable_debug = true; }
-        if (arg == "--emit-llvm"sv) { emit_llvm = true; }
-        if (arg.ends_with(".wtx"sv)) { file = arg; }
+        if (arg == "-D"sv) { opts.debug = true; }
+        if (arg == "--emit-llvm"sv) { opts.emitLlvm = true; }
+        if (arg == "--save-temps"sv) { opts.saveTemps = true; }
+        if (arg == "-j"sv) { opts.jobs = std::max(1u, std::thread::hardware_concurrency()); }
+        if (arg.starts_with("-j"sv) && arg.size() > 2) {
+            const char* end = arg.data() + arg.size();
+            const auto [ptr, ec] = std::from_chars(arg.data() + 2, end, opts.jobs);
+            if (ec != std::errc() || ptr != end || opts.jobs == 0) { return usage(); }
+        }
+        if (arg.starts_with("-O"sv)) {
+            const std::optional<Winter::OptLevel> level = Winter::parseOptLevel(arg.substr(2));
+            if (!level.has_value()) { return usage(); }
+            opts.optLevel = level.value();
+        }
+        if (arg.starts_with("--codegen-threads="sv)) {
+            const char* end = arg.data() + arg.size();
+            const char* begin = arg.data() + "--codegen-threads="sv.size();
+            const auto [ptr, ec] = std::from_chars(begin, end, opts.codegenThreads);
+            if (ec != std::errc() || ptr != end || opts.codegenThreads == 0) { return usage(); }
+        }
+        if (arg.starts_with("--ast-cache="sv)) {
+            opts.astCache = arg.substr("--ast-cache="sv.size());
+            if (opts.astCache.empty()) { return usage(); }
+        }
+        if (arg.starts_with("--target="sv)) {
+            opts.target = arg.substr("--target="sv.size());
+            if (opts.target.empty()) { return usage(); }
+        }
+        if (arg.ends_with(".wtx"sv) || arg == "-"sv) { file = arg; }
         if (arg == "--help"sv) { return usage(); }
     }
 
     if (file.empty()) { return default_output(); }
-    return compile(file, enable_debug, emit_llvm);
+    return compile(file, opts);
 }
@@ -0,0 +1,92 @@
+#include "source.h"
+
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Winter {
+    SourceFile::SourceFile(SourceFile&& other) noexcept
+        : mapping(std::exchange(other.mapping, nullptr)),
+          mappedLen(std::exchange(other.mappedLen, 0)),
+          buffer(std::move(other.buffer)) {
+        // A short buffer lives inside the string object itself, so re-point the view
+        text = isMapped() ? other.text : std::string_view(buffer);
+        other.text = {};
+    }
+
+    SourceFile& SourceFile::operator=(SourceFile&& other) noexcept {
+        if (this == &other) { return *this; }
+        if (mapping != nullptr) { munmap(mapping, mappedLen); }
+
+        mapping = std::exchange(other.mapping, nullptr);
+        mappedLen = std::exchange(other.mappedLen, 0);
+        buffer = std::move(other.buffer);
+        text = isMapped() ? other.text : std::string_view(buffer);
+        other.text = {};
+        return *this;
+    }
+
+    SourceFile::~SourceFile() {
+        if (mapping != nullptr) { munmap(mapping, mappedLen); }
+    }
+
+    [[nodiscard]] std::expected<SourceFile, Error> SourceFile::readAll(int fd) {
+        SourceFile file = {};
+        char chunk[64 * 1024];
+
+        while (true) {
+            const ssize_t n = ::read(fd, chunk, sizeof(chunk));
+            if (n == 0) { break; }
+            if (n < 0) {
+                if (errno == EINTR) { continue; }
+                return std::unexpected(Error(
+                    ErrType::IO, std::format("Failed to read input: {}", std::strerror(errno))));
+            }
+            file.buffer.append(chunk, static_cast<std::size_t>(n));
+        }
+
+        file.text = file.buffer;
+        return file;
+    }
+
+    [[nodiscard]] std::expected<SourceFile, Error> SourceFile::open(std::string_view path) {
+        if (path == "-") { return readAll(STDIN_FILENO); }
+
+        const std::string p = std::string(path);
+        const int fd = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return std::unexpected(Error(
+                ErrType::IO, std::format("Cannot open '{}': {}", path, std::strerror(errno))));
+        }
+
+        struct stat st = {};
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+            // Not something we can map, or nothing to map
+            std::expected<SourceFile, Error> ret = readAll(fd);
+            ::close(fd);
+            return ret;
+        }
+
+        const auto len = static_cast<std::size_t>(st.st_size);
+        void* addr = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            return std::unexpected(Error(
+                ErrType::IO, std::format("Cannot map '{}': {}", path, std::strerror(errno))));
+        }
+        // The lexer makes a single forward pass over the source
+        madvise(addr, len, MADV_SEQUENTIAL);
+
+        SourceFile file = {};
+        file.mapping = addr;
+        file.mappedLen = len;
+        file.text = std::string_view(static_cast<const char*>(addr), len);
+        return file;
+    }
+}  // namespace Winter
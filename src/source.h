@@ -0,0 +1,35 @@
+#ifndef WINTER_SOURCE_H
+#define WINTER_SOURCE_H
+
+#include <cstddef>
+#include <expected>
+#include <string>
+#include <string_view>
+
+#include "error.h"
+
+namespace Winter {
+    // Read-only contents of an input file. Regular files are mapped straight into
+    // memory so the lexer reads the page cache directly; anything that can't be mapped
+    // (pipes, stdin, ...) is read into an owned buffer instead
+    struct SourceFile {
+        std::string_view text = {};
+        void* mapping = nullptr;
+        std::size_t mappedLen = 0;
+        std::string buffer = {};
+
+        SourceFile() = default;
+        SourceFile(const SourceFile&) = delete;
+        SourceFile& operator=(const SourceFile&) = delete;
+        SourceFile(SourceFile&&) noexcept;
+        SourceFile& operator=(SourceFile&&) noexcept;
+        ~SourceFile();
+
+        // `-` reads from stdin
+        [[nodiscard]] static std::expected<SourceFile, Error> open(std::string_view path);
+        [[nodiscard]] static std::expected<SourceFile, Error> readAll(int fd);
+        [[nodiscard]] bool isMapped() const noexcept { return mapping != nullptr; }
+    };
+}  // namespace Winter
+
+#endif  // WINTER_SOURCE_H
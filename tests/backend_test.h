@@ -2,19 +2,25 @@
 #define WINTER_BACKEND_TEST_H
 
 #include <optional>
+#include <string_view>
 
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Verifier.h>
 #include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/TargetParser/Host.h>
 #include <willow/willow.h>
 
 #include "backend/backend.h"
 #include "frontend/parser.h"
+#include "frontend/sema.h"
 #include "llvm/ADT/StringRef.h"
 
 using namespace Winter;
 
 [[nodiscard]] constexpr int test_getType([[maybe_unused]] Willow::Test* test) noexcept {
     Backend B = Backend("test");
-    const auto t = B.getType("i32");
+    const auto t = B.getType(BuiltinType::i32);
 
     if (!t.has_value()) { return 1; }
     if (!t.value()->isIntegerTy(32)) { return 2; }
@@ -35,21 +41,55 @@ using namespace Winter;
     return 0;
 }
 
+[[nodiscard]] constexpr int test_crossCompiling([[maybe_unused]] Willow::Test* test) noexcept {
+    Backend B = Backend("test");
+    if (B.crossCompiling()) { return 1; }
+    B.targetTriple = Triple(sys::getDefaultTargetTriple());
+    if (B.crossCompiling()) { return 2; }
+
+    // objects for another machine can't be linked against this one's crt files
+    B.targetTriple = Triple("aarch64-unknown-linux-gnu");
+    if (!B.crossCompiling()) { return 3; }
+    const auto err = B.linkModules({});
+    if (!err.has_value() || err.value().type != ErrType::Generator) { return 4; }
+
+    return 0;
+}
+
+[[nodiscard]] constexpr int test_getTargetMachine([[maybe_unused]] Willow::Test* test) noexcept {
+    Backend B = Backend("test");
+    const auto first = B.getTargetMachine();
+    if (!first.has_value()) {
+        test->alert(first.error().msg);
+        return 1;
+    }
+
+    // every module shares the one machine
+    const auto second = B.getTargetMachine();
+    if (!second.has_value() || second.value() != first.value()) { return 2; }
+
+    return 0;
+}
+
 [[nodiscard]] constexpr int test_createFunction([[maybe_unused]] Willow::Test* test) noexcept {
-    // We need to get a letNode
-    Parser P("let x = func() i32 { return 0; }"sv);
-    P.consume();
-    Node_Result maybe_let = P.parseLet(false);
-    if (!maybe_let.has_value()) { return 1; }
-    const letNode* let = std::get_if<letNode>(&maybe_let.value().data);
+    // We need to get a letNode, and its types from analysis
+    Parser P("let x = func(a: i32) i32 { return a; }"sv);
+    auto tree = P();
+    if (!tree.has_value()) { return 1; }
+    auto sema = analyze(tree.value());
+    if (!sema.has_value()) { return 2; }
+    const NodeId root = tree.value().roots[0];
+    const letNode* let = std::get_if<letNode>(&tree.value()[root].data);
 
     Backend B = Backend("test");
     module_ptr_t mod = std::make_unique<Module>("test_createFunction", B.ctx);
-    B.currentNode = maybe_let.value();
+    B.ast = &tree.value();
+    B.sema = &sema.value();
+    B.currentNode = root;
     std::optional<Winter::Error> ret = B.createFunction(mod, let);
     if (ret.has_value()) {
         test->alert(ret.value().msg);
-        return 2;
+        return 3;
     }
 
     return 0;
@@ -57,66 +97,261 @@ using namespace Winter;
 
 [[nodiscard]] constexpr int test_createBlock([[maybe_unused]] Willow::Test* test) noexcept {
     Backend B = Backend("test");
-    module_ptr_t mod = std::make_unique<Module>("test_createBlock", B.ctx);
-    const letNode let = letNode("foo", true, false);
-    BasicBlock* blk = B.createBlock(mod, &let);
+    BasicBlock* blk = B.createBlock(0);
     if (blk == nullptr) { return 1; }
     return 0;
 }
 
 [[nodiscard]] constexpr int test_compileExpression([[maybe_unused]] Willow::Test* test) noexcept {
-    // // We need to get a letNode
+    // Literals get their widths from analysis
     Parser P("let x = func() i32 { return 34 + 35; }"sv);
-    P.consume();
-    Node_Result maybe_let = P.parseLet(false);
-    if (!maybe_let.has_value()) { return 1; }
-    const letNode* let = std::get_if<letNode>(&maybe_let.value().data);
+    auto tree = P();
+    if (!tree.has_value()) { return 1; }
+    auto sema = analyze(tree.value());
+    if (!sema.has_value()) { return 2; }
 
     // currentNode needs to be an expression
     // let > function > body > return > expr
-    const Node body = maybe_let.value().children.at(0).children.at(0);
-    const Node expr = body.children.at(0).children.at(0);
+    const NodeId body = tree.value().childId(tree.value().childId(tree.value().roots[0], 0), 0);
+    const NodeId expr = tree.value().childId(tree.value().childId(body, 0), 0);
 
     Backend B = Backend("test");
-    module_ptr_t mod = std::make_unique<Module>("test_compileExpression", B.ctx);
+    B.ast = &tree.value();
+    B.sema = &sema.value();
     B.currentNode = expr;
-    IRBuilder builder(B.createBlock(mod, let));
-
-    Value* value = B.compileExpression(&builder);
+    IRBuilder builder(B.createBlock(0));
 
-    // if (value->getName() != llvm::StringRef("test_compileExpression")) {
-    //     test->alert(std::string(value->getName()));
-    //     return 2;
-    // }
+    const auto value = B.compileExpression(&builder);
+    if (!value.has_value()) {
+        test->alert(value.error().msg);
+        return 3;
+    }
+    if (!value.value()->getType()->isIntegerTy(32)) { return 4; }
 
     return 0;
 }
 
 [[nodiscard]] constexpr int test_populateBlock([[maybe_unused]] Willow::Test* test) noexcept {
-    // // We need to get a letNode
     Parser P("let x = func() i32 { return 34 + 35; }"sv);
-    P.consume();
-    Node_Result maybe_let = P.parseLet(false);
-    if (!maybe_let.has_value()) { return 1; }
-    const letNode* let = std::get_if<letNode>(&maybe_let.value().data);
+    auto tree = P();
+    if (!tree.has_value()) { return 1; }
+    auto sema = analyze(tree.value());
+    if (!sema.has_value()) { return 2; }
 
     Backend B = Backend("test");
-    module_ptr_t mod = std::make_unique<Module>("test_createBlock", B.ctx);
-    BasicBlock* blk = B.createBlock(mod, let);
-    if (blk == nullptr) { return 2; }
+    BasicBlock* blk = B.createBlock(0);
+    if (blk == nullptr) { return 3; }
+
+    B.ast = &tree.value();
+    B.sema = &sema.value();
+    B.currentNode = tree.value().roots[0];
+    std::optional<Winter::Error> err = B.populateBlock(blk);
+    if (err.has_value()) {
+        test->alert(err.value().msg);
+        return 4;
+    }
+
+    // an operator codegen can't emit yet is an error, not a null return value
+    Parser P2("let x = func() i32 { return 34 - 35; }"sv);
+    auto tree2 = P2();
+    if (!tree2.has_value()) { return 5; }
+    auto sema2 = analyze(tree2.value());
+    if (!sema2.has_value()) { return 6; }
+    B.ast = &tree2.value();
+    B.sema = &sema2.value();
+    B.currentNode = tree2.value().roots[0];
+    err = B.populateBlock(B.createBlock(0));
+    if (!err.has_value() || err.value().type != ErrType::Generator) { return 7; }
 
-    B.currentNode = maybe_let.value();
-    B.populateBlock(blk);
+    return 0;
+}
+
+[[nodiscard]] constexpr int test_optimizeModule([[maybe_unused]] Willow::Test* test) noexcept {
+    if (parseOptLevel("2") != OptLevel::O2 || parseOptLevel("s") != OptLevel::Os) { return 1; }
+    if (parseOptLevel("4").has_value() || parseOptLevel("").has_value()) { return 2; }
+
+    // A local kept on the stack is promoted to a register from -O1 up
+    Backend B = Backend("test", OptLevel::O1);
+    module_ptr_t mod = std::make_unique<Module>("test_optimizeModule", B.ctx);
+    FunctionType* fType = FunctionType::get(Type::getInt32Ty(B.ctx), false);
+    Function* fn = Function::Create(fType, Function::ExternalLinkage, "main", *mod);
+    IRBuilder builder(BasicBlock::Create(B.ctx, Twine(), fn));
+    AllocaInst* local = builder.CreateAlloca(Type::getInt32Ty(B.ctx));
+    builder.CreateStore(builder.getInt32(7), local);
+    builder.CreateRet(builder.CreateLoad(Type::getInt32Ty(B.ctx), local));
+
+    std::optional<Winter::Error> ret = B.optimizeModule(mod, nullptr);
+    if (ret.has_value()) {
+        test->alert(ret.value().msg);
+        return 3;
+    }
+    for (const Instruction& inst : fn->getEntryBlock()) {
+        if (isa<AllocaInst>(inst)) { return 4; }
+    }
+
+    return 0;
+}
+
+[[nodiscard]] constexpr int test_prepareModule([[maybe_unused]] Willow::Test* test) noexcept {
+    // A block with no terminator is invalid IR, which is caught even when not optimizing
+    Backend B = Backend("test");
+    module_ptr_t mod = std::make_unique<Module>("test_prepareModule", B.ctx);
+    FunctionType* fType = FunctionType::get(Type::getInt32Ty(B.ctx), false);
+    Function* fn = Function::Create(fType, Function::ExternalLinkage, "main", *mod);
+    BasicBlock* blk = BasicBlock::Create(B.ctx, Twine(), fn);
+
+    const auto broken = B.prepareModule(mod);
+    if (broken.has_value() || broken.error().type != ErrType::Generator) { return 1; }
+
+    IRBuilder builder(blk);
+    builder.CreateRet(builder.getInt32(0));
+    const auto machine = B.prepareModule(mod);
+    if (!machine.has_value()) {
+        test->alert(machine.error().msg);
+        return 2;
+    }
+    if (mod->getTargetTriple() != B.targetTriple.value()) { return 3; }
 
     return 0;
 }
 
 [[nodiscard]] constexpr int test_compileModule([[maybe_unused]] Willow::Test* test) noexcept {
-    return 1;
+    // an integer literal is as wide as the type it is returned as, and may be a float
+    Parser P("let a = func() i64 { return 1; }\nlet b = func() f64 { return 1 + 2; }"sv);
+    auto tree = P();
+    if (!tree.has_value()) { return 1; }
+    auto sema = analyze(tree.value());
+    if (!sema.has_value()) { return 2; }
+
+    Backend B = Backend("test");
+    module_result_t mod = B.compileModule(tree.value(), sema.value());
+    if (!mod.has_value()) {
+        test->alert(mod.error().msg);
+        return 3;
+    }
+    if (verifyModule(*mod.value(), &errs())) { return 4; }
+
+    auto returned = [&mod](StringRef name) {
+        const Instruction* ret = mod.value()->getFunction(name)->getEntryBlock().getTerminator();
+        return cast<ReturnInst>(ret)->getReturnValue()->getType();
+    };
+    if (!returned("a")->isIntegerTy(64)) { return 5; }
+    if (!returned("b")->isDoubleTy()) { return 6; }
+
+    return 0;
 }
 
 [[nodiscard]] constexpr int test_outputObjectFile([[maybe_unused]] Willow::Test* test) noexcept {
-    return 1;
+    Parser P("let main = func() i32 { return 0; }"sv);
+    auto tree = P();
+    if (!tree.has_value()) { return 1; }
+    auto sema = analyze(tree.value());
+    if (!sema.has_value()) { return 2; }
+
+    Backend B = Backend("test");
+    module_result_t mod = B.compileModule(tree.value(), sema.value());
+    if (!mod.has_value()) { return 3; }
+    if (!B.prepareModule(mod.value()).has_value()) { return 4; }
+
+    // the object is only ever in memory
+    const auto object = B.outputObjectFile(mod.value());
+    if (!object.has_value()) {
+        test->alert(object.error().msg);
+        return 5;
+    }
+    const std::string_view bytes = {object.value().data(), object.value().size()};
+    if (!bytes.starts_with("\x7f" "ELF"sv)) { return 6; }
+
+    return 0;
+}
+
+[[nodiscard]] constexpr int test_outputObjectFiles([[maybe_unused]] Willow::Test* test) noexcept {
+    Parser P("let main = func() i32 { return 0; }\nlet f = func() i32 { return 1; }"sv);
+    auto tree = P();
+    if (!tree.has_value()) { return 1; }
+    auto sema = analyze(tree.value());
+    if (!sema.has_value()) { return 2; }
+
+    Backend B = Backend("test", OptLevel::O2);
+    module_result_t mod = B.compileModule(tree.value(), sema.value());
+    if (!mod.has_value()) { return 3; }
+    if (!B.prepareModule(mod.value()).has_value()) { return 4; }
+
+    // one object per part, each compiled on its own thread
+    const auto objects = B.outputObjectFiles(mod.value(), 2);
+    if (!objects.has_value()) {
+        test->alert(objects.error().msg);
+        return 5;
+    }
+    if (objects.value().size() != 2) { return 6; }
+    for (const object_t& object : objects.value()) {
+        const std::string_view bytes = {object.data(), object.size()};
+        if (!bytes.starts_with("\x7f" "ELF"sv)) { return 7; }
+    }
+
+    return 0;
+}
+
+[[nodiscard]] constexpr int test_outputStem([[maybe_unused]] Willow::Test* test) noexcept {
+    // outputs land in the working directory, wherever the input is
+    if (Backend("examples/hello.wtx").outputStem() != "hello") { return 1; }
+    if (Backend("-").outputStem() != "stdin") { return 2; }
+    return 0;
+}
+
+[[nodiscard]] constexpr int test_runModule([[maybe_unused]] Willow::Test* test) noexcept {
+    Parser P("let main = func() i32 { return 40 + 2; }"sv);
+    auto tree = P();
+    if (!tree.has_value()) { return 1; }
+    auto sema = analyze(tree.value());
+    if (!sema.has_value()) { return 2; }
+
+    Backend B = Backend("test");
+    module_result_t mod = B.compileModule(tree.value(), sema.value());
+    if (!mod.has_value()) { return 3; }
+    if (!B.prepareModule(mod.value()).has_value()) { return 4; }
+
+    // main's return value comes back as the exit code
+    const auto exitCode = B.runModule(mod.value());
+    if (!exitCode.has_value()) {
+        test->alert(exitCode.error().msg);
+        return 5;
+    }
+    if (exitCode.value() != 42) { return 6; }
+
+    // main may take an argc, as docs/examples/return.wtx does. Anything else is refused
+    // rather than called with the wrong signature
+    auto run = [](std::string_view src) -> std::expected<int, Error> {
+        Parser other(src);
+        auto otherTree = other();
+        if (!otherTree.has_value()) { return std::unexpected(otherTree.error()); }
+        auto otherSema = analyze(otherTree.value());
+        if (!otherSema.has_value()) { return std::unexpected(otherSema.error()); }
+
+        Backend otherB = Backend("test");
+        module_result_t otherMod = otherB.compileModule(otherTree.value(), otherSema.value());
+        if (!otherMod.has_value()) { return std::unexpected(otherMod.error()); }
+        auto prepared = otherB.prepareModule(otherMod.value());
+        if (!prepared.has_value()) { return std::unexpected(prepared.error()); }
+        return otherB.runModule(otherMod.value());
+    };
+
+    const auto withArgc = run("let main = func(argc: i32) i32 { return 35 + (17 * 2); }"sv);
+    if (!withArgc.has_value()) {
+        test->alert(withArgc.error().msg);
+        return 7;
+    }
+    if (withArgc.value() != 69) { return 8; }
+
+    for (std::string_view src : {"let main = func() i64 { return 1; }"sv,
+                                 "let main = func(argc: i64) i32 { return 1; }"sv,
+                                 "let main = func(a: i32, b: i32) i32 { return 1; }"sv,
+                                 "let start = func() i32 { return 1; }"sv}) {
+        const auto refused = run(src);
+        if (refused.has_value() || refused.error().type != ErrType::Generator) { return 9; }
+    }
+
+    return 0;
 }
 
 #endif  // WINTER_BACKEND_TEST_H
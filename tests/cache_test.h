@@ -0,0 +1,174 @@
+#ifndef WINTER_CACHE_TEST_H
+#define WINTER_CACHE_TEST_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <variant>
+
+#include <willow/willow.h>
+
+#include "frontend/cache.h"
+#include "frontend/parser.h"
+
+using namespace Winter;
+using namespace std::literals::string_view_literals;
+
+constexpr std::string_view cacheSource =
+    "mod test;\n"
+    "alias int_t = i32;\n"
+    "type E = enum { a, b }\n"
+    "type C = class { let x: i32; }\n"
+    "let main = func(a: i32, b: i32) i32 { if (a > b) { return a; } foo(b, 'c'); return b; }\n"sv;
+
+// Same shape and same text everywhere, including every symbol
+[[nodiscard]] bool sameTree(const Ast& lhs, const Ast& rhs) {
+    if (lhs.size() != rhs.size() || lhs.edges != rhs.edges || lhs.roots != rhs.roots) {
+        return false;
+    }
+    for (std::size_t i = 0; i < lhs.size(); i++) {
+        const NodeId id = static_cast<NodeId>(i);
+        if (lhs[id] != rhs[id]) { return false; }
+        auto display = [](const Node& node) {
+            return std::visit([](auto&& v) { return v.display(); }, node.data);
+        };
+        if (display(lhs[id]) != display(rhs[id])) { return false; }
+    }
+    return true;
+}
+
+[[nodiscard]] int test_cache_roundTrip([[maybe_unused]] Willow::Test* test) noexcept {
+    Parser P(cacheSource);
+    auto r = P();
+    if (!r.has_value()) { return 1; }
+
+    const SourceDigest source = digestSource(cacheSource);
+    const std::string bytes = serializeAst(r.value(), source);
+    auto loaded = deserializeAst(bytes, source);
+    if (!loaded.has_value()) {
+        test->alert(loaded.error().msg);
+        return 2;
+    }
+    if (!sameTree(r.value(), loaded.value())) { return 3; }
+
+    // Symbols are stored as text, not as ids of this process's interner
+    const auto* let = std::get_if<letNode>(&loaded.value()[loaded.value().roots.back()].data);
+    if (let == nullptr || let->name.str() != "main") { return 4; }
+
+    if (hashSource("a"sv) == hashSource("b"sv)) { return 5; }
+    if (hashSourceMixed("a"sv) == hashSourceMixed("b"sv)) { return 6; }
+    if (hashSourceMixed("12345678a"sv) == hashSourceMixed("12345678b"sv)) { return 7; }
+
+    // Bytes outside each node's value don't reach the file, so the same tree always
+    // gives the same bytes
+    Ast dirty = r.value();
+    for (std::size_t i = 0; i < dirty.nodes.size(); i++) {
+        std::memset(static_cast<void*>(&dirty.nodes[i]), 0xa5, sizeof(Node));
+        dirty.nodes[i].type = r.value().nodes[i].type;
+        dirty.nodes[i].children = r.value().nodes[i].children;
+        std::visit(
+            [&dirty, i](const auto& v) {
+                dirty.nodes[i].data.emplace<std::decay_t<decltype(v)>>(v);
+            },
+            r.value().nodes[i].data);
+    }
+    if (serializeAst(dirty, source) != bytes) { return 8; }
+
+    return 0;
+}
+
+[[nodiscard]] int test_cache_invalid([[maybe_unused]] Willow::Test* test) noexcept {
+    Parser P(cacheSource);
+    auto r = P();
+    if (!r.has_value()) { return 1; }
+    const SourceDigest source = digestSource(cacheSource);
+    const std::string bytes = serializeAst(r.value(), source);
+
+    // Other source is refused even when one of the hashes matches
+    SourceDigest other = source;
+    other.hash++;
+    if (deserializeAst(bytes, other).has_value()) { return 2; }
+    other = source;
+    other.check++;
+    if (deserializeAst(bytes, other).has_value()) { return 3; }
+    other = source;
+    other.length++;
+    if (deserializeAst(bytes, other).has_value()) { return 4; }
+
+    if (deserializeAst(std::string_view(bytes).substr(0, bytes.size() - 1), source).has_value()) {
+        return 5;
+    }
+    if (deserializeAst(""sv, source).has_value()) { return 6; }
+
+    std::string badMagic = bytes;
+    badMagic[0] ^= 0x01;
+    if (deserializeAst(badMagic, source).has_value()) { return 7; }
+
+    // An edge pointing past the last node
+    std::string badEdge = bytes;
+    const std::uint32_t past = static_cast<std::uint32_t>(r.value().size());
+    const std::size_t edges = sizeof(CacheHeader) + r.value().size() * sizeof(Node);
+    std::memcpy(badEdge.data() + edges, &past, sizeof(past));
+    if (deserializeAst(badEdge, source).has_value()) { return 8; }
+
+    // An edge back to the node that owns it, which would send a walk round forever
+    const Ast& tree = r.value();
+    const NodeId main = tree.roots.back();
+    const std::size_t mainEdge = edges + tree[main].children.first * sizeof(NodeId);
+    std::string cycle = bytes;
+    std::memcpy(cycle.data() + mainEdge, &main, sizeof(main));
+    if (deserializeAst(cycle, source).has_value()) { return 9; }
+
+    // A function's let whose child isn't the function
+    std::string notFunc = bytes;
+    const NodeId first = 0;
+    if (std::holds_alternative<funcNode>(tree[first].data)) { return 10; }
+    std::memcpy(notFunc.data() + mainEdge, &first, sizeof(first));
+    if (deserializeAst(notFunc, source).has_value()) { return 11; }
+
+    // A node tagged with a type that doesn't match its payload
+    std::string badType = bytes;
+    const std::size_t firstType = sizeof(CacheHeader) + offsetof(Node, type);
+    badType[firstType] = static_cast<char>(tree[first].type == NodeType::modNode
+                                               ? NodeType::letNode
+                                               : NodeType::modNode);
+    if (deserializeAst(badType, source).has_value()) { return 12; }
+
+    // Written by a build with another set of payloads
+    std::string badLayout = bytes;
+    badLayout[offsetof(CacheHeader, payloadCount)] ^= 0x01;
+    if (deserializeAst(badLayout, source).has_value()) { return 13; }
+
+    return 0;
+}
+
+[[nodiscard]] int test_astCache([[maybe_unused]] Willow::Test* test) noexcept {
+    char dir[] = "/tmp/winter_cache_testXXXXXX";
+    if (mkdtemp(dir) == nullptr) { return 1; }
+    const AstCache cache = {std::string(dir) + "/nested"};
+
+    Parser P(cacheSource);
+    auto r = P();
+    if (!r.has_value()) { return 2; }
+
+    if (cache.load(cacheSource).has_value()) { return 3; }
+    const std::optional<Error> err = cache.store(cacheSource, r.value());
+    if (err.has_value()) {
+        test->alert(err.value().msg);
+        return 4;
+    }
+
+    auto hit = cache.load(cacheSource);
+    if (!hit.has_value() || !sameTree(r.value(), hit.value())) { return 5; }
+
+    // Any change to the source misses
+    if (cache.load("mod other;"sv).has_value()) { return 6; }
+
+    std::filesystem::remove_all(dir);
+    return 0;
+}
+
+#endif  // WINTER_CACHE_TEST_H
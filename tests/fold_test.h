@@ -0,0 +1,162 @@
+#ifndef WINTER_FOLD_TEST_H
+#define WINTER_FOLD_TEST_H
+
+#include <cstdint>
+#include <expected>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+#include <willow/willow.h>
+
+#include "frontend/fold.h"
+#include "frontend/parser.h"
+#include "frontend/sema.h"
+
+using namespace Winter;
+using namespace std::literals::string_view_literals;
+
+// A function returning `expr` as `type`, analyzed and folded. `value` is what the return
+// statement holds afterwards
+struct Folded {
+    Ast ast;
+    NodeId value;
+    std::size_t folded;
+};
+
+[[nodiscard]] std::expected<Folded, Error>
+foldReturn(std::string_view expr, std::string_view type = "i32"sv) {
+    std::string src = "let f = func(a: i32) ";
+    src += type;
+    src += " { return ";
+    src += expr;
+    src += " }";
+
+    Parser P(src);
+    std::expected<Ast, Error> tree = P();
+    if (!tree.has_value()) { return std::unexpected(tree.error()); }
+    std::expected<Sema, Error> sema = analyze(tree.value());
+    if (!sema.has_value()) { return std::unexpected(sema.error()); }
+    std::expected<std::size_t, Error> folded = foldConstants(tree.value(), sema.value(), P.L);
+    if (!folded.has_value()) { return std::unexpected(folded.error()); }
+
+    // let > function > body > return > value
+    const Ast& ast = tree.value();
+    const NodeId body = ast.childId(ast.childId(ast.roots[0], 0), 0);
+    const NodeId value = ast.childId(ast.childId(body, 0), 0);
+    return Folded(std::move(tree.value()), value, folded.value());
+}
+
+[[nodiscard]] const Node& foldedValue(const Folded& f) { return f.ast[f.value]; }
+
+[[nodiscard]] int test_fold_arithmetic([[maybe_unused]] Willow::Test* test) noexcept {
+    auto r = foldReturn("35 + (17 * 2);"sv);
+    if (!r.has_value()) { return 1; }
+    if (!r.value().ast.children(r.value().value).empty()) { return 2; }
+    const auto* num = std::get_if<numlitNode>(&foldedValue(r.value()).data);
+    if (num == nullptr || num->value != NumValue(std::int64_t(69))) { return 3; }
+
+    // left associative, with a negated operand
+    auto r2 = foldReturn("-3 - 4 - 5;"sv);
+    if (!r2.has_value()) { return 4; }
+    const auto* num2 = std::get_if<numlitNode>(&foldedValue(r2.value()).data);
+    if (num2 == nullptr || num2->value != NumValue(std::int64_t(-12))) { return 5; }
+
+    auto r3 = foldReturn("7 / 2;"sv);
+    if (!r3.has_value()) { return 6; }
+    const auto* num3 = std::get_if<numlitNode>(&foldedValue(r3.value()).data);
+    if (num3 == nullptr || num3->value != NumValue(std::int64_t(3))) { return 7; }
+
+    // integer literals returned as a float are floats
+    auto r4 = foldReturn("3 * 0.5;"sv, "f64"sv);
+    if (!r4.has_value()) { return 8; }
+    const auto* num4 = std::get_if<numlitNode>(&foldedValue(r4.value()).data);
+    if (num4 == nullptr || num4->value != NumValue(1.5)) { return 9; }
+
+    auto r5 = foldReturn("7 / 2;"sv, "f64"sv);
+    if (!r5.has_value()) { return 10; }
+    const auto* num5 = std::get_if<numlitNode>(&foldedValue(r5.value()).data);
+    if (num5 == nullptr || num5->value != NumValue(3.5)) { return 11; }
+
+    return 0;
+}
+
+[[nodiscard]] int test_fold_logic([[maybe_unused]] Willow::Test* test) noexcept {
+    auto r = foldReturn("1 < 2 && !false;"sv, "bool"sv);
+    if (!r.has_value()) { return 1; }
+    const auto* b = std::get_if<boolNode>(&foldedValue(r.value()).data);
+    if (b == nullptr || !b->val) { return 2; }
+
+    auto r2 = foldReturn("'a' == 'b' || 2.5 >= 3;"sv, "bool"sv);
+    if (!r2.has_value()) { return 3; }
+    const auto* b2 = std::get_if<boolNode>(&foldedValue(r2.value()).data);
+    if (b2 == nullptr || b2->val) { return 4; }
+
+    auto r3 = foldReturn("\"foo\" .. \"bar\" .. \"baz\";"sv, "String"sv);
+    if (!r3.has_value()) { return 5; }
+    const auto* s = std::get_if<strLitNode>(&foldedValue(r3.value()).data);
+    if (s == nullptr || s->value.str() != "foobarbaz"sv) { return 6; }
+
+    auto r4 = foldReturn("\"foo\" .. \"bar\" == \"foobar\";"sv, "bool"sv);
+    if (!r4.has_value()) { return 7; }
+    const auto* b4 = std::get_if<boolNode>(&foldedValue(r4.value()).data);
+    if (b4 == nullptr || !b4->val) { return 8; }
+
+    return 0;
+}
+
+[[nodiscard]] int test_fold_partial([[maybe_unused]] Willow::Test* test) noexcept {
+    // only the literal operand is folded: a + 6
+    auto r = foldReturn("a + 2 * 3;"sv);
+    if (!r.has_value()) { return 1; }
+    const Ast& ast = r.value().ast;
+    if (r.value().folded != 1) { return 2; }
+    if (foldedValue(r.value()).type != NodeType::exprNode) { return 3; }
+    if (ast.child(r.value().value, 0).type != NodeType::identNode) { return 4; }
+    const auto* num = std::get_if<numlitNode>(&ast.child(r.value().value, 1).data);
+    if (num == nullptr || num->value != NumValue(std::int64_t(6))) { return 5; }
+
+    // postfix operators are left for codegen
+    auto r2 = foldReturn("a++ + 1;"sv);
+    if (!r2.has_value()) { return 6; }
+    if (r2.value().folded != 0) { return 7; }
+    if (foldedValue(r2.value()).type != NodeType::exprNode) { return 8; }
+
+    return 0;
+}
+
+[[nodiscard]] int test_fold_errors([[maybe_unused]] Willow::Test* test) noexcept {
+    // overflow is checked at the width of the expression, not of the literal
+    auto r = foldReturn("2147483647 + 1;"sv);
+    if (r.has_value() || r.error().type != ErrType::Sema) { return 1; }
+    // located at the operator, after `let f = func(a: i32) i32 { return 2147483647 `
+    if (!r.error().msg.ends_with(" at 1:46")) {
+        test->alert(r.error().msg);
+        return 9;
+    }
+    if (!foldReturn("2147483647 + 1;"sv, "i64"sv).has_value()) { return 2; }
+
+    auto r2 = foldReturn("9223372036854775807 + 1;"sv, "i64"sv);
+    if (r2.has_value()) { return 3; }
+
+    auto r3 = foldReturn("0 - 9223372036854775807 - 2;"sv, "i64"sv);
+    if (r3.has_value()) { return 4; }
+
+    auto r4 = foldReturn("4000000000 * 4000000000;"sv, "i64"sv);
+    if (r4.has_value()) { return 5; }
+
+    auto r5 = foldReturn("0 - 1;"sv, "u32"sv);
+    if (r5.has_value()) { return 6; }
+
+    auto r6 = foldReturn("1 / (2 - 2);"sv);
+    if (r6.has_value() || r6.error().type != ErrType::Sema) { return 7; }
+
+    // floats follow IEEE rules rather than erroring
+    auto r7 = foldReturn("1.0 / 0;"sv, "f64"sv);
+    if (!r7.has_value()) { return 8; }
+
+    return 0;
+}
+
+#endif  // WINTER_FOLD_TEST_H
@@ -0,0 +1,57 @@
+#ifndef WINTER_INTERN_TEST_H
+#define WINTER_INTERN_TEST_H
+
+#include <string>
+#include <string_view>
+
+#include <willow/willow.h>
+
+#include "frontend/intern.h"
+
+using namespace Winter;
+using namespace std::literals::string_view_literals;
+
+[[nodiscard]] int test_intern([[maybe_unused]] Willow::Test* test) noexcept {
+    const Symbol a = intern("foo"sv);
+    const Symbol b = intern(std::string("foo"));
+    const Symbol c = intern("bar"sv);
+
+    if (a != b) { return 1; }
+    if (a == c) { return 2; }
+    if (a.str() != "foo"sv) { return 3; }
+    if (c.str() != "bar"sv) { return 4; }
+
+    if (!intern(""sv).empty()) { return 5; }
+    if (a.empty()) { return 6; }
+    if (!Symbol {}.str().empty()) { return 7; }
+
+    return 0;
+}
+
+[[nodiscard]] int test_intern_large([[maybe_unused]] Willow::Test* test) noexcept {
+    // Larger than a single chunk of the interner's storage
+    const std::string big = std::string(Interner::chunkSize + 10, 'x');
+    const Symbol sym = intern(big);
+    if (sym.str() != big) { return 1; }
+
+    // Earlier views stay valid once more chunks are allocated
+    const Symbol small = intern("after_big"sv);
+    if (small.str() != "after_big"sv) { return 2; }
+    if (sym.str() != big) { return 3; }
+
+    // Oversized text doesn't use up the shared chunk: what follows goes right after
+    // what came before
+    Interner local;
+    const Symbol before = local.intern("before"sv);
+    const Symbol huge = local.intern(big);
+    const Symbol after = local.intern("after"sv);
+    if (local.lookup(huge) != big) { return 4; }
+    if (local.chunks.size() != 2) { return 5; }
+    if (local.lookup(after).data() != local.lookup(before).data() + "before"sv.size()) {
+        return 6;
+    }
+
+    return 0;
+}
+
+#endif  // WINTER_INTERN_TEST_H
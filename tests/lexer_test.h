@@ -1,12 +1,14 @@
 #ifndef WINTER_LEXER_TEST_H
 #define WINTER_LEXER_TEST_H
 
+#include <format>
 #include <string>
 #include <string_view>
 
 #include <willow/willow.h>
 
 #include "frontend/lexer.h"
+#include "frontend/scan.h"
 
 using namespace Winter;
 using namespace std::literals::string_view_literals;
@@ -37,7 +39,14 @@ using namespace std::literals::string_view_literals;
     Lexer L = Lexer(str);
     const Token t = Token(TokenType::num_literal, 0, 3);
 
-    if (t.toNum(&L) != 123) { return 1; }
+    const auto num = t.toNum(&L);
+    if (!num.has_value()) { return 1; }
+    if (num.value().integer() != 123) { return 2; }
+
+    const std::string bad = "99999999999999999999";
+    Lexer L2 = Lexer(bad);
+    if (Token(TokenType::num_literal, 0, bad.size()).toNum(&L2).has_value()) { return 3; }
+
     return 0;
 }
 
@@ -50,6 +59,31 @@ using namespace std::literals::string_view_literals;
     return 0;
 }
 
+[[nodiscard]] constexpr int test_token_length([[maybe_unused]] Willow::Test* test) noexcept {
+    static_assert(sizeof(Token) == 8);
+
+    // Too long for the packed length field
+    const std::string str = "\"" + std::string(Token::longLen + 10, 'a') + "\" foo";
+    Lexer L = Lexer(str);
+    TokenBuffer buf = {};
+    if (L.lexAll(buf).has_value()) { return 1; }
+    if (buf.size() != 3) { return 2; }
+
+    const Token t = buf.at(0);
+    if (t.len != Token::longLen) { return 3; }
+    if (t.length(&L) != Token::longLen + 12) {
+        test->alert(std::format("length = {}", t.length(&L)));
+        return 4;
+    }
+    if (t.toString(&L).size() != Token::longLen + 12) { return 5; }
+
+    const Token ident = buf.at(1);
+    if (ident.length(&L) != 3) { return 6; }
+    if (ident.toString(&L) != "foo") { return 7; }
+
+    return 0;
+}
+
 [[nodiscard]] constexpr int test_skipWhitespace([[maybe_unused]] Willow::Test* test) noexcept {
     auto L = Lexer("   foo"sv);
     L.skipWhitespace();
@@ -80,6 +114,33 @@ using namespace std::literals::string_view_literals;
     return 0;
 }
 
+[[nodiscard]] constexpr int test_scanner([[maybe_unused]] Willow::Test* test) noexcept {
+    // Long enough to cover the 16 and 32 byte vector paths and their scalar tails
+    const std::string ws = std::string(37, ' ') + "\t\n" + "x" + std::string(40, 'y') + "\n";
+    const std::size_t nl = ws.size() - 1;
+
+    for (ScanIsa isa : {ScanIsa::scalar, ScanIsa::sse2, ScanIsa::avx2}) {
+        const Scanner& scan = scanner(isa);
+        if (scanIsaSupported(isa) && scan.isa != isa) { return 1; }
+
+        if (scan.whitespace(ws, 0) != 39) {
+            test->alert(std::format("{}: whitespace = {}", isa, scan.whitespace(ws, 0)));
+            return 2;
+        }
+        if (scan.whitespace(ws, 39) != 39) { return 3; }
+        if (scan.whitespace("    "sv, 0) != 4) { return 4; }
+
+        if (scan.newline(ws, 0) != 38) { return 5; }
+        if (scan.newline(ws, 39) != nl) {
+            test->alert(std::format("{}: newline = {}", isa, scan.newline(ws, 39)));
+            return 6;
+        }
+        if (scan.newline(ws, nl + 1) != ws.size()) { return 7; }
+    }
+
+    return 0;
+}
+
 [[nodiscard]] constexpr int test_isNumeric([[maybe_unused]] Willow::Test* test) noexcept {
     auto L = Lexer("0"sv);
     if (!L.isNumeric()) { return 1; }
@@ -87,8 +148,9 @@ using namespace std::literals::string_view_literals;
     L.src = "a"sv;
     if (L.isNumeric()) { return 2; }
 
+    // Only digits start a number, `.5` is not a literal
     L.src = "."sv;
-    if (!L.isNumeric()) { return 3; }
+    if (L.isNumeric()) { return 3; }
 
     return 0;
 }
@@ -187,6 +249,20 @@ using namespace std::literals::string_view_literals;
         return 4;
     }
 
+    auto lexLen = [](std::string_view src) -> std::size_t {
+        auto NL = Lexer(src);
+        const auto tok = NL.lexNumeric();
+        return tok.has_value() ? tok.value().len : 0;
+    };
+
+    if (lexLen("0xFF_FF;"sv) != 7) { return 5; }
+    if (lexLen("1_000.5e-3)"sv) != 10) { return 6; }
+    // range operator, not a fraction
+    if (lexLen("1..2"sv) != 1) { return 7; }
+    // hex digit `e` is not an exponent
+    if (lexLen("0x1e+2"sv) != 4) { return 8; }
+    if (lexLen("2 + 3"sv) != 1) { return 9; }
+
     return 0;
 }
 
@@ -215,6 +291,23 @@ using namespace std::literals::string_view_literals;
     return 0;
 }
 
+[[nodiscard]] constexpr int test_keywordType([[maybe_unused]] Willow::Test* test) noexcept {
+    for (const Keyword& kw : keywordList) {
+        if (keywordType(kw.text) != kw.type) {
+            test->alert(std::string(kw.text));
+            return 1;
+        }
+    }
+
+    if (keywordType("x"sv) != TokenType::ident) { return 2; }
+    if (keywordType("lets"sv) != TokenType::ident) { return 3; }
+    if (keywordType("iff"sv) != TokenType::ident) { return 4; }
+    if (keywordType("fallthroughs"sv) != TokenType::ident) { return 5; }
+    if (keywordType("Let"sv) != TokenType::ident) { return 6; }
+
+    return 0;
+}
+
 [[nodiscard]] constexpr int test_operator_funcCall([[maybe_unused]] Willow::Test* test) noexcept {
     auto L = Lexer("let");
     const auto result = L();
@@ -228,4 +321,111 @@ using namespace std::literals::string_view_literals;
     return 0;
 }
 
+[[nodiscard]] constexpr int test_lexAll([[maybe_unused]] Willow::Test* test) noexcept {
+    auto L = Lexer("let x = 5;"sv);
+    TokenBuffer buf = {};
+    if (L.lexAll(buf).has_value()) { return 1; }
+    if (buf.size() != 6) {
+        test->alert("Token count: " + std::to_string(buf.size()));
+        return 2;
+    }
+
+    if (buf.types.at(0) != TokenType::kw_let) { return 3; }
+    if (buf.types.at(5) != TokenType::eof) { return 4; }
+
+    const Token t = buf.at(3);
+    if (t.type != TokenType::num_literal) { return 5; }
+    if (t.start != 8) { return 6; }
+    if (t.len != 1) { return 7; }
+
+    // Tokens before the error are kept
+    auto L2 = Lexer("let @"sv);
+    TokenBuffer buf2 = {};
+    if (!L2.lexAll(buf2).has_value()) { return 9; }
+    if (buf2.size() != 1) { return 10; }
+
+    return 0;
+}
+
+[[nodiscard]] int test_location([[maybe_unused]] Willow::Test* test) noexcept {
+    auto L = Lexer("let x = 5;\n\n  foo\n@"sv);
+    if (L.lineStarts.has_value()) { return 1; }
+
+    auto at = [&](std::size_t offset) { return std::format("{}", L.location(offset)); };
+    if (at(0) != "1:1") { return 2; }
+    if (at(8) != "1:9") { return 3; }
+    // the newline itself belongs to the line it ends
+    if (at(10) != "1:11") { return 4; }
+    if (at(11) != "2:1") { return 5; }
+    if (at(14) != "3:3") {
+        test->alert("location = " + at(14));
+        return 6;
+    }
+    if (!L.lineStarts.has_value() || L.lineStarts.value().size() != 4) { return 7; }
+
+    TokenBuffer buf = {};
+    const auto err = L.lexAll(buf);
+    if (!err.has_value()) { return 8; }
+    if (!err.value().msg.ends_with("4:1")) {
+        test->alert(err.value().msg);
+        return 9;
+    }
+
+    return 0;
+}
+
+[[nodiscard]] int test_relex([[maybe_unused]] Willow::Test* test) noexcept {
+    struct Case {
+        std::string_view before;
+        TextEdit edit;
+    };
+    static constexpr Case cases[] = {
+        {"let x = 5;\nlet y = 6;\n"sv, {8, 1, "42"sv}},      // replace a literal
+        {"let x = 5;\nlet y = 6;\n"sv, {0, 0, "# hi\n"sv}},  // insert before everything
+        {"let x = 5;\nlet y = 6;\n"sv, {6, 1, "=="sv}},      // turn = into ==
+        {"let foo = bar;"sv, {7, 0, "baz"sv}},                 // join two tokens
+        {"let x = 5; # note\nlet y;"sv, {11, 1, ""sv}},       // uncomment the rest of a line
+        {"let s = \"a b\";"sv, {8, 1, ""sv}},                 // open a string
+        {"x = 1..2;"sv, {9, 0, " y"sv}},                        // append at the end
+    };
+
+    for (std::size_t i = 0; i < std::size(cases); i++) {
+        const Case& c = cases[i];
+        const std::string after = std::string(c.before.substr(0, c.edit.offset)) +
+                                  std::string(c.edit.inserted) +
+                                  std::string(c.before.substr(c.edit.offset + c.edit.removed));
+
+        auto L = Lexer(c.before);
+        TokenBuffer buf = {};
+        if (L.lexAll(buf).has_value()) { return 1; }
+        const auto err = L.relex(buf, after, c.edit);
+
+        auto F = Lexer(after);
+        TokenBuffer full = {};
+        const auto fullErr = F.lexAll(full);
+
+        if (err.has_value() != fullErr.has_value()) { return 2; }
+        if (buf.types != full.types || buf.starts != full.starts || buf.lens != full.lens) {
+            test->alert(std::format("case {}: relexed tokens differ", i));
+            return 3;
+        }
+    }
+
+    // Tokens past the edit keep their length table entries, shifted
+    const std::string longStr = "\"" + std::string(Token::longLen + 5, 'a') + "\"";
+    const std::string before = "let x = 1;\nlet s = " + longStr + ";";
+    const std::string after = "let xy = 1;\nlet s = " + longStr + ";";
+    auto L = Lexer(before);
+    TokenBuffer buf = {};
+    if (L.lexAll(buf).has_value()) { return 4; }
+    if (L.relex(buf, after, TextEdit(5, 0, "y"sv)).has_value()) { return 5; }
+    if (buf.at(8).length(&L) != longStr.size()) { return 6; }
+    if (buf.at(8).toString(&L) != longStr) { return 7; }
+
+    // Edits that don't match the source are rejected
+    if (!L.relex(buf, "x"sv, TextEdit(0, 0, "y"sv)).has_value()) { return 8; }
+
+    return 0;
+}
+
 #endif
@@ -0,0 +1,81 @@
+#ifndef WINTER_NUMERIC_TEST_H
+#define WINTER_NUMERIC_TEST_H
+
+#include <cstdint>
+#include <limits>
+#include <string_view>
+
+#include <willow/willow.h>
+
+#include "frontend/numeric.h"
+
+using namespace Winter;
+using namespace std::literals::string_view_literals;
+
+[[nodiscard]] int test_parseNumLiteral_int([[maybe_unused]] Willow::Test* test) noexcept {
+    auto intOf = [](std::string_view text) -> std::optional<std::int64_t> {
+        const auto num = parseNumLiteral(text);
+        return num.has_value() ? num.value().integer() : std::nullopt;
+    };
+
+    if (intOf("0"sv) != 0) { return 1; }
+    if (intOf("42"sv) != 42) { return 2; }
+    if (intOf("1_000_000"sv) != 1'000'000) { return 3; }
+    if (intOf("0xFF"sv) != 255) { return 4; }
+    if (intOf("0Xdead_beef"sv) != 0xdeadbeef) { return 5; }
+    if (intOf("0b1010"sv) != 10) { return 6; }
+    if (intOf("0o755"sv) != 0755) { return 7; }
+    if (intOf("9223372036854775807"sv) != std::numeric_limits<std::int64_t>::max()) {
+        return 8;
+    }
+    if (intOf("0x7FFF_FFFF_FFFF_FFFF"sv) != std::numeric_limits<std::int64_t>::max()) {
+        return 9;
+    }
+
+    return 0;
+}
+
+[[nodiscard]] int test_parseNumLiteral_float([[maybe_unused]] Willow::Test* test) noexcept {
+    auto floatOf = [](std::string_view text) -> std::optional<double> {
+        const auto num = parseNumLiteral(text);
+        return num.has_value() ? num.value().floating() : std::nullopt;
+    };
+
+    if (floatOf("1.5"sv) != 1.5) { return 1; }
+    if (floatOf("2e3"sv) != 2000.0) { return 2; }
+    if (floatOf("1_000.25"sv) != 1000.25) { return 3; }
+    if (floatOf("3.0E-2"sv) != 0.03) { return 4; }
+    if (parseNumLiteral("1.0"sv).value().isInteger()) { return 5; }
+    if (std::format("{}", parseNumLiteral("2.5"sv).value()) != "2.5") { return 6; }
+
+    return 0;
+}
+
+[[nodiscard]] int test_parseNumLiteral_errors([[maybe_unused]] Willow::Test* test) noexcept {
+    static constexpr std::string_view bad[] = {
+        "9223372036854775808"sv,  // one past int64 max
+        "0x1_0000_0000_0000_0000"sv,
+        "0x"sv,
+        "0b102"sv,
+        "0o8"sv,
+        "12abc"sv,
+        "1__0"sv,
+        "1_"sv,
+        "0x_1"sv,
+        "1.2.3"sv,
+        "1e999"sv,
+    };
+
+    for (std::size_t i = 0; i < std::size(bad); i++) {
+        const auto num = parseNumLiteral(bad[i]);
+        if (num.has_value()) {
+            test->alert(std::format("accepted '{}'", bad[i]));
+            return static_cast<int>(i) + 1;
+        }
+        if (num.error().type != ErrType::Lexer) { return 100; }
+    }
+
+    return 0;
+}
+
+#endif  // WINTER_NUMERIC_TEST_H
@@ -1,25 +1,53 @@
 #ifndef WINTER_PARSER_TEST_H
 #define WINTER_PARSER_TEST_H
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
 #include <format>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
 #include <variant>
+#include <vector>
 
 #include <willow/willow.h>
 
+#include "backend/backend.h"
 #include "frontend/parser.h"
+#include "frontend/sema.h"
 
 using namespace Winter;
 using namespace std::literals::string_view_literals;
 
+// Every allocation made by the test binary, so a test can measure how many a pass makes
+inline std::atomic<std::size_t> allocationCount = 0;
+
+void* operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) { return ptr; }
+    throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, [[maybe_unused]] std::size_t size) noexcept { std::free(ptr); }
+
 [[nodiscard]] int test_node_op_eq([[maybe_unused]] Willow::Test* test) noexcept {
-    const Node n1 = Node(NodeType::boolNode, boolNode(true));
-    const Node n1a = Node(NodeType::boolNode, boolNode(true));
-    const Node n2 = Node(NodeType::boolNode, boolNode(true), {n1});
-    const Node n3 = Node(NodeType::strLitNode, strLitNode("hello"), {n1});
+    Ast ast = {};
+    const NodeId n1 = ast.add(NodeType::boolNode, boolNode(true));
+    const NodeId n1a = ast.add(NodeType::boolNode, boolNode(true));
+    const NodeId n2 = ast.add(NodeType::boolNode, boolNode(true), {n1});
+    const NodeId n3 = ast.add(NodeType::strLitNode, strLitNode(intern("hello")), {n1});
 
-    if (n1 == n2) { return 1; }
-    if (n1 == n3) { return 2; }
-    if (n1 != n1a) { return 3; }
+    if (ast[n1] == ast[n2]) { return 1; }
+    if (ast[n1] == ast[n3]) { return 2; }
+    if (ast[n1] != ast[n1a]) { return 3; }
+
+    // Children are stored by index, contiguously in the edge pool
+    if (ast.children(n2).size() != 1 || ast.childId(n2, 0) != n1) { return 4; }
+    if (ast.edges.size() != 2) { return 5; }
 
     return 0;
 }
@@ -64,6 +92,25 @@ using namespace std::literals::string_view_literals;
     return 0;
 }
 
+[[nodiscard]] int test_parser_peek([[maybe_unused]] Willow::Test* test) noexcept {
+    Parser P("let foo = 1;"sv);
+    P.consume();
+    if (P.peek(0).type != TokenType::ident) { return 1; }
+    if (P.peek(1).type != TokenType::op_equal) { return 2; }
+    if (P.peek(3).type != TokenType::semicolon) { return 3; }
+
+    // Past the end clamps to eof
+    if (P.peek(100).type != TokenType::eof) { return 4; }
+    if (!P.check(TokenType::kw_let)) { return 5; }
+
+    Parser P2("let @"sv);
+    if (!P2.lexError.has_value()) { return 6; }
+    if (P2.peek(5).type != TokenType::error) { return 7; }
+    if (P2().has_value()) { return 8; }
+
+    return 0;
+}
+
 [[nodiscard]] int test_parser_parseAlias([[maybe_unused]] Willow::Test* test) noexcept {
     Parser P("alias int_t = i32;"sv);
     P.consume();
@@ -71,27 +118,27 @@ using namespace std::literals::string_view_literals;
 
     if (!r.has_value()) { return 1; }
 
-    const auto* alias = std::get_if<aliasNode>(&r.value().data);
+    const auto* alias = std::get_if<aliasNode>(&P.ast[r.value()].data);
     if (alias == nullptr) { return 2; }
-    if (alias->ident != "int_t") { return 3; }
+    if (alias->ident.str() != "int_t") { return 3; }
     if (alias->tag != aliasNode::childType::type) { return 4; }
-    if (r.value().children.size() != 1) { return 5; }
+    if (P.ast.children(r.value()).size() != 1) { return 5; }
 
     Parser P2("alias f_ptr = func(i32) int_t;"sv);
     P2.consume();
     auto r2 = P2.parseAlias();
     if (!r2.has_value()) { return 11; }
 
-    const auto* func = std::get_if<aliasNode>(&r2.value().data);
+    const auto* func = std::get_if<aliasNode>(&P2.ast[r2.value()].data);
     if (func == nullptr) { return 12; }
-    if (func->ident != "f_ptr") { return 13; }
+    if (func->ident.str() != "f_ptr") { return 13; }
     if (func->tag != aliasNode::childType::func) { return 14; }
-    if (r2.value().children.size() != 1) { return 15; }
+    if (P2.ast.children(r2.value()).size() != 1) { return 15; }
 
-    const auto* f_Alias = std::get_if<funcAlias>(&r2.value().children.at(0).data);
+    const auto* f_Alias = std::get_if<funcAlias>(&P2.ast.child(r2.value(), 0).data);
     if (f_Alias == nullptr) { return 16; }
     if (f_Alias->paramCount != 1) { return 17; }
-    if (r2.value().children.at(0).children.size() != 2) { return 18; }
+    if (P2.ast.children(P2.ast.childId(r2.value(), 0)).size() != 2) { return 18; }
 
     return 0;
 }
@@ -101,9 +148,9 @@ using namespace std::literals::string_view_literals;
     P.consume();
     auto r = P.parseArg();
     if (!r.has_value()) { return 1; }
-    const auto* an = std::get_if<argNode>(&r.value().data);
-    if (an == nullptr || !an->num.has_value() || an->num.value() != 42 || an->str.has_value() ||
-        an->ch.has_value()) {
+    const auto* an = std::get_if<argNode>(&P.ast[r.value()].data);
+    if (an == nullptr || !an->num.has_value() || an->num.value().integer() != 42 ||
+        an->str.has_value() || an->ch.has_value()) {
         return 2;
     }
     if (!P.check(TokenType::num_literal)) { return 3; }
@@ -112,8 +159,8 @@ using namespace std::literals::string_view_literals;
     P2.consume();
     auto r2 = P2.parseArg();
     if (!r2.has_value()) { return 4; }
-    const auto* an2 = std::get_if<argNode>(&r2.value().data);
-    if (an2 == nullptr || !an2->str.has_value() || an2->str.value() != "count" ||
+    const auto* an2 = std::get_if<argNode>(&P2.ast[r2.value()].data);
+    if (an2 == nullptr || !an2->str.has_value() || an2->str.value().str() != "count" ||
         an2->num.has_value() || an2->ch.has_value()) {
         return 5;
     }
@@ -122,8 +169,8 @@ using namespace std::literals::string_view_literals;
     P3.consume();
     auto r3 = P3.parseArg();
     if (!r3.has_value()) { return 6; }
-    const auto* an3 = std::get_if<argNode>(&r3.value().data);
-    if (an3 == nullptr || !an3->str.has_value() || an3->str.value() != "\"hi\"" ||
+    const auto* an3 = std::get_if<argNode>(&P3.ast[r3.value()].data);
+    if (an3 == nullptr || !an3->str.has_value() || an3->str.value().str() != "\"hi\"" ||
         an3->num.has_value() || an3->ch.has_value()) {
         return 7;
     }
@@ -140,17 +187,17 @@ using namespace std::literals::string_view_literals;
     P.consume();
     auto r = P.parseBody();
     if (!r.has_value()) { return 1; }
-    if (r.value().type != NodeType::bodyNode) { return 2; }
-    const auto* bd = std::get_if<bodyNode>(&r.value().data);
+    if (P.ast[r.value()].type != NodeType::bodyNode) { return 2; }
+    const auto* bd = std::get_if<bodyNode>(&P.ast[r.value()].data);
     if (bd == nullptr || bd->childCount != 0) { return 3; }
 
     Parser P2("{ return 1; }"sv);
     P2.consume();
     auto r2 = P2.parseBody();
     if (!r2.has_value()) { return 4; }
-    const auto* bd2 = std::get_if<bodyNode>(&r2.value().data);
+    const auto* bd2 = std::get_if<bodyNode>(&P2.ast[r2.value()].data);
     if (bd2 == nullptr || bd2->childCount != 1) { return 5; }
-    if (r2.value().children[0].type != NodeType::returnNode) { return 6; }
+    if (P2.ast.child(r2.value(), 0).type != NodeType::returnNode) { return 6; }
 
     return 0;
 }
@@ -160,20 +207,24 @@ using namespace std::literals::string_view_literals;
     P.consume();
     auto r = P.parseCallOrVariable();
     if (!r.has_value()) { return 1; }
-    if (r.value().type != NodeType::callNode) { return 2; }
-    const auto* cn = std::get_if<funcCallNode>(&r.value().data);
-    if (cn == nullptr || cn->name != "foo" || r.value().children.size() != 0) { return 3; }
+    if (P.ast[r.value()].type != NodeType::callNode) { return 2; }
+    const auto* cn = std::get_if<funcCallNode>(&P.ast[r.value()].data);
+    if (cn == nullptr || cn->name.str() != "foo" || P.ast.children(r.value()).size() != 0) {
+        return 3;
+    }
 
     Parser P2("foo(1, 2);"sv);
     P2.consume();
     auto r2 = P2.parseCallOrVariable();
     if (!r2.has_value()) { return 4; }
-    const auto* cn2 = std::get_if<funcCallNode>(&r2.value().data);
-    if (cn2 == nullptr || cn2->name != "foo" || r2.value().children.size() != 2) { return 5; }
-    const auto* a0 = std::get_if<argNode>(&r2.value().children[0].data);
-    const auto* a1 = std::get_if<argNode>(&r2.value().children[1].data);
-    if (a0 == nullptr || a1 == nullptr || !a0->num.has_value() || a0->num.value() != 1 ||
-        !a1->num.has_value() || a1->num.value() != 2) {
+    const auto* cn2 = std::get_if<funcCallNode>(&P2.ast[r2.value()].data);
+    if (cn2 == nullptr || cn2->name.str() != "foo" || P2.ast.children(r2.value()).size() != 2) {
+        return 5;
+    }
+    const auto* a0 = std::get_if<argNode>(&P2.ast.child(r2.value(), 0).data);
+    const auto* a1 = std::get_if<argNode>(&P2.ast.child(r2.value(), 1).data);
+    if (a0 == nullptr || a1 == nullptr || !a0->num.has_value() || a0->num.value().integer() != 1 ||
+        !a1->num.has_value() || a1->num.value().integer() != 2) {
         return 6;
     }
 
@@ -195,10 +246,11 @@ using namespace std::literals::string_view_literals;
     P.consume();
     Node_Result r = P.parseCase();
     if (!r.has_value()) { return 1; }
-    if (r.value().type != NodeType::caseNode) { return 2; }
-    const auto* cn = std::get_if<caseNode>(&r.value().data);
-    if (cn == nullptr || cn->fallthrough || cn->defaultCase || cn->ident != "5") { return 3; }
-    if (r.value().children.size() != 1 || r.value().children[0].type != NodeType::bodyNode) {
+    if (P.ast[r.value()].type != NodeType::caseNode) { return 2; }
+    const auto* cn = std::get_if<caseNode>(&P.ast[r.value()].data);
+    if (cn == nullptr || cn->fallthrough || cn->defaultCase || cn->ident.str() != "5") { return 3; }
+    if (P.ast.children(r.value()).size() != 1 ||
+        P.ast.child(r.value(), 0).type != NodeType::bodyNode) {
         return 4;
     }
 
@@ -206,11 +258,13 @@ using namespace std::literals::string_view_literals;
     P2.consume();
     Node_Result r2 = P2.parseCase();
     if (!r2.has_value()) { return 5; }
-    const auto* cn2 = std::get_if<caseNode>(&r2.value().data);
-    if (cn2 == nullptr || !cn2->fallthrough || cn2->defaultCase || cn2->ident != "1") { return 6; }
-    if (r2.value().children.size() != 1) { return 7; }
-    const auto* inner = std::get_if<caseNode>(&r2.value().children[0].data);
-    if (inner == nullptr || inner->fallthrough || inner->defaultCase || inner->ident != "2") {
+    const auto* cn2 = std::get_if<caseNode>(&P2.ast[r2.value()].data);
+    if (cn2 == nullptr || !cn2->fallthrough || cn2->defaultCase || cn2->ident.str() != "1") {
+        return 6;
+    }
+    if (P2.ast.children(r2.value()).size() != 1) { return 7; }
+    const auto* inner = std::get_if<caseNode>(&P2.ast.child(r2.value(), 0).data);
+    if (inner == nullptr || inner->fallthrough || inner->defaultCase || inner->ident.str() != "2") {
         return 8;
     }
 
@@ -218,7 +272,7 @@ using namespace std::literals::string_view_literals;
     P3.consume();
     Node_Result r3 = P3.parseCase();
     if (!r3.has_value()) { return 9; }
-    const auto* cn3 = std::get_if<caseNode>(&r3.value().data);
+    const auto* cn3 = std::get_if<caseNode>(&P3.ast[r3.value()].data);
     if (cn3 == nullptr || cn3->fallthrough || !cn3->defaultCase || !cn3->ident.empty()) {
         return 10;
     }
@@ -232,9 +286,9 @@ using namespace std::literals::string_view_literals;
     Node_Result r = P.parseCharLit();
 
     if (!r.has_value()) { return 1; }
-    if (r.value().type != NodeType::charLitNode) { return 2; }
+    if (P.ast[r.value()].type != NodeType::charLitNode) { return 2; }
 
-    const charLitNode* char_ptr = std::get_if<charLitNode>(&r.value().data);
+    const charLitNode* char_ptr = std::get_if<charLitNode>(&P.ast[r.value()].data);
     if (char_ptr == nullptr) { return 3; }
     if (char_ptr->value != 'c') {
         test->alert(std::format("Found: {}", char_ptr->value));
@@ -250,13 +304,13 @@ using namespace std::literals::string_view_literals;
     Node_Result r = P.parseClass();
 
     if (!r.has_value()) { return 1; }
-    if (r.value().type != NodeType::classNode) { return 2; }
+    if (P.ast[r.value()].type != NodeType::classNode) { return 2; }
 
-    const classNode* cls_ptr = std::get_if<classNode>(&r.value().data);
+    const classNode* cls_ptr = std::get_if<classNode>(&P.ast[r.value()].data);
     if (cls_ptr == nullptr) { return 3; }
     if (cls_ptr->attrCount != 1) { return 4; }
     if (cls_ptr->methodCount != 1) { return 5; }
-    if (r.value().children.size() != 2) { return 6; }
+    if (P.ast.children(r.value()).size() != 2) { return 6; }
 
     return 0;
 }
@@ -267,63 +321,63 @@ using namespace std::literals::string_view_literals;
     Node_Result r = P.parseIf();
 
     if (!r.has_value()) { return 1; }
-    if (r.value().type != NodeType::ifNode) { return 2; }
-    if (r.value().children.size() != 2) { return 3; }
-    if (r.value().children.at(0).type != NodeType::boolNode) { return 4; }
-    if (r.value().children.at(1).type != NodeType::bodyNode) { return 5; }
+    if (P.ast[r.value()].type != NodeType::ifNode) { return 2; }
+    if (P.ast.children(r.value()).size() != 2) { return 3; }
+    if (P.ast.child(r.value(), 0).type != NodeType::boolNode) { return 4; }
+    if (P.ast.child(r.value(), 1).type != NodeType::bodyNode) { return 5; }
 
     Parser P2("if (3 > 0) { return 1; } else { return 0; }"sv);
     P2.consume();
     Node_Result r2 = P2.parseIf();
     if (!r2.has_value()) { return 11; }
-    if (r2.value().type != NodeType::ifNode) { return 12; }
-    if (r2.value().children.size() != 3) {
-        test->alert(std::format("Children count: {}", r2.value().children.size()));
+    if (P2.ast[r2.value()].type != NodeType::ifNode) { return 12; }
+    if (P2.ast.children(r2.value()).size() != 3) {
+        test->alert(std::format("Children count: {}", P2.ast.children(r2.value()).size()));
         return 13;
     }
 
-    if (r2.value().children.at(0).type != NodeType::exprNode) {
-        test->alert(std::format("token: {}", r2.value().children.at(0).type));
+    if (P2.ast.child(r2.value(), 0).type != NodeType::exprNode) {
+        test->alert(std::format("token: {}", P2.ast.child(r2.value(), 0).type));
         return 14;
     }
 
-    if (r2.value().children.at(1).type != NodeType::bodyNode) {
-        test->alert(std::format("token: {}", r2.value().children.at(1).type));
+    if (P2.ast.child(r2.value(), 1).type != NodeType::bodyNode) {
+        test->alert(std::format("token: {}", P2.ast.child(r2.value(), 1).type));
         return 15;
     }
 
-    if (r2.value().children.at(2).type != NodeType::bodyNode) { return 16; }
+    if (P2.ast.child(r2.value(), 2).type != NodeType::bodyNode) { return 16; }
 
     Parser P3("if (3 < 1) { b(); } else if (3 > 1) { d(); } else { e(); }"sv);
     P3.consume();
     Node_Result r3 = P3.parseIf();
     if (!r3.has_value()) { return 21; }
-    if (r3.value().type != NodeType::ifNode) { return 22; }
-    if (r3.value().children.size() != 3) {
-        test->alert(std::format("Children count: {}", r3.value().children.size()));
+    if (P3.ast[r3.value()].type != NodeType::ifNode) { return 22; }
+    if (P3.ast.children(r3.value()).size() != 3) {
+        test->alert(std::format("Children count: {}", P3.ast.children(r3.value()).size()));
         return 23;
     }
 
-    if (r3.value().children.at(0).type != NodeType::exprNode) {
-        test->alert(std::format("token: {}", r3.value().children.at(0).type));
+    if (P3.ast.child(r3.value(), 0).type != NodeType::exprNode) {
+        test->alert(std::format("token: {}", P3.ast.child(r3.value(), 0).type));
         return 24;
     }
 
-    if (r3.value().children.at(1).type != NodeType::bodyNode) {
-        test->alert(std::format("token: {}", r3.value().children.at(1).type));
+    if (P3.ast.child(r3.value(), 1).type != NodeType::bodyNode) {
+        test->alert(std::format("token: {}", P3.ast.child(r3.value(), 1).type));
         return 25;
     }
 
-    if (r3.value().children.at(2).type != NodeType::ifNode) {
-        test->alert(std::format("token: {}", r3.value().children.at(2).type));
+    if (P3.ast.child(r3.value(), 2).type != NodeType::ifNode) {
+        test->alert(std::format("token: {}", P3.ast.child(r3.value(), 2).type));
         return 26;
     }
 
-    const auto innerIf = r3.value().children.at(2);
-    if (innerIf.children.size() != 3) { return 27; }
-    if (innerIf.children.at(0).type != NodeType::exprNode) { return 28; }
-    if (innerIf.children.at(1).type != NodeType::bodyNode) { return 29; }
-    if (innerIf.children.at(2).type != NodeType::bodyNode) { return 30; }
+    const NodeId innerIf = P3.ast.childId(r3.value(), 2);
+    if (P3.ast.children(innerIf).size() != 3) { return 27; }
+    if (P3.ast.child(innerIf, 0).type != NodeType::exprNode) { return 28; }
+    if (P3.ast.child(innerIf, 1).type != NodeType::bodyNode) { return 29; }
+    if (P3.ast.child(innerIf, 2).type != NodeType::bodyNode) { return 30; }
 
     return 0;
 }
@@ -333,28 +387,31 @@ using namespace std::literals::string_view_literals;
     P.consume();
     Node_Result r = P.parseInterfaceInner();
     if (!r.has_value()) { return 1; }
-    if (r.value().type != NodeType::varNode) { return 2; }
-    const auto* vn = std::get_if<varNode>(&r.value().data);
-    if (vn == nullptr || vn->name != "n" || vn->type != "i32" || vn->isConst) { return 3; }
+    if (P.ast[r.value()].type != NodeType::varNode) { return 2; }
+    const auto* vn = std::get_if<varNode>(&P.ast[r.value()].data);
+    if (vn == nullptr || vn->name.str() != "n" || vn->type.str() != "i32" || vn->isConst) {
+        return 3;
+    }
 
     Parser P2("const let n: i32;"sv);
     P2.consume();
     Node_Result r2 = P2.parseInterfaceInner();
     if (!r2.has_value()) { return 4; }
-    const auto* vn2 = std::get_if<varNode>(&r2.value().data);
+    const auto* vn2 = std::get_if<varNode>(&P2.ast[r2.value()].data);
     if (vn2 == nullptr || !vn2->isConst) { return 5; }
 
     Parser P3("let f = func(arg: void) bool;"sv);
     P3.consume();
     Node_Result r3 = P3.parseInterfaceInner();
     if (!r3.has_value()) { return 6; }
-    if (r3.value().type != NodeType::funcNode) { return 7; }
-    const auto* fn = std::get_if<funcNode>(&r3.value().data);
-    if (fn == nullptr || fn->name != "f" || fn->retType != "bool" || fn->parameters.size() != 1) {
+    if (P3.ast[r3.value()].type != NodeType::funcNode) { return 7; }
+    const auto* fn = std::get_if<funcNode>(&P3.ast[r3.value()].data);
+    if (fn == nullptr || fn->name.str() != "f" || fn->retType.str() != "bool" ||
+        fn->parameters.count != 1) {
         return 8;
     }
-    const auto* pm = std::get_if<paramNode>(&fn->parameters[0].data);
-    if (pm == nullptr || pm->name != "arg" || pm->type != ":") { return 9; }
+    const auto* pm = std::get_if<paramNode>(&P3.ast[P3.ast.range(fn->parameters)[0]].data);
+    if (pm == nullptr || pm->name.str() != "arg" || pm->type.str() != ":") { return 9; }
 
     return 0;
 }
@@ -364,18 +421,18 @@ using namespace std::literals::string_view_literals;
     P.consume();
     Node_Result r = P.parseInterface();
     if (!r.has_value()) { return 1; }
-    if (r.value().type != NodeType::interfaceNode) { return 2; }
+    if (P.ast[r.value()].type != NodeType::interfaceNode) { return 2; }
 
-    const auto* iface = std::get_if<interfaceNode>(&r.value().data);
+    const auto* iface = std::get_if<interfaceNode>(&P.ast[r.value()].data);
     if (iface == nullptr || iface->attrCount != 1 || iface->methodCount != 1) { return 3; }
-    if (r.value().children.size() != 2) { return 4; }
+    if (P.ast.children(r.value()).size() != 2) { return 4; }
 
-    const auto* attr = std::get_if<varNode>(&r.value().children[0].data);
-    if (attr == nullptr || attr->name != "n" || attr->type != "i32") { return 5; }
+    const auto* attr = std::get_if<varNode>(&P.ast.child(r.value(), 0).data);
+    if (attr == nullptr || attr->name.str() != "n" || attr->type.str() != "i32") { return 5; }
 
-    const auto* method = std::get_if<funcNode>(&r.value().children[1].data);
-    if (method == nullptr || method->name != "f" || method->retType != "bool" ||
-        method->parameters.size() != 1) {
+    const auto* method = std::get_if<funcNode>(&P.ast.child(r.value(), 1).data);
+    if (method == nullptr || method->name.str() != "f" || method->retType.str() != "bool" ||
+        method->parameters.count != 1) {
         return 6;
     }
 
@@ -388,23 +445,23 @@ using namespace std::literals::string_view_literals;
     auto r = P.parseEnum();
 
     if (!r.has_value()) { return 1; }
-    if (r.value().type != NodeType::enumNode) { return 2; }
+    if (P.ast[r.value()].type != NodeType::enumNode) { return 2; }
 
-    enumNode* node = std::get_if<enumNode>(&r.value().data);
+    enumNode* node = std::get_if<enumNode>(&P.ast[r.value()].data);
     if (node == nullptr) { return 3; }
     if (node->count != 2) { return 4; }
-    if (r.value().children.size() != 2) {
-        test->alert("found: " + r.value().children.size());
+    if (P.ast.children(r.value()).size() != 2) {
+        test->alert("found: " + P.ast.children(r.value()).size());
         return 5;
     }
 
-    identNode* c1 = std::get_if<identNode>(&r.value().children.at(0).data);
+    identNode* c1 = std::get_if<identNode>(&P.ast.child(r.value(), 0).data);
     if (c1 == nullptr) { return 6; }
-    if (c1->value != "val_1") { return 7; }
+    if (c1->value.str() != "val_1") { return 7; }
 
-    identNode* c2 = std::get_if<identNode>(&r.value().children.at(1).data);
+    identNode* c2 = std::get_if<identNode>(&P.ast.child(r.value(), 1).data);
     if (c2 == nullptr) { return 8; }
-    if (c2->value != "val_2") { return 9; }
+    if (c2->value.str() != "val_2") { return 9; }
 
     return 0;
 }
@@ -414,21 +471,87 @@ using namespace std::literals::string_view_literals;
     P.consume();
     auto r = P.parseExpr(0);
     if (!r.has_value()) { return 1; }
-    const auto* nl = std::get_if<numlitNode>(&r.value().data);
-    if (nl == nullptr || nl->value != 42) { return 2; }
+    const auto* nl = std::get_if<numlitNode>(&P.ast[r.value()].data);
+    if (nl == nullptr || nl->value.integer() != 42) { return 2; }
 
     Parser P2("1+2;"sv);
     P2.consume();
     auto r2 = P2.parseExpr(0);
     if (!r2.has_value()) { return 3; }
-    const auto* ex = std::get_if<exprNode>(&r2.value().data);
+    const auto* ex = std::get_if<exprNode>(&P2.ast[r2.value()].data);
     if (ex == nullptr || ex->childCount != 2 || !ex->op.has_value() ||
         ex->op.value() != TokenType::plus) {
         return 4;
     }
-    const auto* lhs = std::get_if<numlitNode>(&r2.value().children[0].data);
-    const auto* rhs = std::get_if<numlitNode>(&r2.value().children[1].data);
-    if (lhs == nullptr || rhs == nullptr || lhs->value != 1 || rhs->value != 2) { return 5; }
+    const auto* lhs = std::get_if<numlitNode>(&P2.ast.child(r2.value(), 0).data);
+    const auto* rhs = std::get_if<numlitNode>(&P2.ast.child(r2.value(), 1).data);
+    if (lhs == nullptr || rhs == nullptr || lhs->value.integer() != 1 ||
+        rhs->value.integer() != 2) {
+        return 5;
+    }
+
+    return 0;
+}
+
+// The operator of an expression node, or error if `id` is not a binary/unary expression
+[[nodiscard]] TokenType exprOp(const Ast& ast, NodeId id) {
+    const auto* ex = std::get_if<exprNode>(&ast[id].data);
+    if (ex == nullptr || !ex->op.has_value()) { return TokenType::error; }
+    return ex->op.value();
+}
+
+[[nodiscard]] int test_parser_operators([[maybe_unused]] Willow::Test* test) noexcept {
+    static_assert(opInfo(TokenType::star).infix > opInfo(TokenType::plus).infix);
+    static_assert(opInfo(TokenType::op_equal).assoc == Assoc::right);
+    static_assert(opInfo(TokenType::kw_let).infix == 0);
+
+    // left associative: (1 - 2) - 3
+    Parser P("1 - 2 - 3;"sv);
+    P.consume();
+    auto r = P.parseExpr(0);
+    if (!r.has_value()) { return 1; }
+    if (exprOp(P.ast, r.value()) != TokenType::minus) { return 2; }
+    if (exprOp(P.ast, P.ast.childId(r.value(), 0)) != TokenType::minus) { return 3; }
+    if (P.ast.child(r.value(), 1).type != NodeType::numlitNode) { return 4; }
+
+    // right associative: a = (b = c)
+    Parser P2("a = b = c;"sv);
+    P2.consume();
+    auto r2 = P2.parseExpr(0);
+    if (!r2.has_value()) { return 5; }
+    if (exprOp(P2.ast, r2.value()) != TokenType::op_equal) { return 6; }
+    if (P2.ast.child(r2.value(), 0).type != NodeType::identNode) { return 7; }
+    if (exprOp(P2.ast, P2.ast.childId(r2.value(), 1)) != TokenType::op_equal) { return 8; }
+
+    // prefix operators bind tighter than any binary operator: (-1) * 2
+    Parser P3("-1 * 2;"sv);
+    P3.consume();
+    auto r3 = P3.parseExpr(0);
+    if (!r3.has_value()) { return 9; }
+    if (exprOp(P3.ast, r3.value()) != TokenType::star) { return 10; }
+    const NodeId neg = P3.ast.childId(r3.value(), 0);
+    if (exprOp(P3.ast, neg) != TokenType::minus || P3.ast.children(neg).size() != 1) {
+        return 11;
+    }
+
+    // !a && b
+    Parser P4("!a && b;"sv);
+    P4.consume();
+    auto r4 = P4.parseExpr(0);
+    if (!r4.has_value()) { return 12; }
+    if (exprOp(P4.ast, r4.value()) != TokenType::op_and) { return 13; }
+    if (exprOp(P4.ast, P4.ast.childId(r4.value(), 0)) != TokenType::op_not) { return 14; }
+
+    // postfix: (i++) + 1
+    Parser P5("i++ + 1;"sv);
+    P5.consume();
+    auto r5 = P5.parseExpr(0);
+    if (!r5.has_value()) { return 15; }
+    if (exprOp(P5.ast, r5.value()) != TokenType::plus) { return 16; }
+    const NodeId inc = P5.ast.childId(r5.value(), 0);
+    if (exprOp(P5.ast, inc) != TokenType::plus_plus || P5.ast.children(inc).size() != 1) {
+        return 17;
+    }
 
     return 0;
 }
@@ -442,16 +565,16 @@ using namespace std::literals::string_view_literals;
         test->alert(r.error().msg);
         return 1;
     }
-    if (r.value().type != NodeType::forNode) { return 2; }
-    if (r.value().children.size() != 4) {
-        test->alert(std::format("Children count: {}", r.value().children.size()));
+    if (P.ast[r.value()].type != NodeType::forNode) { return 2; }
+    if (P.ast.children(r.value()).size() != 4) {
+        test->alert(std::format("Children count: {}", P.ast.children(r.value()).size()));
         return 3;
     }
 
-    if (r.value().children.at(0).type != NodeType::varNode) { return 4; }
-    if (r.value().children.at(1).type != NodeType::exprNode) { return 5; }
-    if (r.value().children.at(2).type != NodeType::exprNode) { return 6; }
-    if (r.value().children.at(3).type != NodeType::bodyNode) { return 7; }
+    if (P.ast.child(r.value(), 0).type != NodeType::varNode) { return 4; }
+    if (P.ast.child(r.value(), 1).type != NodeType::exprNode) { return 5; }
+    if (P.ast.child(r.value(), 2).type != NodeType::exprNode) { return 6; }
+    if (P.ast.child(r.value(), 3).type != NodeType::bodyNode) { return 7; }
 
     return 0;
 }
@@ -462,11 +585,11 @@ using namespace std::literals::string_view_literals;
     auto r = P.parseFor();
 
     if (!r.has_value()) { return 1; }
-    if (r.value().type != NodeType::forNode) { return 2; }
-    if (r.value().children.size() != 3) { return 3; }
-    if (r.value().children.at(0).type != NodeType::identNode) { return 4; }
-    if (r.value().children.at(1).type != NodeType::identNode) { return 5; }
-    if (r.value().children.at(2).type != NodeType::bodyNode) { return 6; }
+    if (P.ast[r.value()].type != NodeType::forNode) { return 2; }
+    if (P.ast.children(r.value()).size() != 3) { return 3; }
+    if (P.ast.child(r.value(), 0).type != NodeType::identNode) { return 4; }
+    if (P.ast.child(r.value(), 1).type != NodeType::identNode) { return 5; }
+    if (P.ast.child(r.value(), 2).type != NodeType::bodyNode) { return 6; }
 
     return 0;
 }
@@ -476,9 +599,10 @@ using namespace std::literals::string_view_literals;
     P.consume();
     auto r = P.parseFunc();
     if (!r.has_value()) { return 1; }
-    const auto* fn = std::get_if<funcNode>(&r.value().data);
-    if (fn == nullptr || fn->parameters.size() != 0 || fn->retType != "void") { return 2; }
-    if (r.value().children.size() != 1 || r.value().children[0].type != NodeType::bodyNode) {
+    const auto* fn = std::get_if<funcNode>(&P.ast[r.value()].data);
+    if (fn == nullptr || fn->parameters.count != 0 || fn->retType.str() != "void") { return 2; }
+    if (P.ast.children(r.value()).size() != 1 ||
+        P.ast.child(r.value(), 0).type != NodeType::bodyNode) {
         return 3;
     }
 
@@ -486,8 +610,8 @@ using namespace std::literals::string_view_literals;
     P2.consume();
     auto r2 = P2.parseFunc();
     if (!r2.has_value()) { return 4; }
-    const auto* fn2 = std::get_if<funcNode>(&r2.value().data);
-    if (fn2 == nullptr || fn2->parameters.size() != 2) { return 5; }
+    const auto* fn2 = std::get_if<funcNode>(&P2.ast[r2.value()].data);
+    if (fn2 == nullptr || fn2->parameters.count != 2) { return 5; }
 
     return 0;
 }
@@ -498,21 +622,26 @@ using namespace std::literals::string_view_literals;
     P.consume();
     auto r = P.parseFuncCall();
     if (!r.has_value()) { return 1; }
-    if (r.value().type != NodeType::callNode) { return 2; }
-    const auto* cn = std::get_if<funcCallNode>(&r.value().data);
-    if (cn == nullptr || cn->name != "bar" || r.value().children.size() != 0) { return 3; }
+    if (P.ast[r.value()].type != NodeType::callNode) { return 2; }
+    const auto* cn = std::get_if<funcCallNode>(&P.ast[r.value()].data);
+    if (cn == nullptr || cn->name.str() != "bar" || P.ast.children(r.value()).size() != 0) {
+        return 3;
+    }
 
     Parser P2("quux(9, n);"sv);
     P2.consume();
     P2.consume();
     auto r2 = P2.parseFuncCall();
     if (!r2.has_value()) { return 4; }
-    const auto* cn2 = std::get_if<funcCallNode>(&r2.value().data);
-    if (cn2 == nullptr || cn2->name != "quux" || r2.value().children.size() != 2) { return 5; }
-    const auto* argNum = std::get_if<argNode>(&r2.value().children[0].data);
-    const auto* argIdent = std::get_if<argNode>(&r2.value().children[1].data);
+    const auto* cn2 = std::get_if<funcCallNode>(&P2.ast[r2.value()].data);
+    if (cn2 == nullptr || cn2->name.str() != "quux" || P2.ast.children(r2.value()).size() != 2) {
+        return 5;
+    }
+    const auto* argNum = std::get_if<argNode>(&P2.ast.child(r2.value(), 0).data);
+    const auto* argIdent = std::get_if<argNode>(&P2.ast.child(r2.value(), 1).data);
     if (argNum == nullptr || argIdent == nullptr || !argNum->num.has_value() ||
-        argNum->num.value() != 9 || !argIdent->str.has_value() || argIdent->str.value() != "n") {
+        argNum->num.value().integer() != 9 || !argIdent->str.has_value() ||
+        argIdent->str.value().str() != "n") {
         return 6;
     }
 
@@ -529,11 +658,11 @@ using namespace std::literals::string_view_literals;
     Node_Result r = P.parseMod();
 
     if (!r.has_value()) { return 1; }
-    if (r.value().type != NodeType::modNode) { return 2; }
+    if (P.ast[r.value()].type != NodeType::modNode) { return 2; }
 
-    const modNode* mod = std::get_if<modNode>(&r.value().data);
+    const modNode* mod = std::get_if<modNode>(&P.ast[r.value()].data);
     if (mod == nullptr) { return 3; }
-    if (mod->name != "test") { return 4; }
+    if (mod->name.str() != "test") { return 4; }
 
     return 0;
 }
@@ -543,9 +672,10 @@ using namespace std::literals::string_view_literals;
     P.consume();
     auto r = P.parseLet(false);
     if (!r.has_value()) { return 1; }
-    const auto* ln = std::get_if<letNode>(&r.value().data);
-    if (ln == nullptr || ln->name != "main" || !ln->isFunc) { return 2; }
-    if (r.value().children.size() != 1 || r.value().children[0].type != NodeType::funcNode) {
+    const auto* ln = std::get_if<letNode>(&P.ast[r.value()].data);
+    if (ln == nullptr || ln->name.str() != "main" || !ln->isFunc) { return 2; }
+    if (P.ast.children(r.value()).size() != 1 ||
+        P.ast.child(r.value(), 0).type != NodeType::funcNode) {
         return 3;
     }
 
@@ -557,8 +687,8 @@ using namespace std::literals::string_view_literals;
     P.consume();
     auto r = P.parseNumLit();
     if (!r.has_value()) { return 1; }
-    const auto* nl = std::get_if<numlitNode>(&r.value().data);
-    if (nl == nullptr || nl->value != 123) { return 2; }
+    const auto* nl = std::get_if<numlitNode>(&P.ast[r.value()].data);
+    if (nl == nullptr || nl->value.integer() != 123) { return 2; }
 
     Parser P2("9"sv);
     P2.consume();
@@ -566,6 +696,17 @@ using namespace std::literals::string_view_literals;
     if (!nr.has_value()) { return 3; }
     if (!P2.check(TokenType::num_literal)) { return 4; }
 
+    Parser P3("0b102"sv);
+    P3.consume();
+    if (P3.parseNumLit().has_value()) { return 5; }
+
+    Parser P4("2.5e1"sv);
+    P4.consume();
+    const auto fr = P4.parseNumLit();
+    if (!fr.has_value()) { return 6; }
+    const auto* fl = std::get_if<numlitNode>(&P4.ast[fr.value()].data);
+    if (fl == nullptr || fl->value.floating() != 25.0) { return 7; }
+
     return 0;
 }
 
@@ -574,8 +715,8 @@ using namespace std::literals::string_view_literals;
     P.consume();
     auto r = P.parseParam();
     if (!r.has_value()) { return 1; }
-    const auto* pm = std::get_if<paramNode>(&r.value().data);
-    if (pm == nullptr || pm->name != "count" || pm->type != "i32") { return 2; }
+    const auto* pm = std::get_if<paramNode>(&P.ast[r.value()].data);
+    if (pm == nullptr || pm->name.str() != "count" || pm->type.str() != "i32") { return 2; }
 
     return 0;
 }
@@ -585,10 +726,10 @@ using namespace std::literals::string_view_literals;
     P.consume();
     auto r = P.parseReturn();
     if (!r.has_value()) { return 1; }
-    if (r.value().type != NodeType::returnNode) { return 2; }
-    if (r.value().children.size() != 1) { return 3; }
-    const auto* nl = std::get_if<numlitNode>(&r.value().children[0].data);
-    if (nl == nullptr || nl->value != 42) { return 4; }
+    if (P.ast[r.value()].type != NodeType::returnNode) { return 2; }
+    if (P.ast.children(r.value()).size() != 1) { return 3; }
+    const auto* nl = std::get_if<numlitNode>(&P.ast.child(r.value(), 0).data);
+    if (nl == nullptr || nl->value.integer() != 42) { return 4; }
 
     return 0;
 }
@@ -598,20 +739,22 @@ using namespace std::literals::string_view_literals;
     P.consume();
     Node_Result r = P.parseSwitch();
     if (!r.has_value()) { return 1; }
-    if (r.value().type != NodeType::switchNode) { return 2; }
-    const auto* sn = std::get_if<switchNode>(&r.value().data);
-    if (sn == nullptr || sn->ident != "a" || sn->caseCount != 1 || sn->defaultCase) { return 3; }
-    if (r.value().children.size() != 1) { return 4; }
+    if (P.ast[r.value()].type != NodeType::switchNode) { return 2; }
+    const auto* sn = std::get_if<switchNode>(&P.ast[r.value()].data);
+    if (sn == nullptr || sn->ident.str() != "a" || sn->caseCount != 1 || sn->defaultCase) {
+        return 3;
+    }
+    if (P.ast.children(r.value()).size() != 1) { return 4; }
 
     Parser P2("switch(a) { case 1 fallthrough; case 2 {} default {} }"sv);
     P2.consume();
     Node_Result r2 = P2.parseSwitch();
     if (!r2.has_value()) { return 5; }
-    const auto* sn2 = std::get_if<switchNode>(&r2.value().data);
-    if (sn2 == nullptr || sn2->ident != "a" || sn2->caseCount != 2 || !sn2->defaultCase) {
+    const auto* sn2 = std::get_if<switchNode>(&P2.ast[r2.value()].data);
+    if (sn2 == nullptr || sn2->ident.str() != "a" || sn2->caseCount != 2 || !sn2->defaultCase) {
         return 6;
     }
-    if (r2.value().children.size() != 2) { return 7; }
+    if (P2.ast.children(r2.value()).size() != 2) { return 7; }
 
     return 0;
 }
@@ -622,11 +765,11 @@ using namespace std::literals::string_view_literals;
     Node_Result r = P.parseStrLit();
 
     if (!r.has_value()) { return 1; }
-    if (r.value().type != NodeType::strLitNode) { return 2; }
+    if (P.ast[r.value()].type != NodeType::strLitNode) { return 2; }
 
-    const strLitNode* str_ptr = std::get_if<strLitNode>(&r.value().data);
+    const strLitNode* str_ptr = std::get_if<strLitNode>(&P.ast[r.value()].data);
     if (str_ptr == nullptr) { return 3; }
-    if (str_ptr->value != "foo bar") {
+    if (str_ptr->value.str() != "foo bar") {
         test->alert(std::format("Found: {}", str_ptr->value));
         return 4;
     }
@@ -640,9 +783,9 @@ using namespace std::literals::string_view_literals;
     auto r = P.parseType();
 
     if (!r.has_value()) { return 1; }
-    if (r.value().type != NodeType::typeNode) { return 2; }
+    if (P.ast[r.value()].type != NodeType::typeNode) { return 2; }
 
-    typeNode* node = std::get_if<typeNode>(&r.value().data);
+    typeNode* node = std::get_if<typeNode>(&P.ast[r.value()].data);
     if (node == nullptr) { return 3; }
     if (node->child != NodeType::enumNode) { return 4; }
 
@@ -664,9 +807,378 @@ using namespace std::literals::string_view_literals;
     Parser P("let x = func() int { return 0; }"sv);
     auto r = P();
     if (!r.has_value()) { return 1; }
-    if (r.value().size() != 1) { return 2; }
-    const auto* ln = std::get_if<letNode>(&r.value()[0].data);
-    if (ln == nullptr || ln->name != "x") { return 3; }
+    const Ast& ast = r.value();
+    if (ast.roots.size() != 1) { return 2; }
+    const auto* ln = std::get_if<letNode>(&ast[ast.roots[0]].data);
+    if (ln == nullptr || ln->name.str() != "x") { return 3; }
+
+    return 0;
+}
+
+// Body of the function bound by the let at root `i`
+[[nodiscard]] const bodyNode* letBody(const Ast& ast, std::size_t i) {
+    const NodeId fn = ast.childId(ast.roots[i], 0);
+    return std::get_if<bodyNode>(&ast[ast.childId(fn, 0)].data);
+}
+
+[[nodiscard]] int test_parser_recovery([[maybe_unused]] Willow::Test* test) noexcept {
+    Parser P(
+        "let f = func() i32 { let x = 1; return 1; }\n"
+        "alias = ;\n"
+        "let g = func() i32 { return 2; }\n"
+        "let h = func() i32 { 1 + 2; if (true) { return 3; } return 4; }"sv);
+    auto r = P();
+    if (r.has_value()) { return 1; }
+
+    // one error per broken statement or item, in source order
+    if (P.errors.size() != 3) {
+        test->alert(std::format("{} errors", P.errors.size()));
+        return 2;
+    }
+    if (r.error().msg != P.errors[0].error.msg) { return 3; }
+    if (!std::ranges::is_sorted(P.errors, {}, &ParseError::offset)) { return 4; }
+
+    // what parsed is kept, without the broken parts
+    const Ast& ast = P.ast;
+    if (ast.roots.size() != 3) { return 5; }
+    const bodyNode* f = letBody(ast, 0);
+    const bodyNode* h = letBody(ast, 2);
+    if (f == nullptr || f->childCount != 1) { return 6; }
+    if (h == nullptr || h->childCount != 2) { return 7; }
+
+    // An unclosed body runs on to the end of the file, still reporting what's inside it
+    Parser P2(
+        "let f = func() i32 { return 1;\n"
+        "let g = func() i32 { y; return 2; }"sv);
+    if (P2().has_value()) { return 8; }
+    if (P2.errors.size() != 2 || !P2.ast.roots.empty()) { return 9; }
+
+    // A `;` in parens doesn't end a statement early
+    Parser P3("let f = func() i32 { for (let i = 0; i < 2; i++) { g(); } return 0; }"sv);
+    if (P3().has_value()) { return 10; }
+    if (P3.errors.size() != 1 || letBody(P3.ast, 0)->childCount != 1) { return 11; }
+
+    // An if without braces is reported, not parsed as its condition. Recovery carries on
+    // at the `return` that would have been its body
+    Parser P4("let f = func() i32 { if (true) return 1; return 2; }"sv);
+    if (P4().has_value()) { return 12; }
+    if (P4.errors.size() != 1 || letBody(P4.ast, 0)->childCount != 2) { return 13; }
+
+    // An unclosed function alias stops at the end of the file
+    Parser P5("alias f = func(a, b"sv);
+    if (P5().has_value()) { return 14; }
+    if (P5.errors.size() != 1) { return 15; }
+
+    return 0;
+}
+
+// Lex and parse `src`, flattening the tokens and top-level nodes into a string
+[[nodiscard]] std::string summarizeParse(std::string_view src) {
+    Parser P(src);
+    std::string out = {};
+    for (TokenType type : P.tokens.types) { out += std::format("{},", type); }
+
+    auto r = P();
+    if (!r.has_value()) { return out + "error: " + r.error().msg; }
+    const Ast& tree = r.value();
+    for (NodeId id : tree.roots) {
+        std::visit([&out](auto&& v) { out += v.display(); }, tree[id].data);
+    }
+    return out;
+}
+
+[[nodiscard]] int test_parser_threads([[maybe_unused]] Willow::Test* test) noexcept {
+    const std::array<std::string_view, 4> sources = {
+        "let x = func() i32 { return 34 + 35; }"sv,
+        "mod test; alias int_t = i32; alias f_ptr = func(i32) int_t;"sv,
+        "type E = enum { val_1, val_2 }"sv,
+        "# comment\nlet main = func(a: i32, b: i32) i32 { return a; }"sv,
+    };
+
+    std::vector<std::string> expected = {};
+    for (std::string_view src : sources) { expected.push_back(summarizeParse(src)); }
+
+    constexpr int threadCount = 8;
+    constexpr int iterations = 200;
+    std::atomic<int> failures = 0;
+    {
+        std::vector<std::jthread> threads = {};
+        for (int t = 0; t < threadCount; t++) {
+            threads.emplace_back([&, t] {
+                for (int i = 0; i < iterations; i++) {
+                    const auto idx = static_cast<std::size_t>(t + i) % sources.size();
+                    if (summarizeParse(sources[idx]) != expected[idx]) { failures++; }
+
+                    // Names unique to this thread exercise the shared interner
+                    const std::string name = std::format("fn_{}_{}", t, i);
+                    const std::string src =
+                        std::format("let {} = func() i32 {{ return {}; }}", name, i);
+                    Parser P(src);
+                    auto r = P();
+                    if (!r.has_value() || r.value().roots.size() != 1) {
+                        failures++;
+                        continue;
+                    }
+                    const Ast& tree = r.value();
+                    const auto* let = std::get_if<letNode>(&tree[tree.roots[0]].data);
+                    if (let == nullptr || let->name.str() != name) { failures++; }
+                }
+            });
+        }
+    }
+
+    if (failures != 0) {
+        test->alert(std::format("{} mismatched results", failures.load()));
+        return 1;
+    }
+
+    return 0;
+}
+
+[[nodiscard]] int test_parser_topLevelItems([[maybe_unused]] Willow::Test* test) noexcept {
+    Parser P("mod m; const let x = func() i32 { let y: i32 = 1; return y; } type E = enum { a }"sv);
+    const std::vector<std::size_t> items = P.topLevelItems();
+    if (items.size() != 3) { return 1; }
+    if (P.tokens.types[items[0]] != TokenType::kw_mod) { return 2; }
+    if (P.tokens.types[items[1]] != TokenType::kw_const) { return 3; }
+    if (P.tokens.types[items[2]] != TokenType::kw_type) { return 4; }
+
+    return 0;
+}
+
+[[nodiscard]] int test_parser_parallel([[maybe_unused]] Willow::Test* test) noexcept {
+    std::string src = "mod test;\n";
+    for (int i = 0; i < 200; i++) {
+        src += std::format("let f_{} = func(a: i32) i32 {{ return a * {}; }}\n", i, i);
+        if (i % 10 == 0) { src += std::format("type E_{} = enum {{ a, b }}\n", i); }
+    }
+
+    Parser sequential(src);
+    auto expected = sequential();
+    Parser parallel(src);
+    auto r = parallel(4);
+    if (!expected.has_value() || !r.has_value()) { return 1; }
+
+    const Ast& want = expected.value();
+    const Ast& got = r.value();
+    if (got.size() != want.size() || got.roots.size() != want.roots.size()) { return 2; }
+    for (std::size_t i = 0; i < want.size(); i++) {
+        const NodeId id = static_cast<NodeId>(i);
+        if (got[id] != want[id]) { return 3; }
+        if (!std::ranges::equal(got.children(id), want.children(id))) { return 4; }
+    }
+
+    // Errors are the same as a sequential parse, wherever they fall
+    src += "let broken = ;";
+    Parser brokenSequential(src);
+    Parser brokenParallel(src);
+    auto brokenExpected = brokenSequential();
+    auto brokenResult = brokenParallel(4);
+    if (brokenExpected.has_value() || brokenResult.has_value()) { return 5; }
+    if (brokenResult.error().msg != brokenExpected.error().msg) { return 6; }
+
+    return 0;
+}
+
+// Whether two subtrees hold the same nodes, whatever their ids
+[[nodiscard]] bool sameShape(const Ast& lhs, NodeId l, const Ast& rhs, NodeId r) {
+    auto display = [](const Node& node) {
+        return std::visit([](auto&& v) { return v.display(); }, node.data);
+    };
+    if (lhs[l] != rhs[r] || display(lhs[l]) != display(rhs[r])) { return false; }
+
+    // and operators are where the source has them, however the item moved
+    const auto* lexpr = std::get_if<exprNode>(&lhs[l].data);
+    const auto* rexpr = std::get_if<exprNode>(&rhs[r].data);
+    if (lexpr != nullptr && rexpr != nullptr && lexpr->offset != rexpr->offset) { return false; }
+
+    const auto* lfn = std::get_if<funcNode>(&lhs[l].data);
+    const auto* rfn = std::get_if<funcNode>(&rhs[r].data);
+    if (lfn != nullptr && rfn != nullptr) {
+        const auto lparams = lhs.range(lfn->parameters);
+        const auto rparams = rhs.range(rfn->parameters);
+        for (std::size_t i = 0; i < lparams.size(); i++) {
+            if (!sameShape(lhs, lparams[i], rhs, rparams[i])) { return false; }
+        }
+    }
+
+    for (std::size_t i = 0; i < lhs.children(l).size(); i++) {
+        if (!sameShape(lhs, lhs.childId(l, i), rhs, rhs.childId(r, i))) { return false; }
+    }
+    return true;
+}
+
+[[nodiscard]] bool sameTree(const ParseSnapshot& snap, std::string_view src) {
+    Parser P(src);
+    auto r = P();
+    if (!r.has_value() || r.value().roots.size() != snap.ast.roots.size()) { return false; }
+    for (std::size_t i = 0; i < snap.ast.roots.size(); i++) {
+        if (!sameShape(snap.ast, snap.ast.roots[i], r.value(), r.value().roots[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+[[nodiscard]] int test_parser_reparse([[maybe_unused]] Willow::Test* test) noexcept {
+    std::string src = "mod test;\n";
+    for (int i = 0; i < 20; i++) {
+        src += std::format("let f_{} = func(a: i32) i32 {{ return a + {}; }}\n", i, i);
+    }
+
+    Parser P(src);
+    auto first = P.reparse(ParseSnapshot {});
+    if (!first.has_value()) { return 1; }
+    if (first.value().reparsedItems != 21 || first.value().itemDigests.size() != 21) { return 2; }
+    if (!sameTree(first.value(), src)) { return 3; }
+
+    // Edit one function body. The other items are the subtrees already in the arena
+    const std::vector<NodeId> firstRoots = first.value().ast.roots;
+    std::string edited = src;
+    edited.replace(edited.find("a + 7"), 5, "a * 70");
+    Parser P2(edited);
+    auto second = P2.reparse(std::move(first.value()));
+    if (!second.has_value()) { return 4; }
+    if (second.value().reparsedItems != 1) {
+        test->alert(std::format("reparsed {} items", second.value().reparsedItems));
+        return 5;
+    }
+    if (!sameTree(second.value(), edited)) { return 6; }
+    for (std::size_t i = 0; i < firstRoots.size(); i++) {
+        const bool edit = i == 8;  // f_7, after the module
+        if (edit == (second.value().ast.roots[i] == firstRoots[i])) { return 7; }
+    }
+
+    // Insert a new item at the start; everything after it moves but is reused
+    const std::string inserted = "alias int_t = i32;\n" + edited;
+    Parser P3(inserted);
+    auto third = P3.reparse(std::move(second.value()));
+    if (!third.has_value() || third.value().reparsedItems != 1) { return 8; }
+    if (!sameTree(third.value(), inserted)) { return 9; }
+
+    // Only an item's whole digest vouches for its text, not its 64-bit hash alone
+    ParseSnapshot collided = third.value();
+    for (SourceDigest& digest : collided.itemDigests) { digest.check ^= 1; }
+    Parser collide(inserted);
+    auto redone = collide.reparse(std::move(collided));
+    if (!redone.has_value() || redone.value().reparsedItems != 22) { return 16; }
+    if (!sameTree(redone.value(), inserted)) { return 17; }
+
+    // Tokens relexed after an edit are parsed as they are, and items the edit missed
+    // keep the digests they had rather than being hashed again
+    const std::size_t at = inserted.find("a + 3;");
+    const TextEdit change = {at, 5, "a - 3"sv};
+    std::string relexed = inserted;
+    relexed.replace(at, 5, change.inserted);
+    Lexer L(inserted);
+    TokenBuffer buf = {};
+    if (L.lexAll(buf).has_value() || L.relex(buf, relexed, change).has_value()) { return 10; }
+    Parser P4(L, std::move(buf));
+    auto fourth = P4.reparse(third.value(), change);
+    if (!fourth.has_value() || fourth.value().reparsedItems != 1) { return 11; }
+    if (!sameTree(fourth.value(), relexed)) { return 12; }
+    Parser P5(relexed);
+    auto hashed = P5.reparse(std::move(third.value()));
+    if (!hashed.has_value() || hashed.value().itemDigests != fourth.value().itemDigests) {
+        return 13;
+    }
+
+    // Errors are those of a normal parse
+    const std::string broken = relexed + "let broken = ;";
+    Parser P6(broken);
+    Parser P7(broken);
+    auto fifth = P6.reparse(std::move(fourth.value()));
+    auto full = P7();
+    if (fifth.has_value() || full.has_value()) { return 14; }
+    if (fifth.error().msg != full.error().msg) { return 15; }
+
+    // Trees of edited items left in the arena are dropped once they outnumber the rest,
+    // however many edits there are
+    ParseSnapshot snap = std::move(hashed.value());
+    std::string current = relexed;
+    for (int i = 0; i < 100; i++) {
+        const std::string_view from = i % 2 == 0 ? "a + 9;"sv : "a + 9 + 1;"sv;
+        const std::string_view to = i % 2 == 0 ? "a + 9 + 1;"sv : "a + 9;"sv;
+        current.replace(current.find(from), from.size(), to);
+        Parser edit(current);
+        auto after = edit.reparse(std::move(snap));
+        if (!after.has_value()) { return 18; }
+        snap = std::move(after.value());
+    }
+    if (!sameTree(snap, current)) { return 19; }
+    Parser fresh(current);
+    auto freshTree = fresh();
+    if (!freshTree.has_value() || snap.ast.size() > 2 * freshTree.value().size()) { return 20; }
+
+    return 0;
+}
+
+// Nodes in a compiled file, and the allocations made parsing it and then compiling it to
+// a module, counted from the start
+struct CompileAllocations {
+    std::size_t nodes = 0;
+    std::size_t parse = 0;
+    std::size_t compile = 0;
+};
+
+[[nodiscard]] CompileAllocations countCompileAllocations(std::string_view src) {
+    const std::size_t before = allocationCount.load();
+    Parser P(src);
+    auto tree = P();
+    const std::size_t parsed = allocationCount.load() - before;
+    if (!tree.has_value()) { return {}; }
+
+    auto sema = analyze(tree.value());
+    if (!sema.has_value()) { return {}; }
+    Backend B = Backend("test");
+    module_result_t mod = B.compileModule(tree.value(), sema.value());
+    if (!mod.has_value()) { return {}; }
+    return {tree.value().size(), parsed, allocationCount.load() - before};
+}
+
+// A function returning `(1 + (1 + (... + 1)))`, nested `depth` times
+[[nodiscard]] std::string nestedExpr(std::size_t depth) {
+    std::string expr = "1";
+    for (std::size_t i = 0; i < depth; i++) { expr = std::format("(1 + {})", expr); }
+    return std::format("let deep = func() i32 {{ return {}; }}", expr);
+}
+
+[[nodiscard]] int test_parser_allocations([[maybe_unused]] Willow::Test* test) noexcept {
+    // Many small functions: allocations grow with the size of the tree, and only by the
+    // occasional pool regrowth, not once per node
+    std::string wide = {};
+    for (int i = 0; i < 2000; i++) {
+        wide += std::format("let f_{} = func(a: i32, b: i32) i32 {{ return 35 + (17 * 2); }}\n", i);
+    }
+    const CompileAllocations w = countCompileAllocations(wide);
+    if (w.nodes == 0) { return 1; }
+    if (w.parse * 4 > w.nodes) {
+        test->alert(std::format("{} allocations for {} nodes", w.parse, w.nodes));
+        return 2;
+    }
+    // LLVM allocates each function, block and instruction, but walking the tree to get
+    // there may not add more than that
+    if (w.compile > w.nodes * 2) {
+        test->alert(std::format("{} allocations compiling {} nodes", w.compile, w.nodes));
+        return 3;
+    }
+
+    // Deep nesting must not cost more than the nodes it adds
+    const CompileAllocations shallow = countCompileAllocations(nestedExpr(200));
+    const CompileAllocations deep = countCompileAllocations(nestedExpr(400));
+    if (shallow.nodes == 0 || deep.nodes <= shallow.nodes) { return 4; }
+    if (deep.parse > shallow.parse + 8) {
+        test->alert(
+            std::format("depth 200: {} allocations, depth 400: {}", shallow.parse, deep.parse));
+        return 5;
+    }
+    // every level of `1 + (...)` is a new constant once IRBuilder folds it
+    if (deep.compile - shallow.compile > deep.nodes - shallow.nodes) {
+        test->alert(std::format(
+            "compiling depth 200: {} allocations, depth 400: {}", shallow.compile,
+            deep.compile));
+        return 6;
+    }
 
     return 0;
 }
@@ -0,0 +1,157 @@
+#ifndef WINTER_SEMA_TEST_H
+#define WINTER_SEMA_TEST_H
+
+#include <cstddef>
+#include <expected>
+#include <string_view>
+#include <utility>
+
+#include <willow/willow.h>
+
+#include "frontend/parser.h"
+#include "frontend/sema.h"
+
+using namespace Winter;
+using namespace std::literals::string_view_literals;
+
+// Parse and analyze `src`, with the tree kept beside the result
+struct Analyzed {
+    Ast ast;
+    std::expected<Sema, Error> sema;
+};
+
+[[nodiscard]] Analyzed analyzeSource(std::string_view src) {
+    Parser P(src);
+    std::expected<Ast, Error> tree = P();
+    if (!tree.has_value()) { return {Ast(), std::unexpected(tree.error())}; }
+    std::expected<Sema, Error> sema = analyze(tree.value());
+    return {std::move(tree.value()), std::move(sema)};
+}
+
+// First node of type `type` in `ast`
+[[nodiscard]] NodeId findNode(const Ast& ast, NodeType type) {
+    for (std::size_t i = 0; i < ast.size(); i++) {
+        if (ast[static_cast<NodeId>(i)].type == type) { return static_cast<NodeId>(i); }
+    }
+    return 0;
+}
+
+[[nodiscard]] int test_sema_resolve([[maybe_unused]] Willow::Test* test) noexcept {
+    // `add` is used before it is declared
+    auto r = analyzeSource(
+        "let main = func() i32 { add(1, 2); return 0; }\n"
+        "let add = func(a: i32, b: i32) i32 { return a + b; }"sv);
+    if (!r.sema.has_value()) { return 1; }
+    const Sema& sema = r.sema.value();
+
+    const NodeId call = findNode(r.ast, NodeType::callNode);
+    const DeclId add = sema.declOf(call);
+    if (add == 0 || sema[add].kind != DeclKind::function) { return 2; }
+    if (sema[add].node != r.ast.roots[1]) { return 3; }
+    if (sema.typeOf(call) != builtinDecl(BuiltinType::i32)) { return 4; }
+
+    // both identifiers in `a + b` name the parameters
+    const NodeId a = findNode(r.ast, NodeType::identNode);
+    if (sema[sema.declOf(a)].kind != DeclKind::parameter) { return 5; }
+    if (sema.declOf(a) != sema.declOf(findNode(r.ast, NodeType::paramNode))) { return 6; }
+    if (sema.typeOf(findNode(r.ast, NodeType::exprNode)) != builtinDecl(BuiltinType::i32)) {
+        return 7;
+    }
+
+    return 0;
+}
+
+[[nodiscard]] int test_sema_types([[maybe_unused]] Willow::Test* test) noexcept {
+    // aliases resolve to the type they name
+    auto r = analyzeSource(
+        "alias int_t = i32;\n"
+        "alias num_t = int_t;\n"
+        "let f = func(x: num_t) int_t { return x; }"sv);
+    if (!r.sema.has_value()) { return 1; }
+    const Sema& sema = r.sema.value();
+    const NodeId x = findNode(r.ast, NodeType::identNode);
+    if (sema.typeOf(x) != builtinDecl(BuiltinType::i32)) { return 2; }
+    if (sema.builtinOf(sema[sema.declOf(r.ast.roots[1])].type) != BuiltinType::i32) { return 3; }
+
+    // literals take the type they are used as
+    auto r2 = analyzeSource(
+        "let f = func() f64 { let x: f64 = 1; let y: bool = 1 < 2.5 && true; return x; }"sv);
+    if (!r2.sema.has_value()) { return 4; }
+    for (std::size_t i = 0; i < r2.ast.size(); i++) {
+        if (r2.ast[static_cast<NodeId>(i)].type != NodeType::numlitNode) { continue; }
+        if (r2.sema.value().typeOf(static_cast<NodeId>(i)) != builtinDecl(BuiltinType::f64)) {
+            return 5;
+        }
+    }
+
+    auto r3 = analyzeSource("let f = func() String { return \"foo\" .. \"bar\"; }"sv);
+    if (!r3.sema.has_value()) { return 6; }
+
+    // and so do the literals an expression is computed from
+    auto r4 = analyzeSource("let f = func() i64 { return -1 + 2; }"sv);
+    if (!r4.sema.has_value()) { return 7; }
+    if (r4.sema.value().typeOf(findNode(r4.ast, NodeType::numlitNode)) !=
+        builtinDecl(BuiltinType::i64)) {
+        return 8;
+    }
+
+    // a literal nothing gives a type to is an i32
+    auto r5 = analyzeSource("let f = func() i32 { print(1); return 0; }"sv);
+    if (!r5.sema.has_value()) { return 9; }
+    if (r5.sema.value().typeOf(findNode(r5.ast, NodeType::argNode)) !=
+        builtinDecl(BuiltinType::i32)) {
+        return 10;
+    }
+
+    return 0;
+}
+
+[[nodiscard]] int test_sema_scopes([[maybe_unused]] Willow::Test* test) noexcept {
+    // an inner block may shadow, but not redeclare in the same block
+    auto r = analyzeSource(
+        "let f = func() i32 { let x: i32 = 1; if (true) { let x: i32 = 2; } return x; }"sv);
+    if (!r.sema.has_value()) { return 1; }
+    const NodeId use = findNode(r.ast, NodeType::identNode);
+    if (r.sema.value().declOf(use) != r.sema.value().declOf(findNode(r.ast, NodeType::varNode))) {
+        return 2;
+    }
+
+    auto r2 = analyzeSource("let f = func() i32 { let x: i32 = 1; let x: i32 = 2; return x; }"sv);
+    if (r2.sema.has_value() || r2.sema.error().type != ErrType::Sema) { return 3; }
+
+    // locals are gone once their block ends
+    auto r3 = analyzeSource(
+        "let f = func() i32 { if (true) { let x: i32 = 2; } return x; }"sv);
+    if (r3.sema.has_value()) { return 4; }
+
+    // the loop variable belongs to the loop
+    auto r4 = analyzeSource(
+        "let f = func() i32 { for (let i: i32 = 0; i < 10; i++) { print(i); } return 0; }"sv);
+    if (!r4.sema.has_value()) { return 5; }
+
+    return 0;
+}
+
+[[nodiscard]] int test_sema_errors([[maybe_unused]] Willow::Test* test) noexcept {
+    auto r = analyzeSource("let f = func() i32 { return y; }"sv);
+    if (r.sema.has_value() || r.sema.error().type != ErrType::Sema) { return 1; }
+
+    auto r2 = analyzeSource("let f = func() Foo { return 1; }"sv);
+    if (r2.sema.has_value()) { return 2; }
+
+    auto r3 = analyzeSource("let f = func() i32 { return \"s\"; }"sv);
+    if (r3.sema.has_value()) { return 3; }
+
+    auto r4 = analyzeSource("let f = func() i32 { let s: String = \"a\" .. 1; return 0; }"sv);
+    if (r4.sema.has_value()) { return 4; }
+
+    auto r5 = analyzeSource("let f = func() i32 { let x: f64 = 1.5; return x; }"sv);
+    if (r5.sema.has_value()) { return 5; }
+
+    auto r6 = analyzeSource("let f = func() i32 { g(); return 0; }"sv);
+    if (r6.sema.has_value()) { return 6; }
+
+    return 0;
+}
+
+#endif  // WINTER_SEMA_TEST_H
@@ -0,0 +1,67 @@
+#ifndef WINTER_SOURCE_TEST_H
+#define WINTER_SOURCE_TEST_H
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include <unistd.h>
+#include <willow/willow.h>
+
+#include "source.h"
+
+using namespace Winter;
+using namespace std::literals::string_view_literals;
+
+[[nodiscard]] int test_sourceFile_open([[maybe_unused]] Willow::Test* test) noexcept {
+    char path[] = "/tmp/winter_source_testXXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0) { return 1; }
+    const std::string_view contents = "let x = func() i32 { return 0; }"sv;
+    if (write(fd, contents.data(), contents.size()) != static_cast<ssize_t>(contents.size())) {
+        return 2;
+    }
+    close(fd);
+
+    auto src = SourceFile::open(path);
+    std::remove(path);
+    if (!src.has_value()) {
+        test->alert(src.error().msg);
+        return 3;
+    }
+
+    if (!src.value().isMapped()) { return 4; }
+    if (src.value().text != contents) { return 5; }
+
+    // Moving keeps the mapping alive
+    SourceFile moved = std::move(src.value());
+    if (moved.text != contents) { return 6; }
+
+    if (SourceFile::open("/nonexistent/file.wtx"sv).has_value()) { return 7; }
+
+    return 0;
+}
+
+[[nodiscard]] int test_sourceFile_readAll([[maybe_unused]] Willow::Test* test) noexcept {
+    int fds[2];
+    if (pipe(fds) != 0) { return 1; }
+    const std::string_view contents = "mod test;"sv;
+    if (write(fds[1], contents.data(), contents.size()) != static_cast<ssize_t>(contents.size())) {
+        return 2;
+    }
+    close(fds[1]);
+
+    auto src = SourceFile::readAll(fds[0]);
+    close(fds[0]);
+    if (!src.has_value()) { return 3; }
+    if (src.value().isMapped()) { return 4; }
+    if (src.value().text != contents) { return 5; }
+
+    // The view must follow the buffer when moved, even for short (SSO) strings
+    SourceFile moved = std::move(src.value());
+    if (moved.text != contents) { return 6; }
+
+    return 0;
+}
+
+#endif  // WINTER_SOURCE_TEST_H
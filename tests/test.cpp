@@ -2,8 +2,15 @@
 #include <willow/willow.h>
 
 #include "backend_test.h"
+#include "cache_test.h"
+#include "fold_test.h"
+#include "intern_test.h"
 #include "lexer_test.h"
+#include "numeric_test.h"
 #include "parser_test.h"
+#include "sema_test.h"
+#include "source_test.h"
+#include "walk_test.h"
 
 int main(int argc, char* argv[]) {
     Willow::PreCommitReporter reporter = {};
@@ -14,8 +21,10 @@ int main(int argc, char* argv[]) {
         {"token_toString", test_token_toString},
         {"token_toNum", test_token_toNum},
         {"token_toChar", test_token_toChar},
+        {"token_length", test_token_length},
         {"skipWhitespace", test_skipWhitespace},
         {"skipComment", test_skipComment},
+        {"scanner", test_scanner},
         {"isNumeric", test_isNumeric},
         {"isLetter", test_isLetter},
         {"lexSingle", test_lexSingle},
@@ -24,13 +33,27 @@ int main(int argc, char* argv[]) {
         {"lexString", test_lexString},
         {"lexNumeric", test_lexNumeric},
         {"lexIdentKeyword", test_lexIdentKeyword},
+        {"keywordType", test_keywordType},
         {"operator()", test_operator_funcCall},
+        {"lexAll", test_lexAll},
+        {"location", test_location},
+        {"relex", test_relex},
+
+        // numeric_test.h
+        {"parseNumLiteralInt", test_parseNumLiteral_int},
+        {"parseNumLiteralFloat", test_parseNumLiteral_float},
+        {"parseNumLiteralErrors", test_parseNumLiteral_errors},
+
+        // intern_test.h
+        {"intern", test_intern},
+        {"internLarge", test_intern_large},
 
         // parser_test.h
         {"nodeOperatorEQ", test_node_op_eq},
         {"parserCheck", test_parser_check},
         {"parserConsumeVoid", test_parser_consume_void},
         {"parserConsumeTokens", test_parser_consume_tokens},
+        {"parserPeek", test_parser_peek},
         {"parserParseAlias", test_parser_parseAlias},
         {"parserParseArg", test_parser_parseArg},
         {"parserParseBody", test_parser_parseBody},
@@ -40,6 +63,7 @@ int main(int argc, char* argv[]) {
         {"parserParseClass", test_parser_parseClass},
         {"parserParseEnum", test_parser_parseEnum},
         {"parserParseExpr", test_parser_parseExpr},
+        {"parserOperators", test_parser_operators},
         {"parserParseFor", test_parser_parseFor},
         {"parserParseForEach", test_parser_parseForEach},
         {"parserParseFunc", test_parser_parseFunc},
@@ -57,16 +81,55 @@ int main(int argc, char* argv[]) {
         {"parserParseType", test_parser_parseType},
         {"parserParseVariable", test_parser_parseVariable},
         {"parserOperatorCall", test_parser_operatorCall},
+        {"parserRecovery", test_parser_recovery},
+        {"parserThreads", test_parser_threads},
+        {"parserTopLevelItems", test_parser_topLevelItems},
+        {"parserParallel", test_parser_parallel},
+        {"parserReparse", test_parser_reparse},
+        {"parserAllocations", test_parser_allocations},
+
+        // cache_test.h
+        {"cacheRoundTrip", test_cache_roundTrip},
+        {"cacheInvalid", test_cache_invalid},
+        {"astCache", test_astCache},
+
+        // fold_test.h
+        {"foldArithmetic", test_fold_arithmetic},
+        {"foldLogic", test_fold_logic},
+        {"foldPartial", test_fold_partial},
+        {"foldErrors", test_fold_errors},
+
+        // sema_test.h
+        {"semaResolve", test_sema_resolve},
+        {"semaTypes", test_sema_types},
+        {"semaScopes", test_sema_scopes},
+        {"semaErrors", test_sema_errors},
+
+        // walk_test.h
+        {"walkOrder", test_walk_order},
+        {"walkSkipChildren", test_walk_skipChildren},
+        {"walkStop", test_walk_stop},
+
+        // source_test.h
+        {"sourceFileOpen", test_sourceFile_open},
+        {"sourceFileReadAll", test_sourceFile_readAll},
 
         // backend_test.h
         {"BackendgetType", test_getType},
         {"BackendgetTarget", test_getTarget},
+        {"BackendcrossCompiling", test_crossCompiling},
+        {"BackendgetTargetMachine", test_getTargetMachine},
         {"BackendcreateFunction", test_createFunction},
         {"BackendcreateBlock", test_createBlock},
         {"BackendcompileExpression", test_compileExpression},
         {"BackendpopulateBlock", test_populateBlock},
+        {"BackendoptimizeModule", test_optimizeModule},
+        {"BackendprepareModule", test_prepareModule},
         {"BackendcompileModule", test_compileModule},
         {"BackendoutputObjectFile", test_outputObjectFile},
+        {"BackendoutputObjectFiles", test_outputObjectFiles},
+        {"BackendoutputStem", test_outputStem},
+        {"BackendrunModule", test_runModule},
     });
 
     if (argc > 1) { return Willow::runSingleTest(std::string(argv[1]), reporter); }
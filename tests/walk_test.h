@@ -0,0 +1,117 @@
+#ifndef WINTER_WALK_TEST_H
+#define WINTER_WALK_TEST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include <willow/willow.h>
+
+#include "frontend/parser.h"
+#include "frontend/walk.h"
+
+using namespace Winter;
+using namespace std::literals::string_view_literals;
+
+// Records the order nodes are entered and left in, and the depth they were seen at
+struct WalkRecorder {
+    std::vector<NodeType> entered = {};
+    std::vector<NodeType> left = {};
+    std::vector<std::size_t> depths = {};
+    const Ast* ast = nullptr;
+
+    void pre(WalkPos pos, const auto&) {
+        entered.push_back((*ast)[pos.id].type);
+        depths.push_back(pos.depth);
+    }
+    void post(WalkPos pos, const auto&) { left.push_back((*ast)[pos.id].type); }
+};
+
+// Counts nodes, skipping the arguments of calls
+struct CallSkipper {
+    std::size_t nodes = 0;
+    std::size_t calls = 0;
+
+    void pre(WalkPos, const auto&) { nodes++; }
+    WalkAction pre(WalkPos, const funcCallNode&) {
+        nodes++;
+        return WalkAction::SkipChildren;
+    }
+    void post(WalkPos, const funcCallNode&) { calls++; }
+};
+
+// Stops at the first number literal
+struct FindNumber {
+    std::size_t seen = 0;
+    std::optional<NodeId> found = std::nullopt;
+
+    void pre(WalkPos, const auto&) { seen++; }
+    WalkAction pre(WalkPos pos, const numlitNode&) {
+        seen++;
+        found = pos.id;
+        return WalkAction::Stop;
+    }
+};
+
+[[nodiscard]] int test_walk_order([[maybe_unused]] Willow::Test* test) noexcept {
+    Parser P("let f = func(a: i32) i32 { return a + 1; }"sv);
+    auto r = P();
+    if (!r.has_value()) { return 1; }
+
+    WalkRecorder rec = {};
+    rec.ast = &r.value();
+    if (!walk(r.value(), rec)) { return 2; }
+
+    // parameters are walked before the body
+    const std::vector<NodeType> pre = {
+        NodeType::letNode,    NodeType::funcNode, NodeType::paramNode, NodeType::bodyNode,
+        NodeType::returnNode, NodeType::exprNode, NodeType::identNode, NodeType::numlitNode};
+    if (rec.entered != pre) { return 3; }
+
+    const std::vector<NodeType> post = {
+        NodeType::paramNode, NodeType::identNode,  NodeType::numlitNode, NodeType::exprNode,
+        NodeType::returnNode, NodeType::bodyNode, NodeType::funcNode,   NodeType::letNode};
+    if (rec.left != post) { return 4; }
+
+    const std::vector<std::size_t> depths = {0, 1, 2, 2, 3, 4, 5, 5};
+    if (rec.depths != depths) { return 5; }
+
+    return 0;
+}
+
+[[nodiscard]] int test_walk_skipChildren([[maybe_unused]] Willow::Test* test) noexcept {
+    Parser P("let f = func() i32 { foo(a, b); return c; }"sv);
+    auto r = P();
+    if (!r.has_value()) { return 1; }
+
+    CallSkipper skipper = {};
+    if (!walk(r.value(), skipper)) { return 2; }
+    // let > func > body > (call, return > ident), without the call's two args
+    if (skipper.nodes != 6) { return 3; }
+    // a skipped node still gets its post hook
+    if (skipper.calls != 1) { return 4; }
+
+    return 0;
+}
+
+[[nodiscard]] int test_walk_stop([[maybe_unused]] Willow::Test* test) noexcept {
+    Parser P("let f = func() i32 { return 1; }\nlet g = func() i32 { return 2; }"sv);
+    auto r = P();
+    if (!r.has_value()) { return 1; }
+
+    FindNumber finder = {};
+    if (walk(r.value(), finder)) { return 2; }
+    if (!finder.found.has_value()) { return 3; }
+    // let > func > body > return > numlit, and nothing of the second function
+    if (finder.seen != 5) { return 4; }
+
+    const auto* num = std::get_if<numlitNode>(&r.value()[finder.found.value()].data);
+    if (num == nullptr || num->value != NumValue(std::int64_t(1))) { return 5; }
+
+    return 0;
+}
+
+#endif  // WINTER_WALK_TEST_H